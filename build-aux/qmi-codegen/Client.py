@@ -165,6 +165,10 @@ class Client:
                     '            ${output_camelcase} *output;\n'
                     '            GError *error = NULL;\n'
                     '\n'
+                    '            /* Skip parsing if nobody would get the output */\n'
+                    '            if (!g_signal_has_handler_pending (self, signals[SIGNAL_${signal_id}], 0, FALSE))\n'
+                    '                break;\n'
+                    '\n'
                     '            /* Parse indication */\n'
                     '            output = ${message_fullname_underscore}_indication_parse (message, &error);\n'
                     '            if (!output) {\n'
@@ -369,6 +373,33 @@ class Client:
                 '    ${camelcase} *self,\n'
                 '    GAsyncResult *res,\n'
                 '    GError **error);\n')
+            if self.service != 'CTL':
+                template += (
+                    '\n'
+                    '/**\n'
+                    ' * ${underscore}_${message_underscore}_sync:\n'
+                    ' * @self: a #${camelcase}.\n'
+                    ' * @${input_doc}\n'
+                    ' * @timeout: maximum time to wait for the method to complete, in seconds.\n'
+                    ' * @cancellable: a #GCancellable or %NULL.\n'
+                    ' * @error: Return location for error or %NULL.\n'
+                    ' *\n'
+                    ' * Synchronously sends a ${message_name} request to the device, blocking\n'
+                    ' * the calling thread until the response is received.\n'
+                    ' *\n'
+                    ' * This method may be called from threads other than the one running the\n'
+                    ' * #GMainContext of the #QmiDevice, see qmi_device_command_sync().\n'
+                    ' *\n'
+                    ' * Returns: a #${output_camelcase}, or %NULL if @error is set. The returned value should be freed with ${output_underscore}_unref().\n'
+                    ' *\n'
+                    ' * Since: 1.36\n'
+                    ' */\n'
+                    '${output_camelcase} *${underscore}_${message_underscore}_sync (\n'
+                    '    ${camelcase} *self,\n'
+                    '    ${input_arg},\n'
+                    '    guint timeout,\n'
+                    '    GCancellable *cancellable,\n'
+                    '    GError **error);\n')
             hfile.write(string.Template(template).substitute(translations))
 
             template = (
@@ -565,6 +596,95 @@ class Client:
             template += (
                 '}\n'
                 '\n')
+
+            if self.service != 'CTL':
+                template += (
+                    '${output_camelcase} *\n'
+                    '${underscore}_${message_underscore}_sync (\n'
+                    '    ${camelcase} *self,\n'
+                    '    ${input_arg},\n'
+                    '    guint timeout,\n'
+                    '    GCancellable *cancellable,\n'
+                    '    GError **error)\n'
+                    '{\n'
+                    '    g_autoptr(QmiMessage) request = NULL;\n'
+                    '    g_autoptr(QmiMessage) reply = NULL;\n')
+
+                if message.vendor is not None:
+                    template += (
+                        '    g_autoptr(QmiMessageContext) context = NULL;\n')
+
+                # The transaction id is assigned by the device in its own
+                # context, as the caller may be running in a different thread
+                template += (
+                    '\n'
+                    '    if (!qmi_client_is_valid (QMI_CLIENT (self))) {\n'
+                    '        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE, "client invalid");\n'
+                    '        return NULL;\n'
+                    '    }\n'
+                    '\n'
+                    '    request = __${message_fullname_underscore}_request_create (\n'
+                    '                  0,\n'
+                    '                  qmi_client_get_cid (QMI_CLIENT (self)),\n'
+                    '                  ${input_var},\n'
+                    '                  error);\n'
+                    '    if (!request) {\n'
+                    '        g_prefix_error (error, "Couldn\'t create request message: ");\n'
+                    '        return NULL;\n'
+                    '    }\n')
+
+                if message.vendor is not None:
+                    template += (
+                        '\n'
+                        '    context = qmi_message_context_new ();\n'
+                        '    qmi_message_context_set_vendor_id (context, ${message_vendor_id});\n')
+
+                if message.abort:
+                    template += (
+                        '\n'
+                        '    reply = qmi_device_command_abortable_sync (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),\n')
+                else:
+                    template += (
+                        '\n'
+                        '    reply = qmi_device_command_sync (QMI_DEVICE (qmi_client_peek_device (QMI_CLIENT (self))),\n')
+
+                template += (
+                    '                                     request,\n')
+
+                if message.vendor is not None:
+                    template += (
+                        '                                     context,\n')
+                else:
+                    template += (
+                        '                                     NULL,\n')
+
+                template += (
+                    '                                     timeout,\n')
+
+                if message.abort:
+                    template += (
+                        '#if defined HAVE_QMI_MESSAGE_${service_uppercase}_ABORT\n'
+                        '                                     (QmiDeviceCommandAbortableBuildRequestFn)  __${message_fullname_underscore}_abortable_build_request,\n'
+                        '                                     (QmiDeviceCommandAbortableParseResponseFn) __${message_fullname_underscore}_abortable_parse_response,\n'
+                        '                                     g_object_ref (self),\n'
+                        '                                     g_object_unref,\n'
+                        '#else\n'
+                        '                                     NULL,\n'
+                        '                                     NULL,\n'
+                        '                                     NULL,\n'
+                        '                                     NULL,\n'
+                        '#endif\n')
+
+                template += (
+                    '                                     cancellable,\n'
+                    '                                     error);\n'
+                    '    if (!reply)\n'
+                    '        return NULL;\n'
+                    '\n'
+                    '    return ${message_fullname_underscore}_response_parse (reply, error);\n'
+                    '}\n'
+                    '\n')
+
             cfile.write(string.Template(template).substitute(translations))
 
 
@@ -33,7 +33,7 @@ class Container:
     """
     Constructor
     """
-    def __init__(self, service, prefix, container_type, dictionary, common_objects_dictionary, static, since, compat):
+    def __init__(self, service, prefix, container_type, dictionary, common_objects_dictionary, static, since, compat, lazy = False):
         # The current QMI service
         self.service = service
         # The field container prefix usually contains the name of the Message,
@@ -53,6 +53,7 @@ class Container:
         self.static = static
         self.since = since
         self.compat = compat
+        self.lazy = False
 
         # Create the composed full name (prefix + name),
         #  e.g. "Qmi Message Ctl Something Output"
@@ -107,6 +108,23 @@ class Container:
                     else:
                         self.fields.append(Field(self.service, self.fullname, field_dictionary, common_objects_dictionary, container_type, static))
 
+            # In lazy output containers, optional fields are decoded on first
+            # access, unless they are required to evaluate the prerequisites of
+            # other fields while parsing the message.
+            if lazy and self.readonly:
+                prerequisite_fields = []
+                for field in self.fields:
+                    for prerequisite in field.prerequisites:
+                        prerequisite_fields.append(utils.build_underscore_name(prerequisite['field']))
+                for field in self.fields:
+                    underscore = utils.build_underscore_name(field.name)
+                    if field.mandatory:
+                        continue
+                    if any(p == underscore or p.startswith(underscore + '_') for p in prerequisite_fields):
+                        continue
+                    field.lazy = True
+                    self.lazy = True
+
 
     """
     Emit enumeration of TLVs in the container
@@ -138,7 +156,14 @@ class Container:
                 ' *\n'
                 ' * The #${camelcase} structure contains private data and should only be accessed\n'
                 ' * using the provided API.\n'
-                ' *\n'
+                ' *\n')
+            if self.lazy:
+                template += (
+                    ' * Most of the fields are only decoded the first time they are requested,\n'
+                    ' * which modifies the #${camelcase}; the getters of a given #${camelcase}\n'
+                    ' * must therefore not be called from different threads at the same time.\n'
+                    ' *\n')
+            template += (
                 ' * Since: ${since}\n'
                 ' */\n')
         template += (
@@ -161,6 +186,10 @@ class Container:
             '\n'
             'struct _${camelcase} {\n'
             '    volatile gint ref_count;\n')
+        if self.lazy:
+            template += (
+                '\n'
+                '    QmiMessage *message;\n')
         if self.compat:
             template += (
                 '\n'
@@ -177,6 +206,9 @@ class Container:
                         '\n'
                         '    /* ${field_name} */\n'
                         '    gboolean ${field_variable_name}_set;\n')
+                    if field.lazy:
+                        template += (
+                            '    gsize ${field_variable_name}_offset;\n')
                     cfile.write(string.Template(template).substitute(translations))
                     field.emit_variable_declaration(cfile)
 
@@ -282,6 +314,11 @@ class Container:
                 '        if (self->compat_context && self->compat_context_free)\n'
                 '            self->compat_context_free (self->compat_context);\n')
 
+        if self.lazy:
+            template += (
+                '        if (self->message)\n'
+                '            qmi_message_unref (self->message);\n')
+
         if self.fields is not None:
             for field in self.fields:
                 if field.variable is not None and field.variable.needs_dispose:
@@ -51,6 +51,9 @@ class Field:
         self.container_type = container_type
         # Whether the whole field is internally used only
         self.static = static
+        # Whether the field is decoded on first access (output only, set by
+        # the container)
+        self.lazy = False
 
         # Create the composed full name (prefix + name),
         #  e.g. "Qmi Message Ctl Something Output Result"
@@ -120,6 +123,12 @@ class Field:
     Common getter logic
     """
     def emit_getter_common(self, hfile, cfile, dec, doc, imp, since, suffix_gir):
+        lazy_decode = ''
+        if self.lazy:
+            lazy_decode = (
+                '    if (self->${variable_name}_offset)\n'
+                '        ${prefix_underscore}_decode_${underscore} (self);\n'
+                '\n')
         translations = { 'name'                : self.name,
                          'variable_name'       : self.variable_name,
                          'variable_getter_dec' : dec,
@@ -192,6 +201,7 @@ class Field:
             '{\n'
             '    g_return_val_if_fail (self != NULL, FALSE);\n'
             '\n'
+            + lazy_decode +
             '    if (!self->${variable_name}_set) {\n'
             '        g_set_error (error,\n'
             '                     QMI_CORE_ERROR,\n'
@@ -226,6 +236,9 @@ class Field:
     container
     """
     def emit_getter(self, hfile, cfile):
+        if self.lazy:
+            self.emit_lazy_decode(cfile)
+
         input_variable_name = 'value_' + utils.build_underscore_name(self.name)
         dec = self.variable.build_getter_declaration('    ', input_variable_name)
         doc = self.variable.build_getter_documentation(' * ', input_variable_name)
@@ -242,6 +255,37 @@ class Field:
             self.emit_getter_common(hfile, cfile, dec, doc, imp, since, '_gir')
 
 
+    """
+    Emit the method responsible for decoding the TLV from the QMI message kept
+    in the output container, the first time the field is requested. There is
+    no locking, the container type documents that its getters are not
+    thread-safe.
+    """
+    def emit_lazy_decode(self, cfile):
+        translations = { 'variable_name'     : self.variable_name,
+                         'underscore'        : utils.build_underscore_name(self.name),
+                         'prefix_camelcase'  : utils.build_camelcase_name(self.prefix),
+                         'prefix_underscore' : utils.build_underscore_name(self.prefix) }
+
+        template = (
+            '\n'
+            'static void\n'
+            '${prefix_underscore}_decode_${underscore} (${prefix_camelcase} *self)\n'
+            '{\n'
+            '    QmiMessage *message = self->message;\n'
+            '    gsize ${variable_name}_offset = self->${variable_name}_offset;\n'
+            '\n'
+            '    /* Decode only once, even if the TLV is invalid */\n'
+            '    self->${variable_name}_offset = 0;\n'
+            '\n'
+            '    {\n')
+        cfile.write(string.Template(template).substitute(translations))
+        self.emit_output_tlv_get(cfile, '        ')
+        cfile.write(
+            '    }\n'
+            '}\n')
+
+
     """
     Common setter logic
     """
@@ -389,7 +433,31 @@ class Field:
 
 
     """
-    Emit the code responsible for retrieving the TLV from the QMI message
+    Emit the variable holding the offset of the TLV in the QMI message, as
+    found while iterating its TLVs
+    """
+    def emit_output_tlv_offset_declaration(self, f, line_prefix):
+        f.write('%sgsize %s_offset = 0;\n' % (line_prefix, self.variable_name))
+
+
+    """
+    Emit the code responsible for storing the offset of the TLV in the QMI
+    message. Only the first TLV of the given type is considered.
+    """
+    def emit_output_tlv_offset_store(self, f, line_prefix, tlv_offset):
+        translations = { 'variable_name' : self.variable_name,
+                         'tlv_offset'    : tlv_offset,
+                         'lp'            : line_prefix }
+
+        template = (
+            '${lp}if (!${variable_name}_offset)\n'
+            '${lp}    ${variable_name}_offset = ${tlv_offset};\n')
+        f.write(string.Template(template).substitute(translations))
+
+
+    """
+    Emit the code responsible for retrieving the TLV from the QMI message, at
+    the offset previously stored
     """
     def emit_output_tlv_get(self, f, line_prefix):
         tlv_out = utils.build_underscore_name (self.fullname) + '_out'
@@ -406,11 +474,12 @@ class Field:
             '${lp}gsize offset = 0;\n'
             '${lp}gsize init_offset;\n'
             '\n'
-            '${lp}if ((init_offset = qmi_message_tlv_read_init (message, ${tlv_id}, NULL, ${error})) == 0) {\n')
+            '${lp}if ((init_offset = ${variable_name}_offset) == 0) {\n')
 
         if self.mandatory:
             template += (
-                '${lp}    g_prefix_error (${error}, "Couldn\'t get the mandatory ${name} TLV: ");\n'
+                '${lp}    g_set_error (${error}, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND,\n'
+                '${lp}                 "Couldn\'t get the mandatory ${name} TLV: TLV 0x%02X not found", ${tlv_id});\n'
                 '${lp}    ${container_underscore}_unref (self);\n'
                 '${lp}    return NULL;\n')
         else:
@@ -36,7 +36,7 @@ class Message:
         # Validate input fields in the dictionary, and only allow those
         # explicitly expected.
         for message_key in dictionary:
-            if message_key not in [ "name", "type", "service", "id", "since", "input", "output", "vendor", "scope", "abort", "output-compat", "input-compat" ]:
+            if message_key not in [ "name", "type", "service", "id", "since", "input", "output", "vendor", "scope", "abort", "output-compat", "input-compat", "output-lazy" ]:
                 raise ValueError('Invalid message field: "' + message_key + '"')
 
         # The message service, e.g. "Ctl"
@@ -80,6 +80,9 @@ class Message:
         # field. This applies to both Request/Response and Indications.
         # Output containers are actually optional in Indications
         self.output_compat = True if 'output-compat' in dictionary and dictionary['output-compat'] == 'yes' else False
+        # Output containers may also decode their optional fields only when
+        # first requested, instead of while parsing the message
+        self.output_lazy = True if 'output-lazy' in dictionary and dictionary['output-lazy'] == 'yes' else False
         self.output = Container(self.service,
                                 self.fullname,
                                 'Output',
@@ -87,7 +90,8 @@ class Message:
                                 common_objects_dictionary,
                                 self.static,
                                 self.since,
-                                self.output_compat)
+                                self.output_compat,
+                                self.output_lazy)
 
         self.input = None
         if self.type == 'Message':
@@ -241,14 +245,62 @@ class Message:
             '    GError **error)\n'
             '{\n'
             '    ${container} *self;\n'
+            '    gsize tlv_offset;\n'
+            '    guint8 tlv_type = 0;\n')
+        cfile.write(string.Template(template).substitute(translations))
+
+        for field in self.output.fields:
+            field.emit_output_tlv_offset_declaration(cfile, '    ')
+
+        template = (
             '\n'
             '    g_assert_cmphex (qmi_message_get_message_id (message), ==, ${message_id});\n'
             '\n'
             '    self = g_slice_new0 (${container});\n'
-            '    self->ref_count = 1;\n')
+            '    self->ref_count = 1;\n'
+            '\n'
+            '    /* Locate all known TLVs in a single pass, skipping unknown ones */\n'
+            '    for (tlv_offset = __qmi_message_tlv_read_next (message, 0, &tlv_type);\n'
+            '         tlv_offset;\n'
+            '         tlv_offset = __qmi_message_tlv_read_next (message, tlv_offset, &tlv_type)) {\n'
+            '        switch (tlv_type) {\n')
         cfile.write(string.Template(template).substitute(translations))
 
+        # Fields sharing the same TLV id, if any, share the same case
+        cases = {}
+        for field in self.output.fields:
+            cases.setdefault(field.id_enum_name, []).append(field)
+        for tlv_id, fields in cases.items():
+            cfile.write('        case %s:\n' % tlv_id)
+            for field in fields:
+                field.emit_output_tlv_offset_store(cfile, '            ', 'tlv_offset')
+            cfile.write('            break;\n')
+
+        cfile.write(
+            '        default:\n'
+            '            break;\n'
+            '        }\n'
+            '    }\n')
+
+        if self.output.lazy:
+            cfile.write(
+                '\n'
+                '    /* Keep the message around to decode the remaining fields on demand */\n'
+                '    self->message = qmi_message_ref (message);\n')
+
+        # Fields are decoded in the order they are defined, so that the
+        # prerequisites refer to already decoded fields
         for field in self.output.fields:
+            if field.lazy:
+                cfile.write(
+                    '\n'
+                    '    do {\n')
+                field.emit_output_prerequisite_check(cfile, '        ')
+                cfile.write('        self->%s_offset = %s_offset;\n' % (field.variable_name, field.variable_name))
+                cfile.write(
+                    '    } while (0);\n')
+                continue
+
             cfile.write(
                 '\n'
                 '    do {\n')
@@ -506,6 +558,9 @@ class Message:
                 '<SUBSECTION ${camelcase}ClientMethods>\n'
                 'qmi_client_${service}_${name_underscore}\n'
                 'qmi_client_${service}_${name_underscore}_finish\n')
+            if self.service != 'CTL':
+                template += (
+                    'qmi_client_${service}_${name_underscore}_sync\n')
             sections['public-methods'] += string.Template(template).substitute(translations)
             translations['message_type'] = 'request'
         elif self.type == 'Indication':
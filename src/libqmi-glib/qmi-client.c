@@ -52,6 +52,13 @@ struct _QmiClientPrivate {
     guint version_minor;
 
     guint16 transaction_id;
+
+    /* Bitmap of the transaction IDs waiting for a response, allocated on
+     * first use */
+    guint8 *transactions_in_flight;
+
+    /* Message IDs of the indications to process, or NULL for all */
+    GHashTable *indication_filter;
 };
 
 /*****************************************************************************/
@@ -141,33 +148,109 @@ qmi_client_check_version (QmiClient *self,
     return FALSE;
 }
 
+static guint16
+get_max_transaction_id (QmiClient *self)
+{
+    /* Don't go further than 8bits in the CTL service */
+    return (self->priv->service == QMI_SERVICE_CTL ? G_MAXUINT8 : G_MAXUINT16);
+}
+
+static gboolean
+transaction_id_in_use (QmiClient *self,
+                       guint16    transaction_id)
+{
+    if (self->priv->transactions_in_flight &&
+        (self->priv->transactions_in_flight[transaction_id / 8] & (1 << (transaction_id % 8))))
+        return TRUE;
+
+    /* Requests sent with this client ID but not through this object (e.g.
+     * raw messages) are only known by the device */
+    return (self->priv->device &&
+            __qmi_device_is_transaction_in_flight (self->priv->device,
+                                                   self->priv->service,
+                                                   self->priv->cid,
+                                                   transaction_id));
+}
+
 guint16
 qmi_client_get_next_transaction_id (QmiClient *self)
 {
+    guint16 max;
     guint16 next;
+    guint   n_skipped = 0;
 
     g_return_val_if_fail (QMI_IS_CLIENT (self), 0);
 
-    next = self->priv->transaction_id;
+    max = get_max_transaction_id (self);
 
-    /* Don't go further than 8bits in the CTL service */
-    if ((self->priv->service == QMI_SERVICE_CTL &&
-         self->priv->transaction_id == G_MAXUINT8) ||
-        self->priv->transaction_id == G_MAXUINT16)
-        /* Reset! */
-        self->priv->transaction_id = 0x01;
-    else
-        self->priv->transaction_id++;
+    /* Skip the IDs of the transactions still in flight, so that a wraparound
+     * never gives the same ID to two requests waiting for a response at the
+     * same time. If all of them are in use, just go on with the next one. */
+    do {
+        next = self->priv->transaction_id;
+        if (self->priv->transaction_id >= max)
+            /* Reset! */
+            self->priv->transaction_id = 0x01;
+        else
+            self->priv->transaction_id++;
+    } while (transaction_id_in_use (self, next) && ++n_skipped < max);
 
     return next;
 }
 
+void
+__qmi_client_set_transaction_in_flight (QmiClient *self,
+                                        guint16    transaction_id,
+                                        gboolean   in_flight)
+{
+    if (transaction_id > get_max_transaction_id (self))
+        return;
+
+    if (!self->priv->transactions_in_flight) {
+        if (!in_flight)
+            return;
+        self->priv->transactions_in_flight = g_malloc0 ((get_max_transaction_id (self) / 8) + 1);
+    }
+
+    if (in_flight)
+        self->priv->transactions_in_flight[transaction_id / 8] |= (1 << (transaction_id % 8));
+    else
+        self->priv->transactions_in_flight[transaction_id / 8] &= ~(1 << (transaction_id % 8));
+}
+
+/*****************************************************************************/
+
+void
+qmi_client_set_indication_filter (QmiClient     *self,
+                                  const guint16 *indication_ids,
+                                  guint          n_indication_ids)
+{
+    guint i;
+
+    g_return_if_fail (QMI_IS_CLIENT (self));
+    g_return_if_fail (indication_ids || !n_indication_ids);
+
+    g_clear_pointer (&self->priv->indication_filter, g_hash_table_unref);
+    if (!indication_ids)
+        return;
+
+    self->priv->indication_filter = g_hash_table_new (g_direct_hash, g_direct_equal);
+    for (i = 0; i < n_indication_ids; i++)
+        g_hash_table_add (self->priv->indication_filter, GUINT_TO_POINTER (indication_ids[i]));
+}
+
 /*****************************************************************************/
 
 void
 __qmi_client_process_indication (QmiClient *self,
                                  QmiMessage *message)
 {
+    /* Indications not requested are dropped before being parsed */
+    if (self->priv->indication_filter &&
+        !g_hash_table_contains (self->priv->indication_filter,
+                                GUINT_TO_POINTER (qmi_message_get_message_id (message))))
+        return;
+
     if (QMI_CLIENT_GET_CLASS (self)->process_indication)
         QMI_CLIENT_GET_CLASS (self)->process_indication (self, message);
 }
@@ -254,6 +337,18 @@ qmi_client_init (QmiClient *self)
     self->priv->version_minor = 0;
 }
 
+static void
+finalize (GObject *object)
+{
+    QmiClient *self = QMI_CLIENT (object);
+
+    if (self->priv->indication_filter)
+        g_hash_table_unref (self->priv->indication_filter);
+    g_free (self->priv->transactions_in_flight);
+
+    G_OBJECT_CLASS (qmi_client_parent_class)->finalize (object);
+}
+
 static void
 qmi_client_class_init (QmiClientClass *klass)
 {
@@ -263,6 +358,7 @@ qmi_client_class_init (QmiClientClass *klass)
 
     object_class->get_property = get_property;
     object_class->set_property = set_property;
+    object_class->finalize = finalize;
 
     /**
      * QmiClient:client-device:
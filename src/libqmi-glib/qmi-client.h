@@ -264,18 +264,49 @@ gboolean qmi_client_check_version (QmiClient *self,
  * Acquire the next transaction ID of this #QmiClient.
  * The internal transaction ID gets incremented.
  *
+ * Since 1.36, the IDs of the transactions of this client still waiting for a
+ * response are skipped, so that a wraparound never gives the same ID to two
+ * requests in flight.
+ *
  * Returns: the next transaction ID.
  *
  * Since: 1.0
  */
 guint16 qmi_client_get_next_transaction_id (QmiClient *self);
 
+/**
+ * qmi_client_set_indication_filter:
+ * @self: a #QmiClient.
+ * @indication_ids: (array length=n_indication_ids) (nullable): message IDs of
+ *  the indications to process, or %NULL to process all.
+ * @n_indication_ids: number of items in @indication_ids.
+ *
+ * Declares which indications @self should process. Any other indication
+ * received for @self is discarded without being parsed, and its signal is
+ * not emitted.
+ *
+ * Indications are never parsed if no handler is connected to their signal, so
+ * this method is only needed to also skip the ones with handlers connected,
+ * e.g. when generic code connects to every signal of the client.
+ *
+ * By default all indications are processed.
+ *
+ * Since: 1.36
+ */
+void qmi_client_set_indication_filter (QmiClient     *self,
+                                       const guint16 *indication_ids,
+                                       guint          n_indication_ids);
+
 /* not part of the public API */
 
 #if defined (LIBQMI_GLIB_COMPILATION)
 G_GNUC_INTERNAL
 void __qmi_client_process_indication (QmiClient  *self,
                                       QmiMessage *message);
+G_GNUC_INTERNAL
+void __qmi_client_set_transaction_in_flight (QmiClient *self,
+                                             guint16    transaction_id,
+                                             gboolean   in_flight);
 #endif
 
 G_END_DECLS
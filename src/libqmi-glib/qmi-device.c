@@ -37,6 +37,7 @@
 #include "qmi-endpoint.h"
 #include "qmi-endpoint-mbim.h"
 #include "qmi-endpoint-qmux.h"
+#include "qmi-endpoint-simulated.h"
 #include "qmi-ctl.h"
 #include "qmi-dms.h"
 #include "qmi-wds.h"
@@ -96,6 +97,7 @@ enum {
     PROP_PROXY_PATH,
     PROP_WWAN_IFACE,
     PROP_CONSECUTIVE_TIMEOUTS,
+    PROP_READ_SIZE,
 #if QMI_QRTR_SUPPORTED
     PROP_NODE,
 #endif
@@ -111,7 +113,19 @@ enum {
 static GParamSpec *properties[PROP_LAST];
 static guint       signals   [SIGNAL_LAST] = { 0 };
 
+/* Number of one-second slots in the transaction timeout wheel */
+#define TIMEOUT_WHEEL_SLOTS 64
+
+/* Limits of the size of each read on the QMUX port */
+#define MIN_READ_SIZE     512
+#define MAX_READ_SIZE     QMI_ENDPOINT_BUFFER_MAX_RETAINED_SIZE
+#define DEFAULT_READ_SIZE (16 * 1024)
+
 struct _QmiDevicePrivate {
+    /* Main context where the device was created; all the sources owned by
+     * the device are attached to it */
+    GMainContext *context;
+
     /* File or node */
     QmiFile *file;
 #if QMI_QRTR_SUPPORTED
@@ -133,22 +147,87 @@ struct _QmiDevicePrivate {
     /* Supported services */
     GArray *supported_services;
 
+    /* Persistent cache of the supported services */
+    gchar *version_info_cache_path;
+    gchar *version_info_cache_firmware_id;
+
     /* Lower-level transport */
     QmiEndpoint *endpoint;
     guint endpoint_new_data_id;
+    guint endpoint_new_message_id;
+    guint endpoint_send_failed_id;
     guint endpoint_hangup_id;
 
     /* Support for qmi-proxy */
     gchar *proxy_path;
 
+    /* Size of each read done on the QMUX port */
+    guint read_size;
+
     /* HT to keep track of ongoing transactions */
     GHashTable *transactions;
 
+    /* Unused transaction records, reused for new requests */
+    GQueue transaction_pool;
+
+    /* Transactions with a result pending to be reported to the caller; if
+     * synchronous completion is enabled the queue is flushed right after
+     * processing the input, otherwise from its own source */
+    GQueue   completion_queue;
+    GSource *completion_queue_source;
+    gboolean synchronous_completion;
+    gboolean processing_input;
+    gboolean completing_input;
+
+    /* Timer wheel tracking the transaction timeouts */
+    GQueue   timeout_wheel[TIMEOUT_WHEEL_SLOTS];
+    guint    timeout_wheel_n_pending;
+    gint64   timeout_wheel_start;
+    guint64  timeout_wheel_tick;
+    GSource *timeout_wheel_source;
+
     /* HT of clients that want to get indications */
     GHashTable *registered_clients;
+    /* HT of service -> GPtrArray of the registered clients of that service,
+     * used to route broadcast indications; clients are owned by the HT above */
+    GHashTable *registered_clients_by_service;
+
+    /* Indications pending to be reported to clients */
+    GQueue   indication_queue;
+    GSource *indication_queue_source;
 
     /* Number of consecutive timeouts detected */
     guint consecutive_timeouts;
+
+    /* Request and indication metrics */
+    GHashTable *message_metrics;
+    GHashTable *indication_metrics;
+
+    /* HT of service -> RequestWindow */
+    GHashTable *request_windows;
+
+    /* Set of the requests that may be coalesced, and HT of request message
+     * -> Transaction with the ones of those currently in flight */
+    GHashTable *coalesced_requests;
+    GHashTable *coalescing_transactions;
+
+    /* Response cache: HT of service and message id -> TTL, set of service and
+     * indication id of the indications invalidating the cache, and HT of
+     * request message -> ResponseCacheEntry */
+    GHashTable *response_cache_ttls;
+    GHashTable *response_cache_invalidations;
+    GHashTable *response_cache;
+    guint64     response_cache_n_hits;
+    guint64     response_cache_n_misses;
+
+    /* HT of service -> CidPool; the generation changes every time the
+     * pooled client ids become invalid */
+    GHashTable *cid_pools;
+    guint       cid_pool_generation;
+
+    /* Configuration of the simulated modem, shared with its endpoint */
+    GHashTable *simulated_responses;
+    GPtrArray  *simulated_indications;
 };
 
 #if QMI_QRTR_SUPPORTED
@@ -164,13 +243,71 @@ typedef struct {
 } TransactionWaitContext;
 
 typedef struct {
+    QmiDevice  *self;
+    QmiService  service;
+
+    /* limits, 0 if unlimited */
+    guint max_in_flight;
+    guint max_in_flight_per_client;
+
+    /* requests sent, per service and per CID */
+    guint n_in_flight;
+    guint n_in_flight_per_client[G_MAXUINT8 + 1];
+
+    /* requests waiting to be sent, in order */
+    GQueue   queue;
+    GSource *dispatch_source;
+
+    /* stats */
+    guint   max_queue_length;
+    guint64 n_queued;
+    guint64 total_wait;
+    guint64 max_wait;
+} RequestWindow;
+
+typedef struct _Transaction Transaction;
+
+struct _Transaction {
+    QmiDevice              *self; /* the result keeps a ref */
+    QmiClient              *client; /* owner of the transaction id, if any */
     QmiMessage             *message;
     QmiMessageContext      *message_context;
-    GSimpleAsyncResult     *result;
-    GSource                *timeout_source;
+    guint64                 timeout_tick;
+    GList                   timeout_link;
     GCancellable           *cancellable;
     gulong                  cancellable_id;
     TransactionWaitContext *wait_ctx;
+    TransactionWaitContext  wait_ctx_data;
+
+    /* result reporting; the record is only recycled once the transaction is
+     * complete and its result has been reported */
+    GTask                  *task;
+    QmiMessage             *reply;
+    GError                 *error;
+    gboolean                result_reported;
+    gboolean                completion_queued;
+    gboolean                completed;
+    GList                   completion_link; /* also used in the pool */
+
+    /* metrics, owned by the device */
+    QmiDeviceMessageMetrics *metrics;
+    gint64                   start_time;
+    gboolean                 from_cache;
+
+    /* request window support; if queued, the transaction is not yet stored
+     * and the timeout covers the time spent in the queue */
+    RequestWindow *window;
+    gboolean       window_queued;
+    GList          window_link;
+    guint          window_timeout;
+    gint64         window_queued_time;
+
+    /* coalescing support; requests attached to another one are never stored,
+     * and get the same result as the one they are attached to */
+    gboolean     coalescing;
+    GQueue       coalesced;
+    Transaction *coalesced_with;
+    GList        coalesced_link;
 
     /* abortable support */
     GError                                   *abort_error;
@@ -179,7 +316,358 @@ typedef struct {
     QmiDeviceCommandAbortableParseResponseFn  abort_parse_response_fn;
     gpointer                                  abort_user_data;
     GDestroyNotify                            abort_user_data_free;
-} Transaction;
+};
+
+/*****************************************************************************/
+/* Metrics
+ *
+ * Entries are allocated the first time a given service and message id (or a
+ * given service, for indications) is seen, and are only freed on reset if
+ * there are no requests in flight, as transactions keep a pointer to them.
+ */
+
+static gpointer
+build_message_key (QmiService service,
+                   guint16    message_id)
+{
+    return GUINT_TO_POINTER (((guint)service << 16) | message_id);
+}
+
+static void
+message_metrics_free (QmiDeviceMessageMetrics *metrics)
+{
+    g_slice_free (QmiDeviceMessageMetrics, metrics);
+}
+
+static void
+indication_metrics_free (QmiDeviceIndicationMetrics *metrics)
+{
+    g_slice_free (QmiDeviceIndicationMetrics, metrics);
+}
+
+static QmiDeviceMessageMetrics *
+message_metrics_request (QmiDevice  *self,
+                         QmiMessage *request)
+{
+    QmiDeviceMessageMetrics *metrics;
+    QmiService               service;
+    guint16                  message_id;
+
+    service = qmi_message_get_service (request);
+    message_id = qmi_message_get_message_id (request);
+
+    metrics = g_hash_table_lookup (self->priv->message_metrics,
+                                   build_message_key (service, message_id));
+    if (!metrics) {
+        metrics = g_slice_new0 (QmiDeviceMessageMetrics);
+        metrics->service = service;
+        metrics->message_id = message_id;
+        g_hash_table_insert (self->priv->message_metrics,
+                             build_message_key (service, message_id),
+                             metrics);
+    }
+
+    metrics->n_requests++;
+    metrics->n_in_flight++;
+    return metrics;
+}
+
+static void
+message_metrics_complete (QmiDeviceMessageMetrics *metrics,
+                          gint64                   start_time,
+                          QmiMessage              *reply,
+                          gboolean                 from_cache)
+{
+    guint64 latency;
+    guint   bucket;
+
+    g_assert (metrics->n_in_flight > 0);
+    metrics->n_in_flight--;
+
+    if (!reply) {
+        metrics->n_failures++;
+        return;
+    }
+
+    /* Nothing was received */
+    if (from_cache) {
+        metrics->n_cached++;
+        return;
+    }
+
+    latency = (guint64) MAX (g_get_monotonic_time () - start_time, 0);
+    metrics->bytes_in += qmi_message_get_length (reply);
+    metrics->total_latency += latency;
+    if (latency > metrics->max_latency)
+        metrics->max_latency = latency;
+
+    /* Bucket i holds latencies in [2^(i-1), 2^i) ms, i.e. those where
+     * the number of bits of the value in ms is i */
+    if (latency < 1000)
+        bucket = 0;
+    else
+        bucket = MIN (g_bit_storage (latency / 1000), QMI_DEVICE_METRICS_N_LATENCY_BUCKETS - 1);
+    metrics->latency_histogram[bucket]++;
+}
+
+static void
+indication_metrics_report (QmiDevice  *self,
+                           QmiMessage *indication)
+{
+    QmiDeviceIndicationMetrics *metrics;
+    QmiService                  service;
+
+    service = qmi_message_get_service (indication);
+
+    metrics = g_hash_table_lookup (self->priv->indication_metrics, GUINT_TO_POINTER (service));
+    if (!metrics) {
+        metrics = g_slice_new0 (QmiDeviceIndicationMetrics);
+        metrics->service = service;
+        g_hash_table_insert (self->priv->indication_metrics, GUINT_TO_POINTER (service), metrics);
+    }
+
+    metrics->n_indications++;
+    metrics->bytes_in += qmi_message_get_length (indication);
+}
+
+static gint
+message_metrics_cmp (const QmiDeviceMessageMetrics *a,
+                     const QmiDeviceMessageMetrics *b)
+{
+    if (a->service != b->service)
+        return (a->service < b->service ? -1 : 1);
+    return ((gint) a->message_id - (gint) b->message_id);
+}
+
+static gint
+indication_metrics_cmp (const QmiDeviceIndicationMetrics *a,
+                        const QmiDeviceIndicationMetrics *b)
+{
+    if (a->service != b->service)
+        return (a->service < b->service ? -1 : 1);
+    return 0;
+}
+
+GArray *
+qmi_device_get_message_metrics (QmiDevice *self)
+{
+    GArray                  *array;
+    GHashTableIter           iter;
+    QmiDeviceMessageMetrics *metrics;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceMessageMetrics),
+                               g_hash_table_size (self->priv->message_metrics));
+    g_hash_table_iter_init (&iter, self->priv->message_metrics);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&metrics))
+        g_array_append_val (array, *metrics);
+    g_array_sort (array, (GCompareFunc)message_metrics_cmp);
+    return array;
+}
+
+GArray *
+qmi_device_get_indication_metrics (QmiDevice *self)
+{
+    GArray                     *array;
+    GHashTableIter              iter;
+    QmiDeviceIndicationMetrics *metrics;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (QmiDeviceIndicationMetrics),
+                               g_hash_table_size (self->priv->indication_metrics));
+    g_hash_table_iter_init (&iter, self->priv->indication_metrics);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&metrics))
+        g_array_append_val (array, *metrics);
+    g_array_sort (array, (GCompareFunc)indication_metrics_cmp);
+    return array;
+}
+
+void
+qmi_device_reset_metrics (QmiDevice *self)
+{
+    GHashTableIter           iter;
+    QmiDeviceMessageMetrics *metrics;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    g_hash_table_iter_init (&iter, self->priv->message_metrics);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&metrics)) {
+        QmiService service;
+        guint16    message_id;
+        guint      n_in_flight;
+
+        if (!metrics->n_in_flight) {
+            g_hash_table_iter_remove (&iter);
+            continue;
+        }
+
+        /* Still referenced by the transactions in flight */
+        service = metrics->service;
+        message_id = metrics->message_id;
+        n_in_flight = metrics->n_in_flight;
+        memset (metrics, 0, sizeof (QmiDeviceMessageMetrics));
+        metrics->service = service;
+        metrics->message_id = message_id;
+        metrics->n_in_flight = n_in_flight;
+    }
+
+    g_hash_table_remove_all (self->priv->indication_metrics);
+}
+
+/*****************************************************************************/
+/* Transaction timeouts
+ *
+ * Instead of one timeout source per transaction, the deadlines of all the
+ * transactions of the device are kept in a timer wheel with one slot per
+ * second, driven by a single source that ticks every second while there are
+ * timeouts pending. Each transaction is stored in the slot of the tick when it
+ * expires; those expiring further away than the wheel size just stay in their
+ * slot for additional rounds.
+ *
+ * The source is attached to the main context of the device, and not to the
+ * one of the request that started it, so that timeouts keep on firing no
+ * matter which contexts are being iterated.
+ */
+
+static void
+timeout_wheel_remove (QmiDevice   *self,
+                      Transaction *tr)
+{
+    if (!tr->timeout_tick)
+        return;
+
+    g_queue_unlink (&self->priv->timeout_wheel[tr->timeout_tick % TIMEOUT_WHEEL_SLOTS], &tr->timeout_link);
+    tr->timeout_tick = 0;
+    g_assert (self->priv->timeout_wheel_n_pending > 0);
+    self->priv->timeout_wheel_n_pending--;
+}
+
+static Transaction *
+timeout_wheel_peek_expired (GQueue  *slot,
+                            guint64  tick)
+{
+    GList *l;
+
+    for (l = slot->head; l; l = g_list_next (l)) {
+        Transaction *tr = l->data;
+
+        if (tr->timeout_tick <= tick)
+            return tr;
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+/* Request windows
+ *
+ * A window limits the number of requests of a given service that may be
+ * waiting for a response at the same time, in total and per client. The
+ * requests exceeding the limits are kept in a FIFO queue, and sent from an
+ * idle source in the main context of the device once the ones in flight
+ * complete.
+ */
+
+static gboolean request_window_dispatch_cb (RequestWindow *window);
+
+static void
+request_window_free (RequestWindow *window)
+{
+    /* Queued transactions keep refs to the device */
+    g_assert (g_queue_is_empty (&window->queue));
+
+    if (window->dispatch_source) {
+        g_source_destroy (window->dispatch_source);
+        g_source_unref (window->dispatch_source);
+    }
+    g_slice_free (RequestWindow, window);
+}
+
+static gboolean
+request_window_has_room (RequestWindow *window,
+                         guint8         cid)
+{
+    if (window->max_in_flight && window->n_in_flight >= window->max_in_flight)
+        return FALSE;
+    if (window->max_in_flight_per_client && window->n_in_flight_per_client[cid] >= window->max_in_flight_per_client)
+        return FALSE;
+    return TRUE;
+}
+
+static void
+request_window_schedule_dispatch (RequestWindow *window)
+{
+    if (window->dispatch_source || g_queue_is_empty (&window->queue))
+        return;
+
+    window->dispatch_source = g_idle_source_new ();
+    g_source_set_callback (window->dispatch_source, (GSourceFunc)request_window_dispatch_cb, window, NULL);
+    g_source_attach (window->dispatch_source, window->self->priv->context);
+}
+
+static void
+request_window_acquire (RequestWindow *window,
+                        Transaction   *tr)
+{
+    g_assert (!tr->window);
+
+    tr->window = window;
+    window->n_in_flight++;
+    window->n_in_flight_per_client[qmi_message_get_client_id (tr->message)]++;
+}
+
+static void
+request_window_release (Transaction *tr)
+{
+    RequestWindow *window;
+
+    window = tr->window;
+    if (!window || tr->window_queued)
+        return;
+
+    g_assert (window->n_in_flight > 0);
+    window->n_in_flight--;
+    g_assert (window->n_in_flight_per_client[qmi_message_get_client_id (tr->message)] > 0);
+    window->n_in_flight_per_client[qmi_message_get_client_id (tr->message)]--;
+    tr->window = NULL;
+
+    request_window_schedule_dispatch (window);
+}
+
+/* Returns the time left until the transaction times out, in seconds */
+static guint
+request_window_unqueue (Transaction *tr)
+{
+    RequestWindow *window;
+    guint64        wait;
+    guint64        wait_seconds;
+
+    window = tr->window;
+    g_assert (window && tr->window_queued);
+
+    g_queue_unlink (&window->queue, &tr->window_link);
+    tr->window = NULL;
+    tr->window_queued = FALSE;
+
+    wait = (guint64) MAX (g_get_monotonic_time () - tr->window_queued_time, 0);
+    window->total_wait += wait;
+    if (wait > window->max_wait)
+        window->max_wait = wait;
+
+    if (tr->timeout_tick)
+        timeout_wheel_remove (window->self, tr);
+
+    if (!tr->window_timeout)
+        return 0;
+    wait_seconds = wait / G_USEC_PER_SEC;
+    return (wait_seconds < tr->window_timeout) ? (guint) (tr->window_timeout - wait_seconds) : 1;
+}
+
+/*****************************************************************************/
+
+/* Maximum number of unused transaction records kept for reuse */
+#define TRANSACTION_POOL_MAX_LENGTH 32
 
 static Transaction *
 transaction_new (QmiDevice           *self,
@@ -190,44 +678,275 @@ transaction_new (QmiDevice           *self,
                  gpointer             user_data)
 {
     Transaction *tr;
+    GList       *l;
 
-    tr = g_slice_new0 (Transaction);
+    l = g_queue_pop_head_link (&self->priv->transaction_pool);
+    if (l) {
+        tr = l->data;
+        memset (tr, 0, sizeof (Transaction));
+    } else
+        tr = g_slice_new0 (Transaction);
+
+    tr->self = self;
     tr->message = qmi_message_ref (message);
     tr->message_context = (message_context ? qmi_message_context_ref (message_context) : NULL);
-    tr->result = g_simple_async_result_new (G_OBJECT (self),
-                                            callback,
-                                            user_data,
-                                            transaction_new);
+    /* Cancellation is handled by the device itself, so the task doesn't
+     * get the cancellable */
+    tr->task = g_task_new (self, NULL, callback, user_data);
+    g_task_set_source_tag (tr->task, transaction_new);
     if (cancellable)
         tr->cancellable = g_object_ref (cancellable);
+    tr->metrics = message_metrics_request (self, message);
+    tr->start_time = g_get_monotonic_time ();
+    tr->completion_link.data = tr;
 
     return tr;
 }
 
+static void
+transaction_recycle (QmiDevice   *self,
+                     Transaction *tr)
+{
+    if (self->priv->transaction_pool.length >= TRANSACTION_POOL_MAX_LENGTH) {
+        g_slice_free (Transaction, tr);
+        return;
+    }
+
+    g_queue_push_head_link (&self->priv->transaction_pool, &tr->completion_link);
+}
+
+/*****************************************************************************/
+/* Completion queue
+ *
+ * Results are reported to the callers from a single source that stays
+ * attached while there are transactions in the device, and which is woken up
+ * whenever the queue goes from empty to non-empty; or, if synchronous
+ * completion is enabled, right after the input from the device has been
+ * processed. Results are never reported while a transaction is being
+ * completed, as the callers may issue new requests or complete other ones.
+ *
+ * The source is attached to the main context of the device; each GTask then
+ * takes care of running its callback in the context where the request was
+ * issued, so results for one context never wait for another one to be
+ * iterated.
+ */
+
+static void
+completion_queue_flush (QmiDevice *self)
+{
+    guint n_queued;
+
+    /* Callers may do anything in their callbacks, including unref-ing the
+     * device */
+    g_object_ref (self);
+
+    /* Items are always removed from the queue before being processed, as
+     * nested main loops may also flush the queue */
+    n_queued = self->priv->completion_queue.length;
+    while (n_queued-- > 0 && self->priv->completion_queue.length > 0) {
+        Transaction *tr;
+        GTask       *task;
+        QmiMessage  *reply;
+        GError      *error;
+
+        tr = g_queue_pop_head_link (&self->priv->completion_queue)->data;
+        tr->completion_queued = FALSE;
+        reply = g_steal_pointer (&tr->reply);
+        error = g_steal_pointer (&tr->error);
+
+        /* If the result was reported early, the transaction is still in
+         * flight, and it keeps its own task reference (and so the device
+         * alive) until complete. In any case it must not be used after
+         * reporting. */
+        if (tr->completed) {
+            task = g_steal_pointer (&tr->task);
+            transaction_recycle (self, tr);
+        } else
+            task = g_object_ref (tr->task);
+
+        if (reply)
+            g_task_return_pointer (task, reply, (GDestroyNotify)qmi_message_unref);
+        else
+            g_task_return_error (task, error);
+        g_object_unref (task);
+    }
+
+    if (self->priv->completion_queue.length > 0 && self->priv->completion_queue_source)
+        g_source_set_ready_time (self->priv->completion_queue_source, 0);
+
+    g_object_unref (self);
+}
+
+static gboolean
+completion_queue_source_dispatch (GSource     *source,
+                                  GSourceFunc  callback,
+                                  gpointer     user_data)
+{
+    /* Sleep until new results are queued */
+    g_source_set_ready_time (source, -1);
+    return callback (user_data);
+}
+
+static GSourceFuncs completion_queue_source_funcs = {
+    .dispatch = completion_queue_source_dispatch,
+};
+
+static gboolean
+completion_queue_dispatch_cb (QmiDevice *self)
+{
+    completion_queue_flush (self);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+completion_queue_push (QmiDevice   *self,
+                       Transaction *tr)
+{
+    if (!self->priv->completion_queue_source) {
+        self->priv->completion_queue_source = g_source_new (&completion_queue_source_funcs, sizeof (GSource));
+        g_source_set_priority (self->priv->completion_queue_source, G_PRIORITY_DEFAULT);
+        g_source_set_can_recurse (self->priv->completion_queue_source, TRUE);
+        g_source_set_callback (self->priv->completion_queue_source, (GSourceFunc)completion_queue_dispatch_cb, self, NULL);
+        g_source_attach (self->priv->completion_queue_source, self->priv->context);
+    }
+
+    tr->completion_queued = TRUE;
+    g_queue_push_tail_link (&self->priv->completion_queue, &tr->completion_link);
+
+    /* When synchronous completion is enabled the queue is flushed once the
+     * input has been processed; results available outside of the input
+     * processing (e.g. timeouts or cached responses) still use the source */
+    if (self->priv->synchronous_completion && self->priv->processing_input)
+        return;
+    if (self->priv->completion_queue.length == 1)
+        g_source_set_ready_time (self->priv->completion_queue_source, 0);
+}
+
+static void
+completion_queue_clear (QmiDevice *self)
+{
+    /* Queued transactions keep the device alive through their tasks, so the
+     * queue is always empty at this point */
+    g_assert (g_queue_is_empty (&self->priv->completion_queue));
+
+    if (self->priv->completion_queue_source) {
+        g_source_destroy (self->priv->completion_queue_source);
+        g_clear_pointer (&self->priv->completion_queue_source, g_source_unref);
+    }
+}
+
+void
+qmi_device_set_synchronous_completion (QmiDevice *self,
+                                       gboolean   enabled)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    self->priv->synchronous_completion = enabled;
+}
+
+/*****************************************************************************/
+
+/* Reports the result to the caller, which may happen before the transaction
+ * is complete if other requests are attached to it */
+static void
+transaction_report_result (Transaction  *tr,
+                           QmiMessage   *reply,
+                           const GError *error)
+{
+    g_assert (!tr->result_reported);
+
+    if (reply)
+        tr->reply = qmi_message_ref (reply);
+    else if (error)
+        tr->error = g_error_copy (error);
+    else
+        g_assert_not_reached ();
+
+    tr->result_reported = TRUE;
+    completion_queue_push (tr->self, tr);
+}
+
+/* Returns a copy of the reply, using the client and transaction ids of the
+ * given request */
+static QmiMessage *
+build_reply_for_request (QmiMessage *reply,
+                         QmiMessage *request)
+{
+    const guint8          *data;
+    gsize                  data_len;
+    g_autoptr(GByteArray)  qmi_data = NULL;
+    QmiMessage            *response;
+
+    data = qmi_message_get_data (reply, &data_len, NULL);
+    g_assert (data);
+    qmi_data = g_byte_array_sized_new (data_len);
+    g_byte_array_append (qmi_data, data, data_len);
+    response = qmi_message_new_from_data (qmi_message_get_service (request),
+                                          qmi_message_get_client_id (request),
+                                          qmi_data,
+                                          NULL);
+    if (response)
+        qmi_message_set_transaction_id (response, qmi_message_get_transaction_id (request));
+    return response;
+}
+
 static void
 transaction_complete_and_free (Transaction  *tr,
                                QmiMessage   *reply,
                                const GError *error)
 {
+    GList *l;
+
     g_assert (reply != NULL || error != NULL);
 
+    /* if we got a valid response, we can cancel any ongoing abort
+     * operation for this request */
+    if (reply && tr->abort_cancellable)
+        g_cancellable_cancel (tr->abort_cancellable);
+
     /* always set result first, as we may be using one of the GErrors
      * stored in the Transaction as result itself */
-    if (reply) {
-        /* if we got a valid response, we can cancel any ongoing abort
-         * operation for this request */
-        if (tr->abort_cancellable)
-            g_cancellable_cancel (tr->abort_cancellable);
-        g_simple_async_result_set_op_res_gpointer (tr->result,
-                                                   qmi_message_ref (reply),
-                                                   (GDestroyNotify)qmi_message_unref);
-    } else if (error)
-        g_simple_async_result_set_from_error (tr->result, error);
+    if (!tr->result_reported)
+        transaction_report_result (tr, reply, error);
+
+    message_metrics_complete (tr->metrics, tr->start_time, reply, tr->from_cache);
+
+    if (tr->window_queued)
+        request_window_unqueue (tr);
     else
-        g_assert_not_reached ();
+        request_window_release (tr);
+
+    if (tr->coalesced_with) {
+        g_queue_unlink (&tr->coalesced_with->coalesced, &tr->coalesced_link);
+        tr->coalesced_with = NULL;
+    }
+
+    if (tr->coalescing) {
+        g_hash_table_remove (tr->self->priv->coalescing_transactions, tr->message);
+        tr->coalescing = FALSE;
+    }
+
+    /* The requests attached to this one get the same result, with the reply
+     * matching each request */
+    while ((l = g_queue_peek_head_link (&tr->coalesced)) != NULL) {
+        Transaction          *attached = l->data;
+        g_autoptr(QmiMessage) attached_reply = NULL;
+        g_autoptr(GError)     attached_error = NULL;
+
+        if (reply) {
+            attached_reply = build_reply_for_request (reply, attached->message);
+            if (!attached_reply)
+                attached_error = g_error_new (QMI_CORE_ERROR,
+                                              QMI_CORE_ERROR_INVALID_MESSAGE,
+                                              "Couldn't build reply for attached request");
+        }
+        transaction_complete_and_free (attached,
+                                       attached_reply,
+                                       attached_error ? attached_error : error);
+    }
 
-    if (tr->timeout_source)
-        g_source_destroy (tr->timeout_source);
+    if (tr->timeout_tick)
+        timeout_wheel_remove (tr->self, tr);
 
     if (tr->cancellable) {
         if (tr->cancellable_id)
@@ -235,9 +954,6 @@ transaction_complete_and_free (Transaction  *tr,
         g_object_unref (tr->cancellable);
     }
 
-    if (tr->wait_ctx)
-        g_slice_free (TransactionWaitContext, tr->wait_ctx);
-
     if (tr->abort_error)
         g_error_free (tr->abort_error);
 
@@ -247,30 +963,44 @@ transaction_complete_and_free (Transaction  *tr,
     if (tr->abort_user_data && tr->abort_user_data_free)
         tr->abort_user_data_free (tr->abort_user_data);
 
-    g_simple_async_result_complete_in_idle (tr->result);
-    g_object_unref (tr->result);
+    if (tr->client) {
+        __qmi_client_set_transaction_in_flight (tr->client,
+                                                qmi_message_get_transaction_id (tr->message),
+                                                FALSE);
+        g_object_unref (tr->client);
+    }
+
     if (tr->message_context)
         qmi_message_context_unref (tr->message_context);
     qmi_message_unref (tr->message);
-    g_slice_free (Transaction, tr);
+
+    /* The record is recycled once the result has been reported */
+    tr->completed = TRUE;
+    if (!tr->completion_queued) {
+        GTask *task;
+
+        /* The task may be holding the last reference to the device */
+        task = g_steal_pointer (&tr->task);
+        transaction_recycle (tr->self, tr);
+        g_object_unref (task);
+    }
 }
 
 static inline gpointer
-build_transaction_key (QmiMessage *message)
+build_transaction_key_full (guint8  service,
+                            guint8  client_id,
+                            guint16 transaction_id)
 {
-    gpointer key;
-    guint8 service;
-    guint8 client_id;
-    guint16 transaction_id;
-
-    service = (guint8)qmi_message_get_service (message);
-    client_id = qmi_message_get_client_id (message);
-    transaction_id = qmi_message_get_transaction_id (message);
-
     /* We're putting a 32 bit value into a gpointer */
-    key = GUINT_TO_POINTER ((((service << 8) | client_id) << 16) | transaction_id);
+    return GUINT_TO_POINTER ((((service << 8) | client_id) << 16) | transaction_id);
+}
 
-    return key;
+static inline gpointer
+build_transaction_key (QmiMessage *message)
+{
+    return build_transaction_key_full ((guint8)qmi_message_get_service (message),
+                                       qmi_message_get_client_id (message),
+                                       qmi_message_get_transaction_id (message));
 }
 
 static Transaction *
@@ -280,6 +1010,15 @@ device_peek_transaction (QmiDevice *self,
     return g_hash_table_lookup (self->priv->transactions, key);
 }
 
+gboolean
+__qmi_device_is_transaction_in_flight (QmiDevice  *self,
+                                       QmiService  service,
+                                       guint8      cid,
+                                       guint16     transaction_id)
+{
+    return !!device_peek_transaction (self, build_transaction_key_full ((guint8)service, cid, transaction_id));
+}
+
 static Transaction *
 device_release_transaction (QmiDevice *self,
                             gconstpointer key)
@@ -406,6 +1145,10 @@ transaction_abort (QmiDevice   *self,
     tr->abort_error = abort_error_take;
     tr->abort_cancellable = g_cancellable_new ();
 
+    /* The request no longer counts in the window, or otherwise the abort
+     * request could end up queued behind it */
+    request_window_release (tr);
+
     qmi_device_command_full (self,
                              abort_request,
                              NULL,
@@ -417,31 +1160,111 @@ transaction_abort (QmiDevice   *self,
     qmi_message_unref (abort_request);
 }
 
-static gboolean
-transaction_timed_out (TransactionWaitContext *ctx)
+static void
+transaction_timed_out (QmiDevice   *self,
+                       Transaction *tr)
 {
-    Transaction *tr;
     GError *error = NULL;
 
     /* A timed out transaction is always tracked */
-    tr = device_peek_transaction (ctx->self, ctx->key);
-    g_assert (tr);
+    g_assert (device_peek_transaction (self, tr->wait_ctx->key) == tr);
 
-    tr->timeout_source = NULL;
+    tr->metrics->n_timeouts++;
 
     /* Increase number of consecutive timeouts */
-    ctx->self->priv->consecutive_timeouts++;
-    g_object_notify_by_pspec (G_OBJECT (ctx->self), properties[PROP_CONSECUTIVE_TIMEOUTS]);
+    self->priv->consecutive_timeouts++;
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_CONSECUTIVE_TIMEOUTS]);
     g_debug ("[%s] number of consecutive timeouts: %u",
-             qmi_file_get_path_display (ctx->self->priv->file),
-             ctx->self->priv->consecutive_timeouts);
+             qmi_file_get_path_display (self->priv->file),
+             self->priv->consecutive_timeouts);
 
     error = g_error_new (QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT, "Transaction timed out");
-    transaction_abort (ctx->self, tr, error);
+    transaction_abort (self, tr, error);
+}
+
+static void
+transaction_queued_timed_out (Transaction *tr)
+{
+    g_autoptr(GError) error = NULL;
+
+    /* The request was never sent, either because it was queued or because
+     * it was attached to another one, so this is not reported as a timeout
+     * of the device */
+    tr->metrics->n_timeouts++;
 
+    if (tr->coalesced_with)
+        error = g_error_new (QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT, "Transaction timed out");
+    else
+        error = g_error_new (QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT, "Transaction timed out while queued");
+    transaction_complete_and_free (tr, NULL, error);
+}
+
+static gboolean
+timeout_wheel_tick_cb (QmiDevice *self)
+{
+    guint64 previous_tick;
+    guint64 tick;
+    guint   n_slots;
+    guint   i;
+
+    previous_tick = self->priv->timeout_wheel_tick;
+    tick = (guint64)((g_get_monotonic_time () - self->priv->timeout_wheel_start) / G_USEC_PER_SEC);
+    self->priv->timeout_wheel_tick = tick;
+
+    /* If ticks were missed, each slot needs to be processed just once */
+    n_slots = (guint) MIN (tick - previous_tick, TIMEOUT_WHEEL_SLOTS);
+
+    for (i = 1; i <= n_slots; i++) {
+        GQueue      *slot;
+        Transaction *tr;
+
+        /* The slot is looked up again after each timeout, as the abort
+         * operation may add or remove transactions */
+        slot = &self->priv->timeout_wheel[(previous_tick + i) % TIMEOUT_WHEEL_SLOTS];
+        while ((tr = timeout_wheel_peek_expired (slot, tick)) != NULL) {
+            timeout_wheel_remove (self, tr);
+            if (tr->window_queued || tr->coalesced_with)
+                transaction_queued_timed_out (tr);
+            else
+                transaction_timed_out (self, tr);
+        }
+    }
+
+    if (self->priv->timeout_wheel_n_pending > 0)
+        return G_SOURCE_CONTINUE;
+
+    g_clear_pointer (&self->priv->timeout_wheel_source, g_source_unref);
     return G_SOURCE_REMOVE;
 }
 
+static void
+timeout_wheel_add (QmiDevice   *self,
+                   Transaction *tr,
+                   guint        timeout)
+{
+    gint64 now;
+
+    g_assert (!tr->timeout_tick);
+
+    now = g_get_monotonic_time ();
+
+    if (!self->priv->timeout_wheel_source) {
+        g_assert (self->priv->timeout_wheel_n_pending == 0);
+        self->priv->timeout_wheel_start = now;
+        self->priv->timeout_wheel_tick = 0;
+        self->priv->timeout_wheel_source = g_timeout_source_new_seconds (1);
+        g_source_set_callback (self->priv->timeout_wheel_source, (GSourceFunc)timeout_wheel_tick_cb, self, NULL);
+        g_source_attach (self->priv->timeout_wheel_source, self->priv->context);
+    }
+
+    /* Round up to the next tick, so that the transaction never times out
+     * earlier than requested */
+    tr->timeout_tick = (guint64)((now - self->priv->timeout_wheel_start + ((gint64)timeout + 1) * G_USEC_PER_SEC - 1) / G_USEC_PER_SEC);
+    tr->timeout_link.data = tr;
+    g_queue_push_tail_link (&self->priv->timeout_wheel[tr->timeout_tick % TIMEOUT_WHEEL_SLOTS], &tr->timeout_link);
+    self->priv->timeout_wheel_n_pending++;
+}
+
 static void
 transaction_cancelled (GCancellable *cancellable,
                        TransactionWaitContext *ctx)
@@ -449,18 +1272,51 @@ transaction_cancelled (GCancellable *cancellable,
     Transaction *tr;
     GError *error = NULL;
 
-    tr = device_peek_transaction (ctx->self, ctx->key);
+    tr = device_peek_transaction (ctx->self, ctx->key);
+
+    /* The transaction may have already been cancelled before we stored it in
+     * the tracking table, which means the command was NOT sent to the device
+     * and we can safely ignore the cancellation request. */
+    if (!tr)
+        return;
+
+    tr->cancellable_id = 0;
+
+    error = g_error_new (QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED, "Transaction aborted");
+
+    /* If other requests are attached to this one, it must not be aborted;
+     * only the cancellation of this request is reported */
+    if (!g_queue_is_empty (&tr->coalesced)) {
+        transaction_report_result (tr, NULL, error);
+        g_error_free (error);
+        return;
+    }
+
+    transaction_abort (ctx->self, tr, error);
+}
 
-    /* The transaction may have already been cancelled before we stored it in
-     * the tracking table, which means the command was NOT sent to the device
-     * and we can safely ignore the cancellation request. */
-    if (!tr)
-        return;
+static void
+transaction_queued_cancelled (GCancellable *cancellable,
+                              Transaction  *tr)
+{
+    g_autoptr(GError) error = NULL;
 
+    /* Not sent yet, so it can be completed right away, unless other requests
+     * are attached to it */
     tr->cancellable_id = 0;
 
     error = g_error_new (QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED, "Transaction aborted");
-    transaction_abort (ctx->self, tr, error);
+    if (g_queue_is_empty (&tr->coalesced)) {
+        transaction_complete_and_free (tr, NULL, error);
+        return;
+    }
+
+    /* The request is still sent for the ones attached to it, so the
+     * cancellable must not be considered any more once the cancellation has
+     * been reported; the handler cannot be disconnected from here, but it
+     * won't be called again */
+    transaction_report_result (tr, NULL, error);
+    g_clear_object (&tr->cancellable);
 }
 
 static gboolean
@@ -476,17 +1332,13 @@ device_store_transaction (QmiDevice *self,
 
     /* Setup the timeout and cancellation */
 
-    tr->wait_ctx = g_slice_new (TransactionWaitContext);
+    tr->wait_ctx = &tr->wait_ctx_data;
     tr->wait_ctx->self = self;
     tr->wait_ctx->key = key; /* valid as long as the transaction is in the HT */
 
     /* Timeout is optional (e.g. disabled when MBIM is used) */
-    if (timeout > 0) {
-        tr->timeout_source = g_timeout_source_new_seconds (timeout);
-        g_source_set_callback (tr->timeout_source, (GSourceFunc)transaction_timed_out, tr->wait_ctx, NULL);
-        g_source_attach (tr->timeout_source, g_main_context_get_thread_default ());
-        g_source_unref (tr->timeout_source);
-    }
+    if (timeout > 0)
+        timeout_wheel_add (self, tr, timeout);
 
     if (tr->cancellable) {
         /* Note: transaction_cancelled() will also be called directly if the
@@ -526,6 +1378,99 @@ device_store_transaction (QmiDevice *self,
     return TRUE;
 }
 
+static void
+request_window_enqueue (RequestWindow *window,
+                        Transaction   *tr,
+                        guint          timeout)
+{
+    g_assert (!tr->window);
+
+    tr->window = window;
+    tr->window_queued = TRUE;
+    tr->window_timeout = timeout;
+    tr->window_queued_time = g_get_monotonic_time ();
+    tr->window_link.data = tr;
+    g_queue_push_tail_link (&window->queue, &tr->window_link);
+
+    window->n_queued++;
+    if (window->queue.length > window->max_queue_length)
+        window->max_queue_length = window->queue.length;
+
+    if (timeout > 0)
+        timeout_wheel_add (window->self, tr, timeout);
+}
+
+static gboolean
+device_queue_transaction (QmiDevice      *self,
+                          RequestWindow  *window,
+                          Transaction    *tr,
+                          guint           timeout,
+                          GError        **error)
+{
+    /* Note: the cancellation handler would be called right away if
+     * connected to an already cancelled cancellable */
+    if (tr->cancellable && g_cancellable_is_cancelled (tr->cancellable)) {
+        g_set_error (error,
+                     QMI_PROTOCOL_ERROR,
+                     QMI_PROTOCOL_ERROR_ABORTED,
+                     "Request is already cancelled");
+        return FALSE;
+    }
+
+    request_window_enqueue (window, tr, timeout);
+
+    g_debug ("[%s] transaction 0x%x queued (%u requests of service '%s' waiting)",
+             qmi_file_get_path_display (self->priv->file),
+             qmi_message_get_transaction_id (tr->message),
+             window->queue.length,
+             qmi_service_get_string (window->service));
+
+    if (tr->cancellable)
+        tr->cancellable_id = g_cancellable_connect (tr->cancellable,
+                                                    (GCallback)transaction_queued_cancelled,
+                                                    tr,
+                                                    NULL);
+
+    return TRUE;
+}
+
+static gboolean
+device_attach_transaction (QmiDevice    *self,
+                           Transaction  *in_flight,
+                           Transaction  *tr,
+                           guint         timeout,
+                           GError      **error)
+{
+    if (tr->cancellable && g_cancellable_is_cancelled (tr->cancellable)) {
+        g_set_error (error,
+                     QMI_PROTOCOL_ERROR,
+                     QMI_PROTOCOL_ERROR_ABORTED,
+                     "Request is already cancelled");
+        return FALSE;
+    }
+
+    tr->coalesced_with = in_flight;
+    tr->coalesced_link.data = tr;
+    g_queue_push_tail_link (&in_flight->coalesced, &tr->coalesced_link);
+    tr->metrics->n_coalesced++;
+
+    g_debug ("[%s] transaction 0x%x attached to identical transaction 0x%x in flight",
+             qmi_file_get_path_display (self->priv->file),
+             qmi_message_get_transaction_id (tr->message),
+             qmi_message_get_transaction_id (in_flight->message));
+
+    if (timeout > 0)
+        timeout_wheel_add (self, tr, timeout);
+
+    if (tr->cancellable)
+        tr->cancellable_id = g_cancellable_connect (tr->cancellable,
+                                                    (GCallback)transaction_queued_cancelled,
+                                                    tr,
+                                                    NULL);
+
+    return TRUE;
+}
+
 static Transaction *
 device_match_transaction (QmiDevice *self,
                           QmiMessage *message)
@@ -552,6 +1497,15 @@ device_hangup_transactions (QmiDevice *self)
         transaction_complete_and_free (tr, NULL, common_error);
         g_hash_table_iter_remove (&iter);
     }
+
+    /* Requests not yet sent are also completed */
+    g_hash_table_iter_init (&iter, self->priv->request_windows);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        RequestWindow *window = value;
+
+        while (!g_queue_is_empty (&window->queue))
+            transaction_complete_and_free (g_queue_peek_head (&window->queue), NULL, common_error);
+    }
 }
 
 /*****************************************************************************/
@@ -564,6 +1518,92 @@ qmi_device_get_consecutive_timeouts (QmiDevice *self)
     return self->priv->consecutive_timeouts;
 }
 
+guint
+qmi_device_get_n_pending_transactions (QmiDevice *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+
+    return g_hash_table_size (self->priv->transactions);
+}
+
+void
+qmi_device_set_request_window (QmiDevice  *self,
+                               QmiService  service,
+                               guint       max_in_flight,
+                               guint       max_in_flight_per_client)
+{
+    RequestWindow *window;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    window = g_hash_table_lookup (self->priv->request_windows, GUINT_TO_POINTER (service));
+    if (!window) {
+        window = g_slice_new0 (RequestWindow);
+        window->self = self;
+        window->service = service;
+        g_queue_init (&window->queue);
+        g_hash_table_insert (self->priv->request_windows, GUINT_TO_POINTER (service), window);
+    }
+
+    window->max_in_flight = max_in_flight;
+    window->max_in_flight_per_client = max_in_flight_per_client;
+
+    /* The limits may have been increased */
+    request_window_schedule_dispatch (window);
+}
+
+void
+qmi_device_set_request_coalescing (QmiDevice  *self,
+                                   QmiService  service,
+                                   guint16     message_id,
+                                   gboolean    enabled)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service != QMI_SERVICE_CTL);
+
+    if (enabled)
+        g_hash_table_add (self->priv->coalesced_requests, build_message_key (service, message_id));
+    else
+        g_hash_table_remove (self->priv->coalesced_requests, build_message_key (service, message_id));
+}
+
+gboolean
+qmi_device_get_request_window_stats (QmiDevice  *self,
+                                     QmiService  service,
+                                     guint      *n_in_flight,
+                                     guint      *queue_length,
+                                     guint      *max_queue_length,
+                                     guint64    *n_queued,
+                                     guint64    *average_wait,
+                                     guint64    *max_wait)
+{
+    RequestWindow *window;
+    guint64        n_waited;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    window = g_hash_table_lookup (self->priv->request_windows, GUINT_TO_POINTER (service));
+    if (!window)
+        return FALSE;
+
+    /* Only the requests that already left the queue have a wait time */
+    n_waited = window->n_queued - window->queue.length;
+
+    if (n_in_flight)
+        *n_in_flight = window->n_in_flight;
+    if (queue_length)
+        *queue_length = window->queue.length;
+    if (max_queue_length)
+        *max_queue_length = window->max_queue_length;
+    if (n_queued)
+        *n_queued = window->n_queued;
+    if (average_wait)
+        *average_wait = n_waited ? (window->total_wait / n_waited) : 0;
+    if (max_wait)
+        *max_wait = window->max_wait;
+    return TRUE;
+}
+
 /*****************************************************************************/
 /* Version info request */
 
@@ -994,12 +2034,33 @@ build_registered_client_key (guint8 cid,
     return GUINT_TO_POINTER (((guint8)service << 8) | cid);
 }
 
+/* Marks the transaction id as in flight in the client owning it, so that the
+ * client doesn't reuse it until the transaction is complete */
+static void
+transaction_track_client (QmiDevice   *self,
+                          Transaction *tr)
+{
+    QmiClient *client;
+
+    client = g_hash_table_lookup (self->priv->registered_clients,
+                                  build_registered_client_key (qmi_message_get_client_id (tr->message),
+                                                               qmi_message_get_service (tr->message)));
+    if (!client)
+        return;
+
+    tr->client = g_object_ref (client);
+    __qmi_client_set_transaction_in_flight (tr->client,
+                                            qmi_message_get_transaction_id (tr->message),
+                                            TRUE);
+}
+
 static gboolean
 register_client (QmiDevice *self,
                  QmiClient *client,
                  GError **error)
 {
-    gpointer key;
+    gpointer   key;
+    GPtrArray *service_clients;
 
     key = build_registered_client_key (qmi_client_get_cid (client),
                                        qmi_client_get_service (client));
@@ -1018,16 +2079,384 @@ register_client (QmiDevice *self,
     g_hash_table_insert (self->priv->registered_clients,
                          key,
                          g_object_ref (client));
+
+    service_clients = g_hash_table_lookup (self->priv->registered_clients_by_service,
+                                           GUINT_TO_POINTER (qmi_client_get_service (client)));
+    if (!service_clients) {
+        service_clients = g_ptr_array_new ();
+        g_hash_table_insert (self->priv->registered_clients_by_service,
+                             GUINT_TO_POINTER (qmi_client_get_service (client)),
+                             service_clients);
+    }
+    g_ptr_array_add (service_clients, client);
     return TRUE;
 }
 
+static void
+unregister_service_client (QmiDevice *self,
+                           QmiClient *client)
+{
+    GPtrArray *service_clients;
+
+    service_clients = g_hash_table_lookup (self->priv->registered_clients_by_service,
+                                           GUINT_TO_POINTER (qmi_client_get_service (client)));
+    if (!service_clients)
+        return;
+
+    /* Keep registration order, so that broadcast indications are reported
+     * to the clients always in the same sequence */
+    g_ptr_array_remove (service_clients, client);
+    if (!service_clients->len)
+        g_hash_table_remove (self->priv->registered_clients_by_service,
+                             GUINT_TO_POINTER (qmi_client_get_service (client)));
+}
+
 static void
 unregister_client (QmiDevice *self,
                    QmiClient *client)
 {
-    g_hash_table_remove (self->priv->registered_clients,
-                         build_registered_client_key (qmi_client_get_cid (client),
-                                                      qmi_client_get_service (client)));
+    gpointer key;
+
+    key = build_registered_client_key (qmi_client_get_cid (client),
+                                       qmi_client_get_service (client));
+    if (g_hash_table_lookup (self->priv->registered_clients, key) != client)
+        return;
+
+    unregister_service_client (self, client);
+    g_hash_table_remove (self->priv->registered_clients, key);
+}
+
+/*****************************************************************************/
+/* CID pool */
+
+typedef struct {
+    QmiService service;
+    guint      size;
+    GQueue     cids;
+    guint      n_refilling;
+    guint64    n_hits;
+    guint64    n_misses;
+} CidPool;
+
+typedef struct {
+    QmiDevice  *self;
+    QmiService  service;
+    guint       generation;
+} CidPoolRefillContext;
+
+static void
+cid_pool_free (CidPool *pool)
+{
+    g_queue_clear (&pool->cids);
+    g_slice_free (CidPool, pool);
+}
+
+static void
+cid_pool_refill_context_free (CidPoolRefillContext *ctx)
+{
+    g_object_unref (ctx->self);
+    g_slice_free (CidPoolRefillContext, ctx);
+}
+
+static void
+cid_pool_release_cid_full (QmiDevice           *self,
+                           QmiService           service,
+                           guint8               cid,
+                           guint                timeout,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    g_debug ("[%s] releasing pooled '%s' client ID '%u'...",
+             qmi_file_get_path_display (self->priv->file),
+             qmi_service_get_string (service),
+             cid);
+
+    /* The result is never checked, if the release fails the CID is lost
+     * anyway; the callback only tells when the request is done */
+    /* 8-bit service */
+    if (service <= G_MAXUINT8) {
+        g_autoptr(QmiMessageCtlReleaseCidInput) input = NULL;
+
+        input = qmi_message_ctl_release_cid_input_new ();
+        qmi_message_ctl_release_cid_input_set_release_info (input, service, cid, NULL);
+        qmi_client_ctl_release_cid (self->priv->client_ctl, input, timeout, NULL, callback, user_data);
+    }
+    /* 16-bit service */
+    else if (service <= G_MAXUINT16) {
+        g_autoptr(QmiMessageCtlInternalReleaseCidQrtrInput) input = NULL;
+
+        input = qmi_message_ctl_internal_release_cid_qrtr_input_new ();
+        qmi_message_ctl_internal_release_cid_qrtr_input_set_release_info (input, service, cid, NULL);
+        qmi_client_ctl_internal_release_cid_qrtr (self->priv->client_ctl, input, timeout, NULL, callback, user_data);
+    } else
+        g_assert_not_reached ();
+}
+
+static void
+cid_pool_release_cid (QmiDevice  *self,
+                      QmiService  service,
+                      guint8      cid)
+{
+    cid_pool_release_cid_full (self, service, cid, 10, NULL, NULL);
+}
+
+static void
+cid_pool_refill_completed (CidPoolRefillContext *ctx,
+                           QmiService            service,
+                           guint8                cid,
+                           GError               *error)
+{
+    QmiDevice *self = ctx->self;
+    CidPool   *pool;
+
+    /* The client ids allocated before a close or a sync are no longer valid */
+    if (ctx->generation != self->priv->cid_pool_generation) {
+        cid_pool_refill_context_free (ctx);
+        return;
+    }
+
+    pool = g_hash_table_lookup (self->priv->cid_pools, GUINT_TO_POINTER (ctx->service));
+    if (pool && pool->n_refilling > 0)
+        pool->n_refilling--;
+
+    if (error) {
+        g_debug ("[%s] couldn't refill '%s' client ID pool: %s",
+                 qmi_file_get_path_display (self->priv->file),
+                 qmi_service_get_string (ctx->service),
+                 error->message);
+    } else if (service != ctx->service) {
+        g_debug ("[%s] couldn't refill '%s' client ID pool: service mismatch (got '%s')",
+                 qmi_file_get_path_display (self->priv->file),
+                 qmi_service_get_string (ctx->service),
+                 qmi_service_get_string (service));
+    } else if (pool && pool->cids.length < pool->size) {
+        g_queue_push_tail (&pool->cids, GUINT_TO_POINTER ((guint) cid));
+    } else {
+        /* Pool removed or shrunk in the meantime */
+        cid_pool_release_cid (self, service, cid);
+    }
+
+    cid_pool_refill_context_free (ctx);
+}
+
+#define CID_POOL_REFILL_READY(MessageName, message_name)                        \
+static void                                                                     \
+cid_pool_##message_name##_ready (QmiClientCtl         *client_ctl,              \
+                                 GAsyncResult         *res,                     \
+                                 CidPoolRefillContext *ctx)                     \
+{                                                                               \
+    g_autoptr(QmiMessageCtl##MessageName##Output) output = NULL;                \
+    QmiService        service = QMI_SERVICE_UNKNOWN;                            \
+    guint8            cid = QMI_CID_NONE;                                       \
+    g_autoptr(GError) error = NULL;                                             \
+                                                                                \
+    output = qmi_client_ctl_##message_name##_finish (client_ctl, res, &error);  \
+    if (output &&                                                               \
+        qmi_message_ctl_##message_name##_output_get_result (output, &error))    \
+        qmi_message_ctl_##message_name##_output_get_allocation_info (           \
+            output, &service, &cid, NULL);                                      \
+    cid_pool_refill_completed (ctx, service, cid, error);                       \
+}
+
+CID_POOL_REFILL_READY (AllocateCid,             allocate_cid)
+CID_POOL_REFILL_READY (InternalAllocateCidQrtr, internal_allocate_cid_qrtr)
+
+static void
+cid_pool_refill (QmiDevice *self,
+                 CidPool   *pool)
+{
+    /* Client ids can only be allocated while the device is open */
+    if (!qmi_device_is_open (self))
+        return;
+
+    while (pool->cids.length + pool->n_refilling < pool->size) {
+        CidPoolRefillContext *ctx;
+
+        ctx = g_slice_new (CidPoolRefillContext);
+        ctx->self = g_object_ref (self);
+        ctx->service = pool->service;
+        ctx->generation = self->priv->cid_pool_generation;
+        pool->n_refilling++;
+
+        /* 8-bit service */
+        if (pool->service <= G_MAXUINT8) {
+            g_autoptr(QmiMessageCtlAllocateCidInput) input = NULL;
+
+            input = qmi_message_ctl_allocate_cid_input_new ();
+            qmi_message_ctl_allocate_cid_input_set_service (input, pool->service, NULL);
+            qmi_client_ctl_allocate_cid (self->priv->client_ctl,
+                                         input,
+                                         10,
+                                         NULL,
+                                         (GAsyncReadyCallback)cid_pool_allocate_cid_ready,
+                                         ctx);
+        }
+        /* 16-bit service */
+        else if (pool->service <= G_MAXUINT16) {
+            g_autoptr(QmiMessageCtlInternalAllocateCidQrtrInput) input = NULL;
+
+            input = qmi_message_ctl_internal_allocate_cid_qrtr_input_new ();
+            qmi_message_ctl_internal_allocate_cid_qrtr_input_set_service (input, pool->service, NULL);
+            qmi_client_ctl_internal_allocate_cid_qrtr (self->priv->client_ctl,
+                                                       input,
+                                                       10,
+                                                       NULL,
+                                                       (GAsyncReadyCallback)cid_pool_internal_allocate_cid_qrtr_ready,
+                                                       ctx);
+        } else
+            g_assert_not_reached ();
+    }
+}
+
+static void
+cid_pool_refill_all (QmiDevice *self)
+{
+    GHashTableIter  iter;
+    CidPool        *pool;
+
+    g_hash_table_iter_init (&iter, self->priv->cid_pools);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&pool))
+        cid_pool_refill (self, pool);
+}
+
+static void
+cid_pool_invalidate_all (QmiDevice *self)
+{
+    GHashTableIter  iter;
+    CidPool        *pool;
+
+    /* Allocations in flight are ignored when they complete */
+    self->priv->cid_pool_generation++;
+    g_hash_table_iter_init (&iter, self->priv->cid_pools);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&pool)) {
+        g_queue_clear (&pool->cids);
+        pool->n_refilling = 0;
+    }
+}
+
+/* Releases all the pooled client ids, calling @callback once per release
+ * request done; returns the number of requests */
+static guint
+cid_pool_release_all (QmiDevice           *self,
+                      guint                timeout,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+    GHashTableIter  iter;
+    CidPool        *pool;
+    guint           n_released = 0;
+
+    if (!qmi_device_is_open (self))
+        return 0;
+
+    g_hash_table_iter_init (&iter, self->priv->cid_pools);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&pool)) {
+        while (!g_queue_is_empty (&pool->cids)) {
+            cid_pool_release_cid_full (self,
+                                       pool->service,
+                                       (guint8) GPOINTER_TO_UINT (g_queue_pop_head (&pool->cids)),
+                                       timeout,
+                                       callback,
+                                       user_data);
+            n_released++;
+        }
+    }
+    return n_released;
+}
+
+static gboolean
+cid_pool_take (QmiDevice  *self,
+               QmiService  service,
+               guint8     *cid)
+{
+    CidPool *pool;
+
+    pool = g_hash_table_lookup (self->priv->cid_pools, GUINT_TO_POINTER (service));
+    if (!pool)
+        return FALSE;
+
+    if (g_queue_is_empty (&pool->cids)) {
+        pool->n_misses++;
+        cid_pool_refill (self, pool);
+        return FALSE;
+    }
+
+    pool->n_hits++;
+    *cid = (guint8) GPOINTER_TO_UINT (g_queue_pop_head (&pool->cids));
+    cid_pool_refill (self, pool);
+    return TRUE;
+}
+
+static gboolean
+cid_pool_put (QmiDevice  *self,
+              QmiService  service,
+              guint8      cid)
+{
+    CidPool *pool;
+
+    pool = g_hash_table_lookup (self->priv->cid_pools, GUINT_TO_POINTER (service));
+    if (!pool || !qmi_device_is_open (self) || pool->cids.length >= pool->size)
+        return FALSE;
+
+    g_queue_push_tail (&pool->cids, GUINT_TO_POINTER ((guint) cid));
+    return TRUE;
+}
+
+void
+qmi_device_set_cid_pool_size (QmiDevice  *self,
+                              QmiService  service,
+                              guint       size)
+{
+    CidPool *pool;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (service != QMI_SERVICE_UNKNOWN && service != QMI_SERVICE_CTL);
+
+    pool = g_hash_table_lookup (self->priv->cid_pools, GUINT_TO_POINTER (service));
+    if (!pool) {
+        if (!size)
+            return;
+        pool = g_slice_new0 (CidPool);
+        pool->service = service;
+        g_queue_init (&pool->cids);
+        g_hash_table_insert (self->priv->cid_pools, GUINT_TO_POINTER (service), pool);
+    }
+
+    pool->size = size;
+    while (pool->cids.length > pool->size)
+        cid_pool_release_cid (self, service, (guint8) GPOINTER_TO_UINT (g_queue_pop_tail (&pool->cids)));
+
+    if (!size) {
+        /* Allocations in flight are released when they complete */
+        g_hash_table_remove (self->priv->cid_pools, GUINT_TO_POINTER (service));
+        return;
+    }
+
+    cid_pool_refill (self, pool);
+}
+
+gboolean
+qmi_device_get_cid_pool_stats (QmiDevice  *self,
+                               QmiService  service,
+                               guint      *n_available,
+                               guint64    *n_hits,
+                               guint64    *n_misses)
+{
+    CidPool *pool;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    pool = g_hash_table_lookup (self->priv->cid_pools, GUINT_TO_POINTER (service));
+    if (!pool)
+        return FALSE;
+
+    if (n_available)
+        *n_available = pool->cids.length;
+    if (n_hits)
+        *n_hits = pool->n_hits;
+    if (n_misses)
+        *n_misses = pool->n_misses;
+    return TRUE;
 }
 
 /*****************************************************************************/
@@ -1385,6 +2814,14 @@ qmi_device_allocate_client (QmiDevice           *self,
         return;
     }
 
+    /* Take a CID from the pool, if any */
+    if (cid == QMI_CID_NONE && cid_pool_take (self, ctx->service, &cid)) {
+        g_debug ("[%s] using pooled client CID '%u'...", qmi_file_get_path_display (self->priv->file), cid);
+        ctx->cid = cid;
+        build_client_object (task);
+        return;
+    }
+
     /* Allocate a new CID for the client to be created */
     if (cid == QMI_CID_NONE) {
         g_debug ("[%s] allocating new client ID...",
@@ -1426,6 +2863,165 @@ qmi_device_allocate_client (QmiDevice           *self,
     build_client_object (task);
 }
 
+/*****************************************************************************/
+/* Allocate multiple clients */
+
+typedef struct {
+    GPtrArray *clients;
+    GPtrArray *errors;
+    guint      n_pending;
+    guint      n_failed;
+} AllocateClientsContext;
+
+typedef struct {
+    GTask *task;
+    guint  index;
+} AllocateClientsItem;
+
+static void
+allocate_clients_context_free (AllocateClientsContext *ctx)
+{
+    g_ptr_array_unref (ctx->clients);
+    g_ptr_array_unref (ctx->errors);
+    g_slice_free (AllocateClientsContext, ctx);
+}
+
+static void
+allocate_clients_free_client (gpointer client)
+{
+    if (client)
+        g_object_unref (client);
+}
+
+static void
+allocate_clients_free_error (gpointer error)
+{
+    if (error)
+        g_error_free (error);
+}
+
+GPtrArray *
+qmi_device_allocate_clients_finish (QmiDevice     *self,
+                                    GAsyncResult  *res,
+                                    GPtrArray    **errors,
+                                    GError       **error)
+{
+    AllocateClientsContext *ctx;
+    GPtrArray              *clients;
+
+    clients = g_task_propagate_pointer (G_TASK (res), error);
+    if (!clients)
+        return NULL;
+
+    ctx = g_task_get_task_data (G_TASK (res));
+    if (errors)
+        *errors = g_ptr_array_ref (ctx->errors);
+    return clients;
+}
+
+static void
+allocate_clients_ready (QmiDevice           *self,
+                        GAsyncResult        *res,
+                        AllocateClientsItem *item)
+{
+    AllocateClientsContext *ctx;
+    QmiClient              *client;
+    GError                 *error = NULL;
+    GTask                  *task;
+
+    task = item->task;
+    ctx = g_task_get_task_data (task);
+
+    client = qmi_device_allocate_client_finish (self, res, &error);
+    if (!client) {
+        g_debug ("[%s] couldn't allocate client %u: %s",
+                 qmi_file_get_path_display (self->priv->file),
+                 item->index, error->message);
+        ctx->n_failed++;
+    }
+    g_ptr_array_index (ctx->clients, item->index) = client;
+    g_ptr_array_index (ctx->errors, item->index) = error;
+    g_slice_free (AllocateClientsItem, item);
+
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending > 0)
+        return;
+
+    /* Only fail the whole operation if no client at all could be allocated */
+    if (ctx->n_failed > 0 && ctx->n_failed == ctx->clients->len) {
+        g_task_return_error (task, g_error_copy (g_ptr_array_index (ctx->errors, 0)));
+        g_object_unref (task);
+        return;
+    }
+
+    g_task_return_pointer (task, g_ptr_array_ref (ctx->clients), (GDestroyNotify) g_ptr_array_unref);
+    g_object_unref (task);
+}
+
+void
+qmi_device_allocate_clients (QmiDevice                    *self,
+                             const QmiDeviceClientRequest *requests,
+                             guint                         n_requests,
+                             guint                         timeout,
+                             GCancellable                 *cancellable,
+                             GAsyncReadyCallback           callback,
+                             gpointer                      user_data)
+{
+    AllocateClientsContext *ctx;
+    GTask                  *task;
+    guint                   i;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (requests || !n_requests);
+
+    ctx = g_slice_new0 (AllocateClientsContext);
+    ctx->clients = g_ptr_array_new_full (n_requests, allocate_clients_free_client);
+    ctx->errors = g_ptr_array_new_full (n_requests, allocate_clients_free_error);
+    g_ptr_array_set_size (ctx->clients, n_requests);
+    g_ptr_array_set_size (ctx->errors, n_requests);
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    g_task_set_task_data (task,
+                          ctx,
+                          (GDestroyNotify)allocate_clients_context_free);
+
+    for (i = 0; i < n_requests; i++) {
+        if (requests[i].service == QMI_SERVICE_UNKNOWN) {
+            g_task_return_new_error (task, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS,
+                                     "Invalid service given in client request %u", i);
+            g_object_unref (task);
+            return;
+        }
+    }
+
+    if (!n_requests) {
+        g_task_return_pointer (task, g_ptr_array_ref (ctx->clients), (GDestroyNotify) g_ptr_array_unref);
+        g_object_unref (task);
+        return;
+    }
+
+    g_debug ("[%s] allocating %u clients in parallel...",
+             qmi_file_get_path_display (self->priv->file), n_requests);
+
+    /* All the requests are launched right away; the CTL client handles each
+     * allocation as an independent transaction, so they run concurrently */
+    ctx->n_pending = n_requests;
+    for (i = 0; i < n_requests; i++) {
+        AllocateClientsItem *item;
+
+        item = g_slice_new (AllocateClientsItem);
+        item->task = task;
+        item->index = i;
+        qmi_device_allocate_client (self,
+                                    requests[i].service,
+                                    requests[i].cid,
+                                    timeout,
+                                    cancellable,
+                                    (GAsyncReadyCallback) allocate_clients_ready,
+                                    item);
+    }
+}
+
 /*****************************************************************************/
 /* Release client */
 
@@ -1532,6 +3128,18 @@ qmi_device_release_client (QmiDevice                   *self,
     }
     g_object_unref (client);
 
+    /* Keep the CID for the next client if requested and there's a pool with
+     * room for it */
+    if ((flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) &&
+        (flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RETURN_TO_POOL) &&
+        cid_pool_put (self, service, cid)) {
+        g_debug ("[%s] returned client ID '%u' to the pool",
+                 qmi_file_get_path_display (self->priv->file), cid);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
     /* And now, really try to release the CID */
     if (flags & QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID) {
         /* 8-bit service */
@@ -1564,162 +3172,614 @@ qmi_device_release_client (QmiDevice                   *self,
         return;
     }
 
-    /* No need to release the CID, so just done */
-    g_task_return_boolean (task, TRUE);
-    g_object_unref (task);
-    return;
+    /* No need to release the CID, so just done */
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+    return;
+}
+
+/*****************************************************************************/
+/* Set instance ID */
+
+gboolean
+qmi_device_set_instance_id_finish (QmiDevice *self,
+                                   GAsyncResult *res,
+                                   guint16 *link_id,
+                                   GError **error)
+{
+    gssize value;
+
+    value = g_task_propagate_int (G_TASK (res), error);
+    if (value == -1)
+        return FALSE;
+
+    if (link_id)
+        *link_id = (guint16)value;
+
+    return TRUE;
+}
+
+static void
+set_instance_id_ready (QmiClientCtl *client_ctl,
+                       GAsyncResult *res,
+                       GTask *task)
+{
+    QmiMessageCtlSetInstanceIdOutput *output;
+    GError *error = NULL;
+
+    /* Check result of the async operation */
+    output = qmi_client_ctl_set_instance_id_finish (client_ctl, res, &error);
+    if (!output)
+        g_task_return_error (task, error);
+    else {
+        /* Check result of the QMI operation */
+        if (!qmi_message_ctl_set_instance_id_output_get_result (output, &error))
+            g_task_return_error (task, error);
+        else {
+            guint16 link_id;
+
+            qmi_message_ctl_set_instance_id_output_get_link_id (output, &link_id, NULL);
+            g_task_return_int (task, link_id);
+        }
+        qmi_message_ctl_set_instance_id_output_unref (output);
+    }
+
+    g_object_unref (task);
+}
+
+void
+qmi_device_set_instance_id (QmiDevice *self,
+                            guint8 instance_id,
+                            guint timeout,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    GTask *task;
+    QmiMessageCtlSetInstanceIdInput *input;
+
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    input = qmi_message_ctl_set_instance_id_input_new ();
+    qmi_message_ctl_set_instance_id_input_set_id (
+        input,
+        instance_id,
+        NULL);
+    qmi_client_ctl_set_instance_id (self->priv->client_ctl,
+                                    input,
+                                    timeout,
+                                    cancellable,
+                                    (GAsyncReadyCallback)set_instance_id_ready,
+                                    task);
+    qmi_message_ctl_set_instance_id_input_unref (input);
+}
+
+/*****************************************************************************/
+/* Input channel processing */
+
+static void process_message (QmiMessage *message, QmiDevice *self);
+
+static void
+input_processed (QmiDevice *self)
+{
+    self->priv->processing_input = FALSE;
+
+    /* Report the results right away, instead of waiting for the next main
+     * loop iteration */
+    if (self->priv->synchronous_completion) {
+        gboolean completing_input;
+
+        completing_input = self->priv->completing_input;
+        self->priv->completing_input = TRUE;
+        completion_queue_flush (self);
+        self->priv->completing_input = completing_input;
+    }
+}
+
+static void
+endpoint_new_data_cb (QmiEndpoint *endpoint,
+                      QmiDevice   *self)
+{
+    GError *error = NULL;
+
+    self->priv->processing_input = TRUE;
+    if (!qmi_endpoint_parse_buffer (endpoint,
+                                    (QmiMessageHandler)process_message,
+                                    self,
+                                    &error)) {
+        g_warning ("[%s] parsing error: %s",
+                   qmi_file_get_path_display (self->priv->file), error->message);
+        g_error_free (error);
+    }
+    input_processed (self);
+}
+
+static void
+endpoint_new_message_cb (QmiEndpoint *endpoint,
+                         QmiMessage  *message,
+                         QmiDevice   *self)
+{
+    self->priv->processing_input = TRUE;
+    process_message (message, self);
+    input_processed (self);
+}
+
+static void
+endpoint_send_failed_cb (QmiEndpoint  *endpoint,
+                         QmiMessage   *message,
+                         const GError *error,
+                         QmiDevice    *self)
+{
+    Transaction *tr;
+    gpointer     key;
+
+    /* The transaction may have already been completed, e.g. if it timed out
+     * while still waiting to be written */
+    key = build_transaction_key (message);
+    tr = device_peek_transaction (self, key);
+    if (!tr || tr->message != message)
+        return;
+
+    tr = device_release_transaction (self, key);
+    transaction_complete_and_free (tr, NULL, error);
+}
+
+static void
+endpoint_hangup_cb (QmiEndpoint *endpoint,
+                    QmiDevice   *self)
+{
+    g_debug ("[%s] endpoint hangup: removed",
+             qmi_file_get_path_display (self->priv->file));
+
+    /* cancel all ongoing transactions as the endpoing hangup happened */
+    device_hangup_transactions (self);
+    response_cache_clear (self, QMI_SERVICE_UNKNOWN, -1);
+    cid_pool_invalidate_all (self);
+
+    g_signal_emit (self, signals[SIGNAL_REMOVED], 0);
+}
+
+/*****************************************************************************/
+/* Indication queue
+ *
+ * Indications are reported to the clients from a single source that stays
+ * attached while the device exists, and which is woken up whenever the queue
+ * goes from empty to non-empty. Each dispatch reports the indications that
+ * were queued when it started, in order; the ones queued while reporting are
+ * left for the next main loop iteration.
+ */
+
+typedef struct {
+    GList       link;
+    QmiClient  *client;
+    QmiMessage *message;
+} QueuedIndication;
+
+static void
+queued_indication_free (QueuedIndication *queued)
+{
+    g_object_unref (queued->client);
+    qmi_message_unref (queued->message);
+    g_slice_free (QueuedIndication, queued);
+}
+
+static gboolean
+indication_queue_source_dispatch (GSource     *source,
+                                  GSourceFunc  callback,
+                                  gpointer     user_data)
+{
+    /* Sleep until new indications are queued */
+    g_source_set_ready_time (source, -1);
+    return callback (user_data);
+}
+
+static GSourceFuncs indication_queue_source_funcs = {
+    .dispatch = indication_queue_source_dispatch,
+};
+
+static gboolean
+indication_queue_dispatch_cb (QmiDevice *self)
+{
+    guint n_queued;
+
+    /* Clients may do anything in their signal handlers, including unref-ing
+     * the device */
+    g_object_ref (self);
+
+    /* Items are always removed from the queue before being processed, as
+     * nested main loops may also dispatch the queue */
+    n_queued = self->priv->indication_queue.length;
+    while (n_queued-- > 0 && self->priv->indication_queue.length > 0) {
+        QueuedIndication *queued;
+
+        queued = g_queue_pop_head_link (&self->priv->indication_queue)->data;
+        __qmi_client_process_indication (queued->client, queued->message);
+        queued_indication_free (queued);
+    }
+
+    if (self->priv->indication_queue.length > 0 && self->priv->indication_queue_source)
+        g_source_set_ready_time (self->priv->indication_queue_source, 0);
+
+    g_object_unref (self);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+report_indication (QmiDevice  *self,
+                   QmiClient  *client,
+                   QmiMessage *message)
+{
+    QueuedIndication *queued;
+
+    if (!self->priv->indication_queue_source) {
+        self->priv->indication_queue_source = g_source_new (&indication_queue_source_funcs, sizeof (GSource));
+        g_source_set_priority (self->priv->indication_queue_source, G_PRIORITY_DEFAULT);
+        g_source_set_can_recurse (self->priv->indication_queue_source, TRUE);
+        g_source_set_callback (self->priv->indication_queue_source, (GSourceFunc)indication_queue_dispatch_cb, self, NULL);
+        g_source_attach (self->priv->indication_queue_source, self->priv->context);
+    }
+
+    queued = g_slice_new (QueuedIndication);
+    queued->client = g_object_ref (client);
+    queued->message = qmi_message_ref (message);
+    queued->link.data = queued;
+    queued->link.prev = NULL;
+    queued->link.next = NULL;
+
+    g_queue_push_tail_link (&self->priv->indication_queue, &queued->link);
+    if (self->priv->indication_queue.length == 1)
+        g_source_set_ready_time (self->priv->indication_queue_source, 0);
+}
+
+static void
+indication_queue_clear (QmiDevice *self)
+{
+    GList *l;
+
+    if (self->priv->indication_queue_source) {
+        g_source_destroy (self->priv->indication_queue_source);
+        g_clear_pointer (&self->priv->indication_queue_source, g_source_unref);
+    }
+
+    while ((l = g_queue_pop_head_link (&self->priv->indication_queue)) != NULL)
+        queued_indication_free (l->data);
 }
 
-/*****************************************************************************/
-/* Set instance ID */
+guint
+qmi_device_get_n_queued_indications (QmiDevice *self)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), 0);
+
+    return self->priv->indication_queue.length;
+}
 
 gboolean
-qmi_device_set_instance_id_finish (QmiDevice *self,
-                                   GAsyncResult *res,
-                                   guint16 *link_id,
-                                   GError **error)
+qmi_device_get_input_stats (QmiDevice *self,
+                            guint64   *n_wakeups,
+                            guint64   *n_reads,
+                            guint64   *n_bytes,
+                            guint     *max_reads_per_wakeup,
+                            gsize     *max_bytes_per_wakeup)
 {
-    gssize value;
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
 
-    value = g_task_propagate_int (G_TASK (res), error);
-    if (value == -1)
+    if (!self->priv->endpoint || !QMI_IS_ENDPOINT_QMUX (self->priv->endpoint))
         return FALSE;
 
-    if (link_id)
-        *link_id = (guint16)value;
+    qmi_endpoint_qmux_get_input_stats (QMI_ENDPOINT_QMUX (self->priv->endpoint),
+                                       n_wakeups,
+                                       n_reads,
+                                       n_bytes,
+                                       max_reads_per_wakeup,
+                                       max_bytes_per_wakeup);
+    return TRUE;
+}
+
+gboolean
+qmi_device_get_output_stats (QmiDevice *self,
+                             guint     *queue_length,
+                             guint     *max_queue_length,
+                             guint64   *n_writes,
+                             guint64   *n_messages,
+                             guint64   *average_latency,
+                             guint64   *max_latency)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    if (!self->priv->endpoint || !QMI_IS_ENDPOINT_QMUX (self->priv->endpoint))
+        return FALSE;
 
+    qmi_endpoint_qmux_get_output_stats (QMI_ENDPOINT_QMUX (self->priv->endpoint),
+                                        queue_length,
+                                        max_queue_length,
+                                        n_writes,
+                                        n_messages,
+                                        average_latency,
+                                        max_latency);
     return TRUE;
 }
 
+/*****************************************************************************/
+
 static void
-set_instance_id_ready (QmiClientCtl *client_ctl,
-                       GAsyncResult *res,
-                       GTask *task)
+ensure_simulated_config (QmiDevice *self)
 {
-    QmiMessageCtlSetInstanceIdOutput *output;
-    GError *error = NULL;
-
-    /* Check result of the async operation */
-    output = qmi_client_ctl_set_instance_id_finish (client_ctl, res, &error);
-    if (!output)
-        g_task_return_error (task, error);
-    else {
-        /* Check result of the QMI operation */
-        if (!qmi_message_ctl_set_instance_id_output_get_result (output, &error))
-            g_task_return_error (task, error);
-        else {
-            guint16 link_id;
+    if (self->priv->simulated_responses)
+        return;
 
-            qmi_message_ctl_set_instance_id_output_get_link_id (output, &link_id, NULL);
-            g_task_return_int (task, link_id);
-        }
-        qmi_message_ctl_set_instance_id_output_unref (output);
-    }
+    self->priv->simulated_responses = g_hash_table_new_full (g_direct_hash,
+                                                             g_direct_equal,
+                                                             NULL,
+                                                             (GDestroyNotify)qmi_simulated_response_free);
+    self->priv->simulated_indications = g_ptr_array_new_with_free_func ((GDestroyNotify)qmi_simulated_indication_free);
+}
 
-    g_object_unref (task);
+void
+qmi_device_add_simulated_response (QmiDevice  *self,
+                                   QmiMessage *response,
+                                   guint       latency_ms)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (response != NULL);
+    g_return_if_fail (qmi_message_is_response (response));
+
+    ensure_simulated_config (self);
+    g_hash_table_replace (self->priv->simulated_responses,
+                          qmi_simulated_response_key (qmi_message_get_service (response),
+                                                      qmi_message_get_message_id (response)),
+                          qmi_simulated_response_new (response, latency_ms));
 }
 
 void
-qmi_device_set_instance_id (QmiDevice *self,
-                            guint8 instance_id,
-                            guint timeout,
-                            GCancellable *cancellable,
-                            GAsyncReadyCallback callback,
-                            gpointer user_data)
+qmi_device_add_simulated_indication (QmiDevice  *self,
+                                     QmiMessage *indication,
+                                     guint       interval_ms)
 {
-    GTask *task;
-    QmiMessageCtlSetInstanceIdInput *input;
+    QmiSimulatedIndication *simulated;
 
     g_return_if_fail (QMI_IS_DEVICE (self));
+    g_return_if_fail (indication != NULL);
+    g_return_if_fail (qmi_message_is_indication (indication));
+    g_return_if_fail (interval_ms > 0);
 
-    task = g_task_new (self, cancellable, callback, user_data);
+    ensure_simulated_config (self);
+    simulated = qmi_simulated_indication_new (indication, interval_ms);
+    g_ptr_array_add (self->priv->simulated_indications, simulated);
 
-    input = qmi_message_ctl_set_instance_id_input_new ();
-    qmi_message_ctl_set_instance_id_input_set_id (
-        input,
-        instance_id,
-        NULL);
-    qmi_client_ctl_set_instance_id (self->priv->client_ctl,
-                                    input,
-                                    timeout,
-                                    cancellable,
-                                    (GAsyncReadyCallback)set_instance_id_ready,
-                                    task);
-    qmi_message_ctl_set_instance_id_input_unref (input);
+    /* Already running? */
+    if (self->priv->endpoint && QMI_IS_ENDPOINT_SIMULATED (self->priv->endpoint))
+        qmi_endpoint_simulated_start_indication (QMI_ENDPOINT_SIMULATED (self->priv->endpoint), simulated);
 }
 
 /*****************************************************************************/
-/* Input channel processing */
+/* Response cache
+ *
+ * Successful responses to the requests with a TTL configured are kept, keyed
+ * by the service, message id and TLVs of the request, and reused for
+ * identical requests until they expire. The cache is cleared whenever the
+ * device is open, closed, removed or resynchronized.
+ *
+ * Expired entries are only dropped when looked up, or when the cache is full
+ * and a new response needs to be stored, in which case the oldest entry is
+ * dropped if none has expired.
+ */
 
-static void process_message (QmiMessage *message, QmiDevice *self);
+#define RESPONSE_CACHE_MAX_ENTRIES 256
+
+typedef struct {
+    QmiMessage *request;
+    QmiMessage *response;
+    gint64      store_time;
+    gint64      expiration_time; /* 0 if it never expires */
+} ResponseCacheEntry;
 
 static void
-endpoint_new_data_cb (QmiEndpoint *endpoint,
-                      QmiDevice   *self)
+response_cache_entry_free (ResponseCacheEntry *entry)
 {
-    GError *error = NULL;
+    qmi_message_unref (entry->request);
+    qmi_message_unref (entry->response);
+    g_slice_free (ResponseCacheEntry, entry);
+}
 
-    if (!qmi_endpoint_parse_buffer (endpoint,
-                                    (QmiMessageHandler)process_message,
-                                    self,
-                                    &error)) {
-        g_warning ("[%s] parsing error: %s",
-                   qmi_file_get_path_display (self->priv->file), error->message);
-        g_error_free (error);
+static guint
+response_cache_get_ttl (QmiDevice         *self,
+                        QmiMessage        *request,
+                        QmiMessageContext *message_context)
+{
+    /* Vendor-specific requests are never cached, as the contents of the
+     * response depend on the context */
+    if (message_context)
+        return 0;
+
+    return GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->response_cache_ttls,
+                                                  build_message_key (qmi_message_get_service (request),
+                                                                     qmi_message_get_message_id (request))));
+}
+
+static gboolean
+response_is_successful (QmiMessage *response)
+{
+    gsize   init_offset;
+    gsize   offset = 0;
+    guint16 status;
+
+    init_offset = qmi_message_tlv_read_init (response, 0x02, NULL, NULL);
+    return (init_offset &&
+            qmi_message_tlv_read_guint16 (response, init_offset, &offset, QMI_ENDIAN_LITTLE, &status, NULL) &&
+            status == 0);
+}
+
+/* Returns a copy of the cached response, using the client and transaction ids
+ * of the request */
+static QmiMessage *
+response_cache_lookup (QmiDevice         *self,
+                       QmiMessage        *request,
+                       QmiMessageContext *message_context)
+{
+    ResponseCacheEntry *entry;
+    QmiMessage         *response;
+
+    if (!response_cache_get_ttl (self, request, message_context))
+        return NULL;
+
+    entry = g_hash_table_lookup (self->priv->response_cache, request);
+    if (entry && entry->expiration_time && entry->expiration_time <= g_get_monotonic_time ()) {
+        g_hash_table_remove (self->priv->response_cache, request);
+        entry = NULL;
+    }
+    if (!entry) {
+        self->priv->response_cache_n_misses++;
+        return NULL;
+    }
+
+    response = build_reply_for_request (entry->response, request);
+    if (!response)
+        return NULL;
+
+    self->priv->response_cache_n_hits++;
+    return response;
+}
+
+static void
+response_cache_make_room (QmiDevice *self,
+                          gint64     now)
+{
+    GHashTableIter      iter;
+    ResponseCacheEntry *entry;
+    ResponseCacheEntry *oldest = NULL;
+    gboolean            expired = FALSE;
+
+    g_hash_table_iter_init (&iter, self->priv->response_cache);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+        if (entry->expiration_time && entry->expiration_time <= now) {
+            g_hash_table_iter_remove (&iter);
+            expired = TRUE;
+        } else if (!oldest || entry->store_time < oldest->store_time)
+            oldest = entry;
     }
+
+    if (!expired && oldest)
+        g_hash_table_remove (self->priv->response_cache, oldest->request);
 }
 
 static void
-endpoint_hangup_cb (QmiEndpoint *endpoint,
-                    QmiDevice   *self)
+response_cache_store (QmiDevice         *self,
+                      QmiMessage        *request,
+                      QmiMessageContext *message_context,
+                      QmiMessage        *response)
 {
-    g_debug ("[%s] endpoint hangup: removed",
-             qmi_file_get_path_display (self->priv->file));
+    ResponseCacheEntry *entry;
+    guint               ttl;
+    gint64              now;
 
-    /* cancel all ongoing transactions as the endpoing hangup happened */
-    device_hangup_transactions (self);
+    ttl = response_cache_get_ttl (self, request, message_context);
+    if (!ttl || !response_is_successful (response))
+        return;
 
-    g_signal_emit (self, signals[SIGNAL_REMOVED], 0);
+    now = g_get_monotonic_time ();
+    if (g_hash_table_size (self->priv->response_cache) >= RESPONSE_CACHE_MAX_ENTRIES &&
+        !g_hash_table_contains (self->priv->response_cache, request))
+        response_cache_make_room (self, now);
+
+    entry = g_slice_new0 (ResponseCacheEntry);
+    entry->request = qmi_message_ref (request);
+    entry->response = qmi_message_ref (response);
+    entry->store_time = now;
+    if (ttl != QMI_DEVICE_RESPONSE_CACHE_TTL_FOREVER)
+        entry->expiration_time = now + ((gint64) ttl * 1000);
+    g_hash_table_replace (self->priv->response_cache, entry->request, entry);
 }
 
-typedef struct {
-    QmiClient *client;
-    QmiMessage *message;
-} IdleIndicationContext;
+static void
+response_cache_clear (QmiDevice  *self,
+                      QmiService  service,
+                      gint        message_id)
+{
+    GHashTableIter      iter;
+    ResponseCacheEntry *entry;
+
+    g_hash_table_iter_init (&iter, self->priv->response_cache);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+        if ((service == QMI_SERVICE_UNKNOWN || qmi_message_get_service (entry->request) == service) &&
+            (message_id < 0 || qmi_message_get_message_id (entry->request) == message_id))
+            g_hash_table_iter_remove (&iter);
+    }
+}
 
-static gboolean
-process_indication_idle (IdleIndicationContext *ctx)
+static void
+response_cache_process_indication (QmiDevice  *self,
+                                   QmiMessage *indication)
 {
-    g_assert (ctx->client != NULL);
-    g_assert (ctx->message != NULL);
+    if (g_hash_table_contains (self->priv->response_cache_invalidations,
+                               build_message_key (qmi_message_get_service (indication),
+                                                  qmi_message_get_message_id (indication)))) {
+        g_debug ("[%s] cached responses of service '%s' invalidated",
+                 qmi_file_get_path_display (self->priv->file),
+                 qmi_service_get_string (qmi_message_get_service (indication)));
+        response_cache_clear (self, qmi_message_get_service (indication), -1);
+    }
+}
 
-    __qmi_client_process_indication (ctx->client, ctx->message);
+void
+qmi_device_set_response_cache_ttl (QmiDevice  *self,
+                                   QmiService  service,
+                                   guint16     message_id,
+                                   guint       ttl_ms)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
 
-    g_object_unref (ctx->client);
-    qmi_message_unref (ctx->message);
-    g_slice_free (IdleIndicationContext, ctx);
-    return FALSE;
+    if (ttl_ms)
+        g_hash_table_insert (self->priv->response_cache_ttls,
+                             build_message_key (service, message_id),
+                             GUINT_TO_POINTER (ttl_ms));
+    else
+        g_hash_table_remove (self->priv->response_cache_ttls,
+                             build_message_key (service, message_id));
+
+    /* Entries cached with the previous TTL are no longer valid */
+    response_cache_clear (self, service, message_id);
 }
 
-static void
-report_indication (QmiClient *client,
-                   QmiMessage *message)
+void
+qmi_device_add_response_cache_invalidation (QmiDevice  *self,
+                                            QmiService  service,
+                                            guint16     indication_id)
 {
-    IdleIndicationContext *ctx;
-    GSource *source;
+    g_return_if_fail (QMI_IS_DEVICE (self));
 
-    /* Setup an idle to Pass the indication down to the client */
-    ctx = g_slice_new (IdleIndicationContext);
-    ctx->client = g_object_ref (client);
-    ctx->message = qmi_message_ref (message);
+    g_hash_table_add (self->priv->response_cache_invalidations,
+                      build_message_key (service, indication_id));
+}
+
+void
+qmi_device_invalidate_response_cache (QmiDevice  *self,
+                                      QmiService  service)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
+
+    response_cache_clear (self, service, -1);
+}
+
+void
+qmi_device_get_response_cache_stats (QmiDevice *self,
+                                     guint     *n_entries,
+                                     guint64   *n_hits,
+                                     guint64   *n_misses)
+{
+    g_return_if_fail (QMI_IS_DEVICE (self));
 
-    source = g_idle_source_new ();
-    g_source_set_priority (source, G_PRIORITY_DEFAULT);
-    g_source_set_callback (source, (GSourceFunc)process_indication_idle, ctx, NULL);
-    g_source_attach (source, g_main_context_get_thread_default ());
-    g_source_unref (source);
+    if (n_entries)
+        *n_entries = g_hash_table_size (self->priv->response_cache);
+    if (n_hits)
+        *n_hits = self->priv->response_cache_n_hits;
+    if (n_misses)
+        *n_misses = self->priv->response_cache_n_misses;
 }
 
+/*****************************************************************************/
+
 static void
 trace_message (QmiDevice         *self,
                QmiMessage        *message,
@@ -1792,20 +3852,21 @@ process_message (QmiMessage *message,
         /* Indication traces translated without an explicit vendor */
         trace_message (self, message, FALSE, "indication", NULL);
 
+        indication_metrics_report (self, message);
+        response_cache_process_indication (self, message);
+
         /* Generic emission of the indication */
         g_signal_emit (self, signals[SIGNAL_INDICATION], 0, message);
 
         if (qmi_message_get_client_id (message) == QMI_CID_BROADCAST) {
-            GHashTableIter iter;
-            gpointer key;
-            QmiClient *client;
-
-            g_hash_table_iter_init (&iter, self->priv->registered_clients);
-            while (g_hash_table_iter_next (&iter, &key, (gpointer *)&client)) {
-                /* For broadcast messages, report them just if the service matches */
-                if (qmi_message_get_service (message) == qmi_client_get_service (client))
-                    report_indication (client, message);
-            }
+            GPtrArray *service_clients;
+            guint      i;
+
+            /* For broadcast messages, report them to all clients of the service */
+            service_clients = g_hash_table_lookup (self->priv->registered_clients_by_service,
+                                                   GUINT_TO_POINTER (qmi_message_get_service (message)));
+            for (i = 0; service_clients && i < service_clients->len; i++)
+                report_indication (self, g_ptr_array_index (service_clients, i), message);
         } else {
             QmiClient *client;
 
@@ -1813,7 +3874,7 @@ process_message (QmiMessage *message,
                                           build_registered_client_key (qmi_message_get_client_id (message),
                                                                        qmi_message_get_service (message)));
             if (client)
-                report_indication (client, message);
+                report_indication (self, client, message);
         }
 
         return;
@@ -1865,6 +3926,7 @@ process_message (QmiMessage *message,
 
         /* Matched transactions translated with the same context as the request */
         trace_message (self, message, FALSE, "response", tr->message_context);
+        response_cache_store (self, tr->message, tr->message_context, message);
         /* Report the reply message */
         transaction_complete_and_free (tr, message, NULL);
         return;
@@ -2165,16 +4227,202 @@ qmi_device_list_links (QmiDevice    *self,
                                             error);
 }
 
-/*****************************************************************************/
-
-gboolean
-qmi_device_check_link_supported (QmiDevice  *self,
-                                 GError    **error)
+/*****************************************************************************/
+
+gboolean
+qmi_device_check_link_supported (QmiDevice  *self,
+                                 GError    **error)
+{
+    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+
+    /* if we can setup a net port manager, link management is supported */
+    return setup_net_port_manager (self, error);
+}
+
+/*****************************************************************************/
+/* Version info cache
+ *
+ * The list of services supported by the device is stored in a key file, in a
+ * group named after the device path, along with the firmware identifier given
+ * by the user. When the device is open again with the same firmware, the
+ * cached list is used right away, and the actual one is requested in the
+ * background to update the cache if needed.
+ */
+
+#define VERSION_INFO_CACHE_KEY_FIRMWARE_ID         "firmware-id"
+#define VERSION_INFO_CACHE_KEY_SERVICES            "services"
+#define VERSION_INFO_CACHE_VALIDATION_TIMEOUT_SECS 10
+
+static GArray *
+version_info_cache_load (QmiDevice *self)
+{
+    g_autoptr(GKeyFile)  key_file = NULL;
+    g_autoptr(GError)    error = NULL;
+    g_autofree gchar    *firmware_id = NULL;
+    g_autofree gint     *values = NULL;
+    gsize                n_values = 0;
+    GArray              *service_list;
+    gsize                i;
+
+    key_file = g_key_file_new ();
+    if (!g_key_file_load_from_file (key_file, self->priv->version_info_cache_path, G_KEY_FILE_NONE, &error)) {
+        g_debug ("[%s] couldn't load version info cache: %s",
+                 qmi_file_get_path_display (self->priv->file), error->message);
+        return NULL;
+    }
+
+    firmware_id = g_key_file_get_string (key_file, qmi_file_get_path (self->priv->file), VERSION_INFO_CACHE_KEY_FIRMWARE_ID, NULL);
+    if (g_strcmp0 (firmware_id, self->priv->version_info_cache_firmware_id) != 0)
+        return NULL;
+
+    /* Stored as a flat list of service, major and minor version triplets */
+    values = g_key_file_get_integer_list (key_file, qmi_file_get_path (self->priv->file), VERSION_INFO_CACHE_KEY_SERVICES, &n_values, NULL);
+    if (!values || !n_values || (n_values % 3) != 0)
+        return NULL;
+
+    service_list = g_array_sized_new (FALSE, FALSE, sizeof (QmiMessageCtlGetVersionInfoOutputServiceListService), n_values / 3);
+    for (i = 0; i < n_values; i += 3) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService info;
+
+        info.service = (QmiService) values[i];
+        info.major_version = (guint16) values[i + 1];
+        info.minor_version = (guint16) values[i + 2];
+        g_array_append_val (service_list, info);
+    }
+    return service_list;
+}
+
+static void
+version_info_cache_store (QmiDevice *self,
+                          GArray    *service_list)
+{
+    g_autoptr(GKeyFile)  key_file = NULL;
+    g_autoptr(GError)    error = NULL;
+    g_autofree gint     *values = NULL;
+    guint                i;
+
+    if (!self->priv->version_info_cache_path)
+        return;
+
+    /* Keep the entries of other devices, if any */
+    key_file = g_key_file_new ();
+    g_key_file_load_from_file (key_file, self->priv->version_info_cache_path, G_KEY_FILE_NONE, NULL);
+
+    values = g_new (gint, service_list->len * 3);
+    for (i = 0; i < service_list->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *info;
+
+        info = &g_array_index (service_list, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        values[(i * 3)]     = (gint) info->service;
+        values[(i * 3) + 1] = (gint) info->major_version;
+        values[(i * 3) + 2] = (gint) info->minor_version;
+    }
+
+    g_key_file_remove_group (key_file, qmi_file_get_path (self->priv->file), NULL);
+    if (self->priv->version_info_cache_firmware_id)
+        g_key_file_set_string (key_file, qmi_file_get_path (self->priv->file), VERSION_INFO_CACHE_KEY_FIRMWARE_ID,
+                               self->priv->version_info_cache_firmware_id);
+    g_key_file_set_integer_list (key_file, qmi_file_get_path (self->priv->file), VERSION_INFO_CACHE_KEY_SERVICES,
+                                 values, service_list->len * 3);
+
+    if (!g_key_file_save_to_file (key_file, self->priv->version_info_cache_path, &error))
+        g_warning ("[%s] couldn't store version info cache: %s",
+                   qmi_file_get_path_display (self->priv->file), error->message);
+}
+
+static gboolean
+service_lists_equal (GArray *a,
+                     GArray *b)
+{
+    guint i;
+
+    if (a->len != b->len)
+        return FALSE;
+
+    for (i = 0; i < a->len; i++) {
+        QmiMessageCtlGetVersionInfoOutputServiceListService *a_info;
+        QmiMessageCtlGetVersionInfoOutputServiceListService *b_info;
+
+        a_info = &g_array_index (a, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        b_info = &g_array_index (b, QmiMessageCtlGetVersionInfoOutputServiceListService, i);
+        if (a_info->service != b_info->service ||
+            a_info->major_version != b_info->major_version ||
+            a_info->minor_version != b_info->minor_version)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+version_info_cache_validate_ready (QmiClientCtl *client_ctl,
+                                   GAsyncResult *res,
+                                   QmiDevice    *self)
+{
+    g_autoptr(QmiMessageCtlGetVersionInfoOutput) output = NULL;
+    g_autoptr(GError)                            error = NULL;
+    GArray                                      *service_list = NULL;
+
+    output = qmi_client_ctl_get_version_info_finish (client_ctl, res, &error);
+    if (!output || !qmi_message_ctl_get_version_info_output_get_result (output, &error)) {
+        /* Keep on using the cached list */
+        g_debug ("[%s] couldn't validate cached version info: %s",
+                 qmi_file_get_path_display (self->priv->file), error->message);
+        g_object_unref (self);
+        return;
+    }
+
+    qmi_message_ctl_get_version_info_output_get_service_list (output, &service_list, NULL);
+    if (!self->priv->supported_services || !service_lists_equal (self->priv->supported_services, service_list)) {
+        g_debug ("[%s] cached version info is outdated: device supports %u services",
+                 qmi_file_get_path_display (self->priv->file), service_list->len);
+        g_clear_pointer (&self->priv->supported_services, g_array_unref);
+        self->priv->supported_services = g_array_ref (service_list);
+        version_info_cache_store (self, service_list);
+    } else
+        g_debug ("[%s] cached version info validated",
+                 qmi_file_get_path_display (self->priv->file));
+
+    g_object_unref (self);
+}
+
+static gboolean
+version_info_cache_apply (QmiDevice *self)
+{
+    GArray *service_list;
+
+    if (!self->priv->version_info_cache_path)
+        return FALSE;
+
+    service_list = version_info_cache_load (self);
+    if (!service_list)
+        return FALSE;
+
+    g_debug ("[%s] device supports %u services (cached), validating in the background...",
+             qmi_file_get_path_display (self->priv->file),
+             service_list->len);
+    g_clear_pointer (&self->priv->supported_services, g_array_unref);
+    self->priv->supported_services = service_list;
+
+    qmi_client_ctl_get_version_info (self->priv->client_ctl,
+                                     NULL,
+                                     VERSION_INFO_CACHE_VALIDATION_TIMEOUT_SECS,
+                                     NULL,
+                                     (GAsyncReadyCallback)version_info_cache_validate_ready,
+                                     g_object_ref (self));
+    return TRUE;
+}
+
+void
+qmi_device_set_version_info_cache (QmiDevice   *self,
+                                   const gchar *path,
+                                   const gchar *firmware_id)
 {
-    g_return_val_if_fail (QMI_IS_DEVICE (self), FALSE);
+    g_return_if_fail (QMI_IS_DEVICE (self));
 
-    /* if we can setup a net port manager, link management is supported */
-    return setup_net_port_manager (self, error);
+    g_free (self->priv->version_info_cache_path);
+    self->priv->version_info_cache_path = g_strdup (path);
+    g_free (self->priv->version_info_cache_firmware_id);
+    self->priv->version_info_cache_firmware_id = g_strdup (firmware_id);
 }
 
 /*****************************************************************************/
@@ -2390,6 +4638,7 @@ open_version_info_ready (QmiClientCtl *client_ctl,
 
     g_clear_pointer (&self->priv->supported_services, g_array_unref);
     self->priv->supported_services = g_array_ref (service_list);
+    version_info_cache_store (self, service_list);
 
     g_debug ("[%s] device supports %u services:",
              qmi_file_get_path_display (self->priv->file),
@@ -2508,7 +4757,12 @@ static void
 device_create_endpoint (QmiDevice *self,
                         DeviceOpenContext *ctx)
 {
-    if (!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)) {
+    if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_SIMULATED) {
+        ensure_simulated_config (self);
+        self->priv->endpoint = QMI_ENDPOINT (qmi_endpoint_simulated_new (self->priv->file,
+                                                                         self->priv->simulated_responses,
+                                                                         self->priv->simulated_indications));
+    } else if (!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_MBIM)) {
 #if QMI_QRTR_SUPPORTED
         /* We talk to proxies over QMUX even if they are proxying a QRTR device. */
         if (self->priv->node && !(ctx->flags & QMI_DEVICE_OPEN_FLAGS_PROXY)) {
@@ -2518,7 +4772,9 @@ device_create_endpoint (QmiDevice *self,
         {
             self->priv->endpoint = QMI_ENDPOINT (qmi_endpoint_qmux_new (self->priv->file,
                                                                         self->priv->proxy_path,
-                                                                        self->priv->client_ctl));
+                                                                        self->priv->client_ctl,
+                                                                        self->priv->read_size,
+                                                                        !!(ctx->flags & QMI_DEVICE_OPEN_FLAGS_IO_THREAD)));
         }
     }
 #if defined MBIM_QMUX_ENABLED
@@ -2534,6 +4790,14 @@ device_create_endpoint (QmiDevice *self,
                                                          QMI_ENDPOINT_SIGNAL_NEW_DATA,
                                                          G_CALLBACK (endpoint_new_data_cb),
                                                          self);
+    self->priv->endpoint_new_message_id = g_signal_connect (self->priv->endpoint,
+                                                            QMI_ENDPOINT_SIGNAL_NEW_MESSAGE,
+                                                            G_CALLBACK (endpoint_new_message_cb),
+                                                            self);
+    self->priv->endpoint_send_failed_id = g_signal_connect (self->priv->endpoint,
+                                                            QMI_ENDPOINT_SIGNAL_SEND_FAILED,
+                                                            G_CALLBACK (endpoint_send_failed_cb),
+                                                            self);
     self->priv->endpoint_hangup_id = g_signal_connect (self->priv->endpoint,
                                                        QMI_ENDPOINT_SIGNAL_HANGUP,
                                                        G_CALLBACK (endpoint_hangup_cb),
@@ -2624,10 +4888,17 @@ device_open_step (GTask *task)
 
     switch (ctx->step) {
     case DEVICE_OPEN_CONTEXT_STEP_FIRST:
+        response_cache_clear (self, QMI_SERVICE_UNKNOWN, -1);
+        cid_pool_invalidate_all (self);
         ctx->step++;
         /* Fall through */
 
     case DEVICE_OPEN_CONTEXT_STEP_DRIVER:
+        if (ctx->flags & QMI_DEVICE_OPEN_FLAGS_SIMULATED) {
+            g_debug ("[%s] selecting QMI mode for simulated endpoint",
+                     qmi_file_get_path_display (self->priv->file));
+            ctx->flags &= ~QMI_DEVICE_OPEN_FLAGS_MBIM;
+        } else
 #if QMI_QRTR_SUPPORTED
         if (self->priv->node) {
             g_debug ("[%s] selecting QMI mode for QRTR endpoint",
@@ -2681,6 +4952,10 @@ device_open_step (GTask *task)
             }
             else
 #endif
+            if (version_info_cache_apply (self)) {
+                ctx->step++;
+                device_open_step (task);
+            } else
                 qmi_client_ctl_get_version_info (self->priv->client_ctl,
                                                 NULL,
                                                 1,
@@ -2755,6 +5030,7 @@ device_open_step (GTask *task)
 
     case DEVICE_OPEN_CONTEXT_STEP_LAST:
         /* Nothing else to process, done we are */
+        cid_pool_refill_all (self);
         g_task_return_boolean (task, TRUE);
         g_object_unref (task);
         return;
@@ -2816,16 +5092,29 @@ qmi_device_open (QmiDevice *self,
 typedef struct {
     QmiEndpoint *endpoint;
     guint        endpoint_new_data_id;
+    guint        endpoint_new_message_id;
+    guint        endpoint_send_failed_id;
     guint        endpoint_hangup_id;
+    guint        timeout;
+    guint        n_releasing_cids;
 } CloseContext;
 
 static void
 close_context_free (CloseContext *ctx)
 {
+    if (!ctx->endpoint) {
+        g_slice_free (CloseContext, ctx);
+        return;
+    }
+
     if (ctx->endpoint_hangup_id)
         g_signal_handler_disconnect (ctx->endpoint, ctx->endpoint_hangup_id);
     if (ctx->endpoint_new_data_id)
         g_signal_handler_disconnect (ctx->endpoint, ctx->endpoint_new_data_id);
+    if (ctx->endpoint_new_message_id)
+        g_signal_handler_disconnect (ctx->endpoint, ctx->endpoint_new_message_id);
+    if (ctx->endpoint_send_failed_id)
+        g_signal_handler_disconnect (ctx->endpoint, ctx->endpoint_send_failed_id);
     g_object_unref (ctx->endpoint);
     g_slice_free (CloseContext, ctx);
 }
@@ -2852,17 +5141,14 @@ endpoint_close_ready (QmiEndpoint  *endpoint,
     g_object_unref (task);
 }
 
-void
-qmi_device_close_async (QmiDevice           *self,
-                        guint                timeout,
-                        GCancellable        *cancellable,
-                        GAsyncReadyCallback  callback,
-                        gpointer             user_data)
+static void
+close_endpoint (GTask *task)
 {
-    GTask        *task;
+    QmiDevice    *self;
     CloseContext *ctx;
 
-    task = g_task_new (self, cancellable, callback, user_data);
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
 
     /* if already closed, we're done */
     if (!self->priv->endpoint) {
@@ -2873,21 +5159,65 @@ qmi_device_close_async (QmiDevice           *self,
 
     /* Steal endpoint setup from private info, it will be freed once
      * the task is completed and disposed */
-    ctx = g_slice_new0 (CloseContext);
     ctx->endpoint = g_steal_pointer (&self->priv->endpoint);
     ctx->endpoint_new_data_id = self->priv->endpoint_new_data_id;
     self->priv->endpoint_new_data_id = 0;
+    ctx->endpoint_new_message_id = self->priv->endpoint_new_message_id;
+    self->priv->endpoint_new_message_id = 0;
+    ctx->endpoint_send_failed_id = self->priv->endpoint_send_failed_id;
+    self->priv->endpoint_send_failed_id = 0;
     ctx->endpoint_hangup_id = self->priv->endpoint_hangup_id;
     self->priv->endpoint_hangup_id = 0;
-    g_task_set_task_data (task, ctx, (GDestroyNotify) close_context_free);
 
     qmi_endpoint_close (ctx->endpoint,
-                        timeout,
-                        cancellable,
+                        ctx->timeout,
+                        g_task_get_cancellable (task),
                         (GAsyncReadyCallback)endpoint_close_ready,
                         task);
 }
 
+static void
+close_release_cid_ready (QmiClientCtl *client_ctl,
+                         GAsyncResult *res,
+                         GTask        *task)
+{
+    CloseContext *ctx;
+
+    /* The result is ignored, the port is closed anyway */
+    ctx = g_task_get_task_data (task);
+    g_assert (ctx->n_releasing_cids > 0);
+    if (--ctx->n_releasing_cids == 0)
+        close_endpoint (task);
+}
+
+void
+qmi_device_close_async (QmiDevice           *self,
+                        guint                timeout,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+    GTask        *task;
+    CloseContext *ctx;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+    ctx = g_slice_new0 (CloseContext);
+    ctx->timeout = timeout;
+    g_task_set_task_data (task, ctx, (GDestroyNotify) close_context_free);
+
+    response_cache_clear (self, QMI_SERVICE_UNKNOWN, -1);
+
+    /* Pooled client ids are released while the port is still open, and the
+     * port closed once all the releases are done */
+    ctx->n_releasing_cids = cid_pool_release_all (self,
+                                                  MAX (timeout, 1),
+                                                  (GAsyncReadyCallback)close_release_cid_ready,
+                                                  task);
+    cid_pool_invalidate_all (self);
+    if (!ctx->n_releasing_cids)
+        close_endpoint (task);
+}
+
 /*****************************************************************************/
 /* Command */
 
@@ -2896,11 +5226,7 @@ qmi_device_command_abortable_finish (QmiDevice     *self,
                                      GAsyncResult  *res,
                                      GError       **error)
 {
-    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
-        return NULL;
-
-    return qmi_message_ref (g_simple_async_result_get_op_res_gpointer (
-                                G_SIMPLE_ASYNC_RESULT (res)));
+    return g_task_propagate_pointer (G_TASK (res), error);
 }
 
 static void
@@ -2920,6 +5246,130 @@ transaction_early_error (QmiDevice   *self,
     g_error_free (error);
 }
 
+/* Requests are identical if they only differ in the client and transaction
+ * ids, which are not part of the TLVs */
+static guint
+coalesced_request_hash (QmiMessage *message)
+{
+    const guint8 *tlvs;
+    gsize         tlvs_length;
+    gsize         i;
+    guint         hash;
+
+    hash = GPOINTER_TO_UINT (build_message_key (qmi_message_get_service (message),
+                                                qmi_message_get_message_id (message)));
+    tlvs = __qmi_message_get_tlvs (message, &tlvs_length);
+    for (i = 0; i < tlvs_length; i++)
+        hash = (hash * 31) + tlvs[i];
+    return hash;
+}
+
+static gboolean
+coalesced_request_equal (QmiMessage *a,
+                         QmiMessage *b)
+{
+    const guint8 *a_tlvs;
+    const guint8 *b_tlvs;
+    gsize         a_tlvs_length;
+    gsize         b_tlvs_length;
+
+    if (qmi_message_get_service (a) != qmi_message_get_service (b) ||
+        qmi_message_get_message_id (a) != qmi_message_get_message_id (b))
+        return FALSE;
+
+    a_tlvs = __qmi_message_get_tlvs (a, &a_tlvs_length);
+    b_tlvs = __qmi_message_get_tlvs (b, &b_tlvs_length);
+    return (a_tlvs_length == b_tlvs_length && memcmp (a_tlvs, b_tlvs, a_tlvs_length) == 0);
+}
+
+static gboolean
+request_is_coalesced (QmiDevice         *self,
+                      QmiMessage        *message,
+                      QmiMessageContext *message_context)
+{
+    /* Vendor-specific requests are never coalesced, as the contents of the
+     * response depend on the context */
+    if (message_context)
+        return FALSE;
+
+    return g_hash_table_contains (self->priv->coalesced_requests,
+                                  build_message_key (qmi_message_get_service (message),
+                                                     qmi_message_get_message_id (message)));
+}
+
+static void
+transaction_send (QmiDevice   *self,
+                  Transaction *tr,
+                  guint        timeout)
+{
+    GError *error = NULL;
+
+    /* Setup context to match response */
+    if (!device_store_transaction (self, tr, timeout, &error)) {
+        g_prefix_error (&error, "Cannot store transaction: ");
+        transaction_early_error (self, tr, FALSE, error);
+        return;
+    }
+
+    /* From now on, if we want to complete the transaction with an early error,
+     *  it needs to be removed from the tracking table as well. */
+
+    trace_message (self, tr->message, TRUE, "request", tr->message_context);
+
+    tr->metrics->bytes_out += qmi_message_get_length (tr->message);
+    if (!qmi_endpoint_send (self->priv->endpoint, tr->message, timeout, tr->cancellable, &error)) {
+        transaction_early_error (self, tr, TRUE, error);
+        return;
+    }
+}
+
+static gboolean
+request_window_dispatch_cb (RequestWindow *window)
+{
+    QmiDevice *self;
+    GList     *l;
+
+    self = window->self;
+    g_clear_pointer (&window->dispatch_source, g_source_unref);
+
+    /* Sending may complete other transactions, so the queue is walked again
+     * from the head after each request sent */
+    l = window->queue.head;
+    while (l) {
+        Transaction *tr = l->data;
+        GError      *error;
+        guint        timeout;
+
+        /* Requests of other clients may still fit */
+        if (!request_window_has_room (window, qmi_message_get_client_id (tr->message))) {
+            if (window->max_in_flight && window->n_in_flight >= window->max_in_flight)
+                break;
+            l = g_list_next (l);
+            continue;
+        }
+
+        timeout = request_window_unqueue (tr);
+        if (tr->cancellable_id) {
+            g_cancellable_disconnect (tr->cancellable, tr->cancellable_id);
+            tr->cancellable_id = 0;
+        }
+
+        if (!qmi_device_is_open (self)) {
+            error = g_error_new (QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Device must be open to send commands");
+            transaction_early_error (self, tr, FALSE, error);
+        } else {
+            request_window_acquire (window, tr);
+            transaction_send (self, tr, timeout);
+        }
+
+        l = window->queue.head;
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
 void
 qmi_device_command_abortable (QmiDevice                                *self,
                               QmiMessage                               *message,
@@ -2935,6 +5385,8 @@ qmi_device_command_abortable (QmiDevice                                *self,
 {
     GError *error = NULL;
     Transaction *tr;
+    RequestWindow *window;
+    QmiMessage *reply;
 
     g_return_if_fail (QMI_IS_DEVICE (self));
     g_return_if_fail (message != NULL);
@@ -2955,6 +5407,7 @@ qmi_device_command_abortable (QmiDevice                                *self,
     }
 
     tr = transaction_new (self, message, message_context, cancellable, callback, user_data);
+    transaction_track_client (self, tr);
 
     /* Device must be open */
     if (!qmi_device_is_open (self)) {
@@ -2993,22 +5446,51 @@ qmi_device_command_abortable (QmiDevice                                *self,
         tr->abort_user_data_free    = abort_user_data_free;
     }
 
-    /* Setup context to match response */
-    if (!device_store_transaction (self, tr, timeout, &error)) {
-        g_prefix_error (&error, "Cannot store transaction: ");
-        transaction_early_error (self, tr, FALSE, error);
+    /* Complete right away if an identical request was already answered */
+    reply = response_cache_lookup (self, message, message_context);
+    if (reply) {
+        g_debug ("[%s] transaction 0x%x completed with cached response",
+                 qmi_file_get_path_display (self->priv->file),
+                 qmi_message_get_transaction_id (message));
+        tr->from_cache = TRUE;
+        transaction_complete_and_free (tr, reply, NULL);
+        qmi_message_unref (reply);
         return;
     }
 
-    /* From now on, if we want to complete the transaction with an early error,
-     *  it needs to be removed from the tracking table as well. */
+    /* Attach to an identical request already in flight if possible, or
+     * otherwise allow others to attach to this one */
+    if (request_is_coalesced (self, message, message_context)) {
+        Transaction *in_flight;
 
-    trace_message (self, message, TRUE, "request", message_context);
+        in_flight = g_hash_table_lookup (self->priv->coalescing_transactions, message);
+        if (in_flight) {
+            if (!device_attach_transaction (self, in_flight, tr, timeout, &error))
+                transaction_early_error (self, tr, FALSE, error);
+            return;
+        }
 
-    if (!qmi_endpoint_send (self->priv->endpoint, message, timeout, cancellable, &error)) {
-        transaction_early_error (self, tr, TRUE, error);
-        return;
+        g_hash_table_insert (self->priv->coalescing_transactions, tr->message, tr);
+        tr->coalescing = TRUE;
+    }
+
+    /* Wait in the queue if the window of the service is full, or if other
+     * requests are already waiting, to keep them in order */
+    window = g_hash_table_lookup (self->priv->request_windows, GUINT_TO_POINTER (qmi_message_get_service (message)));
+    if (window) {
+        if (!g_queue_is_empty (&window->queue) ||
+            !request_window_has_room (window, qmi_message_get_client_id (message))) {
+            if (!device_queue_transaction (self, window, tr, timeout, &error)) {
+                transaction_early_error (self, tr, FALSE, error);
+                return;
+            }
+            request_window_schedule_dispatch (window);
+            return;
+        }
+        request_window_acquire (window, tr);
     }
+
+    transaction_send (self, tr, timeout);
 }
 
 /*****************************************************************************/
@@ -3044,6 +5526,344 @@ qmi_device_command_full (QmiDevice           *self,
                                   user_data);
 }
 
+/*****************************************************************************/
+/* Synchronous command
+ *
+ * If the caller already owns the main context of the device, or if it is the
+ * thread-default context of the caller, the request is run inline, iterating
+ * that context until the response is received. Otherwise, the request is
+ * handed over to the thread running the device, and the caller just waits for
+ * the result; the context is never iterated from any other thread, as that
+ * would dispatch all the unrelated sources attached to it in that thread.
+ */
+
+/* Extra time given to the thread running the device to report the result,
+ * e.g. while an abort request is in flight */
+#define COMMAND_SYNC_DEADLINE_EXTRA_SECS 35
+
+typedef struct {
+    gint   ref_count;
+    GMutex mutex;
+    GCond  cond;
+
+    QmiDevice                                *self;
+    QmiMessage                               *message;
+    QmiMessageContext                        *message_context;
+    guint                                     timeout;
+    QmiDeviceCommandAbortableBuildRequestFn   abort_build_request_fn;
+    QmiDeviceCommandAbortableParseResponseFn  abort_parse_response_fn;
+    gpointer                                  abort_user_data;
+    GDestroyNotify                            abort_user_data_free;
+    GCancellable                             *cancellable;
+
+    /* only used by the caller */
+    gboolean cancel_requested;
+
+    /* protected by the mutex */
+    gboolean    completed;
+    gboolean    cancelled;
+    QmiMessage *reply;
+    GError     *error;
+} CommandSyncContext;
+
+static CommandSyncContext *
+command_sync_context_ref (CommandSyncContext *ctx)
+{
+    g_atomic_int_inc (&ctx->ref_count);
+    return ctx;
+}
+
+static void
+command_sync_context_unref (CommandSyncContext *ctx)
+{
+    if (!g_atomic_int_dec_and_test (&ctx->ref_count))
+        return;
+
+    if (ctx->abort_user_data && ctx->abort_user_data_free)
+        ctx->abort_user_data_free (ctx->abort_user_data);
+    if (ctx->reply)
+        qmi_message_unref (ctx->reply);
+    if (ctx->error)
+        g_error_free (ctx->error);
+    g_clear_object (&ctx->cancellable);
+    if (ctx->message_context)
+        qmi_message_context_unref (ctx->message_context);
+    qmi_message_unref (ctx->message);
+    g_object_unref (ctx->self);
+    g_cond_clear (&ctx->cond);
+    g_mutex_clear (&ctx->mutex);
+    g_slice_free (CommandSyncContext, ctx);
+}
+
+static void
+command_sync_ready (QmiDevice          *self,
+                    GAsyncResult       *res,
+                    CommandSyncContext *ctx)
+{
+    QmiMessage *reply;
+    GError     *error = NULL;
+
+    reply = qmi_device_command_abortable_finish (self, res, &error);
+
+    g_mutex_lock (&ctx->mutex);
+    ctx->reply = reply;
+    ctx->error = error;
+    ctx->completed = TRUE;
+    g_cond_signal (&ctx->cond);
+    g_mutex_unlock (&ctx->mutex);
+
+    command_sync_context_unref (ctx);
+}
+
+/* Always run in the context of the device */
+static gboolean
+command_sync_start (CommandSyncContext *ctx)
+{
+    QmiDevice *self = ctx->self;
+
+    /* Requests without a transaction id get one from the client owning their
+     * client id, as the caller may not be allowed to use the client */
+    if (qmi_message_get_service (ctx->message) != QMI_SERVICE_CTL &&
+        qmi_message_get_transaction_id (ctx->message) == 0) {
+        QmiClient *client;
+
+        client = g_hash_table_lookup (self->priv->registered_clients,
+                                      build_registered_client_key (qmi_message_get_client_id (ctx->message),
+                                                                   qmi_message_get_service (ctx->message)));
+        if (client)
+            qmi_message_set_transaction_id (ctx->message, qmi_client_get_next_transaction_id (client));
+    }
+
+    qmi_device_command_abortable (self,
+                                  ctx->message,
+                                  ctx->message_context,
+                                  ctx->timeout,
+                                  ctx->abort_build_request_fn,
+                                  ctx->abort_parse_response_fn,
+                                  g_steal_pointer (&ctx->abort_user_data),
+                                  ctx->abort_user_data_free,
+                                  ctx->cancellable,
+                                  (GAsyncReadyCallback) command_sync_ready,
+                                  command_sync_context_ref (ctx));
+    return G_SOURCE_REMOVE;
+}
+
+/* Always run in the context of the device */
+static gboolean
+command_sync_cancel (CommandSyncContext *ctx)
+{
+    g_cancellable_cancel (ctx->cancellable);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+command_sync_request_cancel (CommandSyncContext *ctx)
+{
+    ctx->cancel_requested = TRUE;
+    g_main_context_invoke_full (ctx->self->priv->context,
+                                G_PRIORITY_DEFAULT,
+                                (GSourceFunc) command_sync_cancel,
+                                command_sync_context_ref (ctx),
+                                (GDestroyNotify) command_sync_context_unref);
+}
+
+static void
+command_sync_cancelled (GCancellable       *cancellable,
+                        CommandSyncContext *ctx)
+{
+    g_mutex_lock (&ctx->mutex);
+    ctx->cancelled = TRUE;
+    g_cond_signal (&ctx->cond);
+    g_mutex_unlock (&ctx->mutex);
+
+    /* The caller may be iterating the context itself */
+    g_main_context_wakeup (ctx->self->priv->context);
+}
+
+/* The caller must own the context of the device */
+static void
+command_sync_iterate (CommandSyncContext *ctx)
+{
+    GMainContext *context = ctx->self->priv->context;
+
+    while (TRUE) {
+        gboolean completed;
+        gboolean cancelled;
+
+        g_mutex_lock (&ctx->mutex);
+        completed = ctx->completed;
+        cancelled = ctx->cancelled;
+        g_mutex_unlock (&ctx->mutex);
+
+        if (completed)
+            break;
+        if (cancelled && !ctx->cancel_requested) {
+            ctx->cancel_requested = TRUE;
+            command_sync_cancel (ctx);
+            continue;
+        }
+        g_main_context_iteration (context, TRUE);
+    }
+}
+
+/* Waits until the result is reported by the thread running the context of
+ * the device, or until the deadline */
+static void
+command_sync_wait (CommandSyncContext *ctx,
+                   gint64              deadline)
+{
+    g_mutex_lock (&ctx->mutex);
+    while (!ctx->completed) {
+        if (ctx->cancelled && !ctx->cancel_requested) {
+            g_mutex_unlock (&ctx->mutex);
+            command_sync_request_cancel (ctx);
+            g_mutex_lock (&ctx->mutex);
+            continue;
+        }
+
+        if (!g_cond_wait_until (&ctx->cond, &ctx->mutex, deadline))
+            break;
+    }
+    g_mutex_unlock (&ctx->mutex);
+}
+
+/* Whether the calling thread may iterate the context of the device; the
+ * global default context only counts as thread-default when the caller owns
+ * it, as it is also the fallback thread-default context of every thread */
+static gboolean
+command_sync_can_iterate (GMainContext *context)
+{
+    return (g_main_context_is_owner (context) ||
+            g_main_context_get_thread_default () == context);
+}
+
+QmiMessage *
+qmi_device_command_abortable_sync (QmiDevice                                 *self,
+                                   QmiMessage                                *message,
+                                   QmiMessageContext                         *message_context,
+                                   guint                                      timeout,
+                                   QmiDeviceCommandAbortableBuildRequestFn    abort_build_request_fn,
+                                   QmiDeviceCommandAbortableParseResponseFn   abort_parse_response_fn,
+                                   gpointer                                   abort_user_data,
+                                   GDestroyNotify                             abort_user_data_free,
+                                   GCancellable                              *cancellable,
+                                   GError                                   **error)
+{
+    CommandSyncContext *ctx;
+    GMainContext       *context;
+    QmiMessage         *reply = NULL;
+    gulong              cancellable_id = 0;
+    gboolean            owner;
+    gboolean            completed;
+
+    g_return_val_if_fail (QMI_IS_DEVICE (self), NULL);
+    g_return_val_if_fail (message != NULL, NULL);
+    g_return_val_if_fail (timeout > 0, NULL);
+
+    /* either none or both set */
+    g_return_val_if_fail ((!abort_build_request_fn && !abort_parse_response_fn) ||
+                          (abort_build_request_fn  && abort_parse_response_fn), NULL);
+
+    context = self->priv->context;
+
+    /* When results are reported synchronously with the input processing, the
+     * source reading the input is being dispatched, and it won't be
+     * dispatched again to read the response until it returns */
+    owner = (command_sync_can_iterate (context) && g_main_context_acquire (context));
+    if (owner && self->priv->completing_input) {
+        g_main_context_release (context);
+        if (abort_user_data && abort_user_data_free)
+            abort_user_data_free (abort_user_data);
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Cannot run synchronous commands while reporting synchronously completed results");
+        return NULL;
+    }
+
+    ctx = g_slice_new0 (CommandSyncContext);
+    ctx->ref_count = 1;
+    g_mutex_init (&ctx->mutex);
+    g_cond_init (&ctx->cond);
+    ctx->self = g_object_ref (self);
+    ctx->message = qmi_message_ref (message);
+    ctx->message_context = (message_context ? qmi_message_context_ref (message_context) : NULL);
+    ctx->timeout = timeout;
+    ctx->abort_build_request_fn = abort_build_request_fn;
+    ctx->abort_parse_response_fn = abort_parse_response_fn;
+    ctx->abort_user_data = abort_user_data;
+    ctx->abort_user_data_free = abort_user_data_free;
+
+    /* The cancellable of the caller is only used to get notified; the actual
+     * cancellation must happen in the context of the device */
+    ctx->cancellable = g_cancellable_new ();
+    if (cancellable)
+        cancellable_id = g_cancellable_connect (cancellable,
+                                                G_CALLBACK (command_sync_cancelled),
+                                                ctx,
+                                                NULL);
+
+    if (owner) {
+        /* The result is reported in the context of the device, which is the
+         * one iterated here */
+        g_main_context_push_thread_default (context);
+        command_sync_start (ctx);
+        command_sync_iterate (ctx);
+        g_main_context_pop_thread_default (context);
+        g_main_context_release (context);
+    } else {
+        gint64 deadline;
+
+        deadline = g_get_monotonic_time () + (gint64)(timeout + COMMAND_SYNC_DEADLINE_EXTRA_SECS) * G_USEC_PER_SEC;
+        g_main_context_invoke_full (context,
+                                    G_PRIORITY_DEFAULT,
+                                    (GSourceFunc) command_sync_start,
+                                    command_sync_context_ref (ctx),
+                                    (GDestroyNotify) command_sync_context_unref);
+        command_sync_wait (ctx, deadline);
+    }
+
+    if (cancellable)
+        g_cancellable_disconnect (cancellable, cancellable_id);
+
+    g_mutex_lock (&ctx->mutex);
+    completed = ctx->completed;
+    if (!completed)
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT,
+                     "Transaction result not reported on time");
+    else if (ctx->reply)
+        reply = g_steal_pointer (&ctx->reply);
+    else
+        g_propagate_error (error, g_steal_pointer (&ctx->error));
+    g_mutex_unlock (&ctx->mutex);
+
+    /* Don't leave the request behind; the context stays alive until it
+     * completes */
+    if (!completed && !ctx->cancel_requested)
+        command_sync_request_cancel (ctx);
+
+    command_sync_context_unref (ctx);
+    return reply;
+}
+
+QmiMessage *
+qmi_device_command_sync (QmiDevice          *self,
+                         QmiMessage         *message,
+                         QmiMessageContext  *message_context,
+                         guint               timeout,
+                         GCancellable       *cancellable,
+                         GError            **error)
+{
+    return qmi_device_command_abortable_sync (self,
+                                              message,
+                                              message_context,
+                                              timeout,
+                                              NULL, /* abort_build_request_fn  */
+                                              NULL, /* abort_parse_response_fn */
+                                              NULL, /* abort_user_data         */
+                                              NULL, /* abort_user_data_free    */
+                                              cancellable,
+                                              error);
+}
+
 /*****************************************************************************/
 /* New QMI device */
 
@@ -3139,9 +5959,14 @@ static void
 sync_indication_cb (QmiClientCtl *client_ctl,
                     QmiDevice *self)
 {
-    /* Just log about it */
     g_debug ("[%s] sync indication received",
              qmi_file_get_path_display (self->priv->file));
+
+    /* The device state may have been reset, including the allocated client
+     * ids */
+    response_cache_clear (self, QMI_SERVICE_UNKNOWN, -1);
+    cid_pool_invalidate_all (self);
+    cid_pool_refill_all (self);
 }
 
 static void
@@ -3273,6 +6098,9 @@ set_property (GObject      *object,
     case PROP_CONSECUTIVE_TIMEOUTS:
         g_assert_not_reached ();
         break;
+    case PROP_READ_SIZE:
+        self->priv->read_size = g_value_get_uint (value);
+        break;
 #if QMI_QRTR_SUPPORTED
     case PROP_NODE:
         g_assert (!self->priv->node);
@@ -3309,6 +6137,9 @@ get_property (GObject    *object,
     case PROP_CONSECUTIVE_TIMEOUTS:
         g_value_set_uint (value, self->priv->consecutive_timeouts);
         break;
+    case PROP_READ_SIZE:
+        g_value_set_uint (value, self->priv->read_size);
+        break;
 #if QMI_QRTR_SUPPORTED
     case PROP_NODE:
         g_value_set_object (value, self->priv->node);
@@ -3327,6 +6158,7 @@ qmi_device_init (QmiDevice *self)
                                               QMI_TYPE_DEVICE,
                                               QmiDevicePrivate);
 
+    self->priv->context = g_main_context_ref_thread_default ();
     self->priv->transactions = g_hash_table_new (g_direct_hash,
                                                  g_direct_equal);
 
@@ -3334,6 +6166,35 @@ qmi_device_init (QmiDevice *self)
                                                             g_direct_equal,
                                                             NULL,
                                                             g_object_unref);
+    self->priv->registered_clients_by_service = g_hash_table_new_full (g_direct_hash,
+                                                                       g_direct_equal,
+                                                                       NULL,
+                                                                       (GDestroyNotify)g_ptr_array_unref);
+    self->priv->message_metrics = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         (GDestroyNotify)message_metrics_free);
+    self->priv->indication_metrics = g_hash_table_new_full (g_direct_hash,
+                                                            g_direct_equal,
+                                                            NULL,
+                                                            (GDestroyNotify)indication_metrics_free);
+    self->priv->request_windows = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         (GDestroyNotify)request_window_free);
+    self->priv->coalesced_requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->coalescing_transactions = g_hash_table_new ((GHashFunc)coalesced_request_hash,
+                                                            (GEqualFunc)coalesced_request_equal);
+    self->priv->response_cache_ttls = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->response_cache_invalidations = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->priv->response_cache = g_hash_table_new_full ((GHashFunc)coalesced_request_hash,
+                                                        (GEqualFunc)coalesced_request_equal,
+                                                        NULL,
+                                                        (GDestroyNotify)response_cache_entry_free);
+    self->priv->cid_pools = g_hash_table_new_full (g_direct_hash,
+                                                   g_direct_equal,
+                                                   NULL,
+                                                   (GDestroyNotify)cid_pool_free);
     self->priv->proxy_path = g_strdup (QMI_PROXY_SOCKET_PATH);
 }
 
@@ -3365,6 +6226,10 @@ dispose (GObject *object)
     g_hash_table_foreach_remove (self->priv->registered_clients,
                                  (GHRFunc)foreach_warning,
                                  self);
+    g_hash_table_remove_all (self->priv->registered_clients_by_service);
+
+    /* Indications not yet reported are discarded */
+    indication_queue_clear (self);
 
     if (self->priv->sync_indication_id &&
         self->priv->client_ctl) {
@@ -3383,6 +6248,14 @@ dispose (GObject *object)
             g_signal_handler_disconnect (self->priv->endpoint, self->priv->endpoint_new_data_id);
             self->priv->endpoint_new_data_id = 0;
         }
+        if (self->priv->endpoint_new_message_id) {
+            g_signal_handler_disconnect (self->priv->endpoint, self->priv->endpoint_new_message_id);
+            self->priv->endpoint_new_message_id = 0;
+        }
+        if (self->priv->endpoint_send_failed_id) {
+            g_signal_handler_disconnect (self->priv->endpoint, self->priv->endpoint_send_failed_id);
+            self->priv->endpoint_send_failed_id = 0;
+        }
         g_clear_object (&self->priv->endpoint);
     }
 
@@ -3408,13 +6281,44 @@ finalize (GObject *object)
         g_hash_table_unref (self->priv->transactions);
     }
 
+    /* The wheel source may still be around until its next tick */
+    g_assert (self->priv->timeout_wheel_n_pending == 0);
+    if (self->priv->timeout_wheel_source) {
+        g_source_destroy (self->priv->timeout_wheel_source);
+        g_source_unref (self->priv->timeout_wheel_source);
+    }
+
+    completion_queue_clear (self);
+    while (!g_queue_is_empty (&self->priv->transaction_pool))
+        g_slice_free (Transaction, g_queue_pop_head_link (&self->priv->transaction_pool)->data);
+
+    g_hash_table_unref (self->priv->registered_clients_by_service);
     g_hash_table_unref (self->priv->registered_clients);
 
+    g_hash_table_unref (self->priv->message_metrics);
+    g_hash_table_unref (self->priv->indication_metrics);
+    g_hash_table_unref (self->priv->request_windows);
+    g_hash_table_unref (self->priv->coalesced_requests);
+    g_hash_table_unref (self->priv->coalescing_transactions);
+    g_hash_table_unref (self->priv->response_cache_ttls);
+    g_hash_table_unref (self->priv->response_cache_invalidations);
+    g_hash_table_unref (self->priv->response_cache);
+    g_hash_table_unref (self->priv->cid_pools);
+
     if (self->priv->supported_services)
         g_array_unref (self->priv->supported_services);
 
+    if (self->priv->simulated_responses)
+        g_hash_table_unref (self->priv->simulated_responses);
+    if (self->priv->simulated_indications)
+        g_ptr_array_unref (self->priv->simulated_indications);
+
     g_free (self->priv->proxy_path);
     g_free (self->priv->wwan_iface);
+    g_free (self->priv->version_info_cache_path);
+    g_free (self->priv->version_info_cache_firmware_id);
+
+    g_main_context_unref (self->priv->context);
 
     G_OBJECT_CLASS (qmi_device_parent_class)->finalize (object);
 }
@@ -3504,6 +6408,27 @@ qmi_device_class_init (QmiDeviceClass *klass)
                            G_PARAM_READABLE);
     g_object_class_install_property (object_class, PROP_CONSECUTIVE_TIMEOUTS, properties[PROP_CONSECUTIVE_TIMEOUTS]);
 
+    /**
+     * QmiDevice:device-read-size:
+     *
+     * Maximum number of bytes requested in each read from the QMI port. The
+     * port is read until no more data is available every time it becomes
+     * readable, so larger values mean fewer reads when the device sends
+     * bursts of messages. Values are limited to 64 KiB, the largest receive
+     * buffer kept around between bursts.
+     *
+     * Changes only apply the next time the device is opened.
+     *
+     * Since: 1.36
+     */
+    properties[PROP_READ_SIZE] =
+        g_param_spec_uint (QMI_DEVICE_READ_SIZE,
+                           "Read size",
+                           "Maximum number of bytes requested in each read from the QMI port",
+                           MIN_READ_SIZE, MAX_READ_SIZE, DEFAULT_READ_SIZE,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
+    g_object_class_install_property (object_class, PROP_READ_SIZE, properties[PROP_READ_SIZE]);
+
     /**
      * QmiDevice:device-node:
      *
@@ -109,6 +109,15 @@ typedef struct _QmiDevicePrivate QmiDevicePrivate;
  */
 #define QMI_DEVICE_CONSECUTIVE_TIMEOUTS "device-consecutive-timeouts"
 
+/**
+ * QMI_DEVICE_READ_SIZE:
+ *
+ * Symbol defining the #QmiDevice:device-read-size property.
+ *
+ * Since: 1.36
+ */
+#define QMI_DEVICE_READ_SIZE "device-read-size"
+
 /**
  * QMI_DEVICE_SIGNAL_INDICATION:
  *
@@ -255,6 +264,8 @@ gboolean qmi_device_is_open (QmiDevice *self);
  * @QMI_DEVICE_OPEN_FLAGS_MBIM: open an MBIM port with QMUX tunneling service. Since: 1.16.
  * @QMI_DEVICE_OPEN_FLAGS_AUTO: open a port either in QMI or MBIM mode, depending on device driver. Since: 1.18.
  * @QMI_DEVICE_OPEN_FLAGS_EXPECT_INDICATIONS: Explicitly state that indications are wanted (implicit in QMI mode, optional when in MBIM mode).
+ * @QMI_DEVICE_OPEN_FLAGS_SIMULATED: Don't open the port, and talk to an in-process simulated modem instead, configured with qmi_device_add_simulated_response() and qmi_device_add_simulated_indication(); the device should be created with the #QmiDevice:device-no-file-check property set. Since: 1.36.
+ * @QMI_DEVICE_OPEN_FLAGS_IO_THREAD: Read and write the port in a dedicated thread, which also validates the received messages, so that the processing done in the main context doesn't delay the I/O. Only applies to QMI ports, either opened directly or through the 'qmi-proxy'. Since: 1.36.
  *
  * Flags to specify which actions to be performed when the device is open.
  *
@@ -272,8 +283,42 @@ typedef enum { /*< since=1.0 >*/
     QMI_DEVICE_OPEN_FLAGS_MBIM               = 1 << 7,
     QMI_DEVICE_OPEN_FLAGS_AUTO               = 1 << 8,
     QMI_DEVICE_OPEN_FLAGS_EXPECT_INDICATIONS = 1 << 9,
+    QMI_DEVICE_OPEN_FLAGS_SIMULATED          = 1 << 10,
+    QMI_DEVICE_OPEN_FLAGS_IO_THREAD          = 1 << 11,
 } QmiDeviceOpenFlags;
 
+/**
+ * qmi_device_set_version_info_cache:
+ * @self: a #QmiDevice.
+ * @path: (nullable): path of the file where the version info is cached, or
+ *  %NULL to disable the cache.
+ * @firmware_id: (nullable): identifier of the firmware running in the device,
+ *  e.g. its revision string, or %NULL.
+ *
+ * Configures a file where to keep the list of services supported by the
+ * device, as retrieved when it's opened with
+ * %QMI_DEVICE_OPEN_FLAGS_VERSION_INFO. The same file may be shared by
+ * multiple devices, as their entries are keyed by the device path.
+ *
+ * If an entry for the device path and @firmware_id exists when the device is
+ * opened, the cached list is used right away instead of waiting for the
+ * device to report it, and the actual list is requested in the background to
+ * update both the device and the cache if needed.
+ *
+ * Note that when the cached list is used, qmi_device_open() doesn't wait for
+ * the device to reply to any version info request, so it may succeed even if
+ * the device isn't ready to handle requests yet, instead of retrying until
+ * the device replies or the timeout given to qmi_device_open() expires.
+ *
+ * This method must be called before qmi_device_open(), and doesn't apply to
+ * QRTR devices.
+ *
+ * Since: 1.36
+ */
+void qmi_device_set_version_info_cache (QmiDevice   *self,
+                                        const gchar *path,
+                                        const gchar *firmware_id);
+
 /**
  * qmi_device_open:
  * @self: a #QmiDevice.
@@ -327,6 +372,9 @@ gboolean qmi_device_open_finish (QmiDevice     *self,
  * operation will wait for the response of the underlying MBIM close
  * sequence.
  *
+ * The client IDs kept in the pools configured with
+ * qmi_device_set_cid_pool_size() are released before closing the port.
+ *
  * Closing a #QmiDevice multiple times will not return an error.
  *
  * When the operation is finished @callback will be called. You can then call
@@ -403,18 +451,90 @@ QmiClient *qmi_device_allocate_client_finish (QmiDevice     *self,
                                               GAsyncResult  *res,
                                               GError       **error);
 
+/**
+ * QmiDeviceClientRequest:
+ * @service: a valid #QmiService.
+ * @cid: a valid client ID, or %QMI_CID_NONE.
+ *
+ * A client to allocate with qmi_device_allocate_clients().
+ *
+ * Since: 1.36
+ */
+typedef struct {
+    QmiService service;
+    guint8     cid;
+} QmiDeviceClientRequest;
+
+/**
+ * qmi_device_allocate_clients:
+ * @self: a #QmiDevice.
+ * @requests: (array length=n_requests): the clients to allocate.
+ * @n_requests: number of elements in @requests.
+ * @timeout: maximum time to wait.
+ * @cancellable: optional #GCancellable object, %NULL to ignore.
+ * @callback: a #GAsyncReadyCallback to call when the operation is finished.
+ * @user_data: the data to pass to callback function.
+ *
+ * Asynchronously allocates a new #QmiClient in @self for each of the given
+ * @requests.
+ *
+ * All the client ID allocations are run in parallel, so the operation
+ * takes as long as the slowest one instead of the sum of all of them. The
+ * same service may be given more than once in @requests.
+ *
+ * When the operation is finished @callback will be called. You can then call
+ * qmi_device_allocate_clients_finish() to get the result of the operation.
+ *
+ * Since: 1.36
+ */
+void qmi_device_allocate_clients (QmiDevice                    *self,
+                                  const QmiDeviceClientRequest *requests,
+                                  guint                         n_requests,
+                                  guint                         timeout,
+                                  GCancellable                 *cancellable,
+                                  GAsyncReadyCallback           callback,
+                                  gpointer                      user_data);
+
+/**
+ * qmi_device_allocate_clients_finish:
+ * @self: a #QmiDevice.
+ * @res: a #GAsyncResult.
+ * @errors: (out) (optional) (transfer full) (element-type GError): return
+ *  location for a #GPtrArray with the error of each failed request, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Finishes an operation started with qmi_device_allocate_clients().
+ *
+ * The returned array has one element per request, in the same order as
+ * given. Requests that could not be satisfied have a %NULL client, and the
+ * corresponding element in @errors gives the reason. The operation only
+ * fails as a whole if none of the clients could be allocated.
+ *
+ * Returns: (transfer full) (element-type QmiClient): a #GPtrArray of
+ *  #QmiClient elements, or %NULL if @error is set. The returned value should
+ *  be freed with g_ptr_array_unref().
+ *
+ * Since: 1.36
+ */
+GPtrArray *qmi_device_allocate_clients_finish (QmiDevice     *self,
+                                               GAsyncResult  *res,
+                                               GPtrArray    **errors,
+                                               GError       **error);
+
 /**
  * QmiDeviceReleaseClientFlags:
  * @QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE: No flags.
  * @QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID: Release the CID when releasing the client.
+ * @QMI_DEVICE_RELEASE_CLIENT_FLAGS_RETURN_TO_POOL: Along with @QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, return the CID to the pool of the service instead of releasing it, if there is room for it. See qmi_device_set_cid_pool_size(). Since: 1.36.
  *
  * Flags to specify which actions to be performed when releasing the client.
  *
  * Since: 1.0
  */
 typedef enum { /*< since=1.0 >*/
-    QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE        = 0,
-    QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID = 1 << 0
+    QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE           = 0,
+    QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID    = 1 << 0,
+    QMI_DEVICE_RELEASE_CLIENT_FLAGS_RETURN_TO_POOL = 1 << 1,
 } QmiDeviceReleaseClientFlags;
 
 /**
@@ -465,6 +585,62 @@ gboolean qmi_device_release_client_finish (QmiDevice     *self,
                                            GAsyncResult  *res,
                                            GError       **error);
 
+/**
+ * qmi_device_set_cid_pool_size:
+ * @self: a #QmiDevice.
+ * @service: a valid #QmiService.
+ * @size: number of client IDs of @service to keep allocated in advance, or 0
+ *  to disable the pool.
+ *
+ * Configures a pool of client IDs of @service that are allocated in the
+ * background while the device is open.
+ *
+ * qmi_device_allocate_client() with %QMI_CID_NONE takes the client ID from the
+ * pool when one is available, without any CTL request. The pool is refilled
+ * in the background every time a client ID is taken from it.
+ *
+ * qmi_device_release_client() with %QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID
+ * always releases the client ID, unless
+ * %QMI_DEVICE_RELEASE_CLIENT_FLAGS_RETURN_TO_POOL is also given and the pool
+ * is not full. Client IDs returned to the pool are no longer bound to any
+ * #QmiClient, so their indications are discarded, but any indication
+ * registration done in the device by their previous user is kept; only return
+ * client IDs to the pool if their next users configure the indications they
+ * want explicitly.
+ *
+ * Reducing the size of the pool releases the client IDs in excess, and the
+ * ones still in the pool are released when the device is closed with
+ * qmi_device_close_async().
+ *
+ * Since: 1.36
+ */
+void qmi_device_set_cid_pool_size (QmiDevice  *self,
+                                   QmiService  service,
+                                   guint       size);
+
+/**
+ * qmi_device_get_cid_pool_stats:
+ * @self: a #QmiDevice.
+ * @service: a valid #QmiService.
+ * @n_available: (out) (optional): return location for the number of client
+ *  IDs currently in the pool, or %NULL.
+ * @n_hits: (out) (optional): return location for the number of clients
+ *  allocated with a client ID from the pool, or %NULL.
+ * @n_misses: (out) (optional): return location for the number of clients
+ *  that needed a CTL request because the pool was empty, or %NULL.
+ *
+ * Gets statistics of the client ID pool of @service.
+ *
+ * Returns: %TRUE if a pool is configured for @service, %FALSE otherwise.
+ *
+ * Since: 1.36
+ */
+gboolean qmi_device_get_cid_pool_stats (QmiDevice  *self,
+                                        QmiService  service,
+                                        guint      *n_available,
+                                        guint64    *n_hits,
+                                        guint64    *n_misses);
+
 /**
  * qmi_device_set_instance_id:
  * @self: a #QmiDevice.
@@ -674,6 +850,87 @@ QmiMessage *qmi_device_command_abortable_finish (QmiDevice     *self,
                                                  GAsyncResult  *res,
                                                  GError       **error);
 
+/**
+ * qmi_device_command_sync:
+ * @self: a #QmiDevice.
+ * @message: the message to send.
+ * @message_context: the context of the message.
+ * @timeout: maximum time, in seconds, to wait for the response.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Synchronously sends a #QmiMessage to the device, blocking the calling thread
+ * until the response is received.
+ *
+ * If the calling thread already owns the #GMainContext where @self was
+ * created (see g_main_context_acquire()), or if that context is its
+ * thread-default context (see g_main_context_push_thread_default()), the
+ * operation is run inline, iterating that context from the calling thread.
+ * Otherwise, the request is handed over to the thread running that context,
+ * which allows calling this method from worker threads without an event loop;
+ * the calling thread then just waits for the result, and never iterates the
+ * context itself, so some other thread must be running it.
+ *
+ * Calling it from the thread running the context is also allowed, e.g. from
+ * the callback of an asynchronous operation, as the context is then iterated
+ * recursively. The only exception are the callbacks run right after
+ * processing the input when synchronous completion is enabled (see
+ * qmi_device_set_synchronous_completion()), as the input of the device cannot
+ * be read again until they return; in that case the operation fails with a
+ * %QMI_CORE_ERROR_WRONG_STATE error.
+ *
+ * If @message is not a CTL message and its transaction id is 0, a new one is
+ * assigned by the #QmiClient owning the client id of the message.
+ *
+ * The message will be processed according to the specific @message_context
+ * given.
+ *
+ * Returns: (transfer full): a #QmiMessage response, or %NULL if @error is set. The returned value should be freed with qmi_message_unref().
+ *
+ * Since: 1.36
+ */
+QmiMessage *qmi_device_command_sync (QmiDevice          *self,
+                                     QmiMessage         *message,
+                                     QmiMessageContext  *message_context,
+                                     guint               timeout,
+                                     GCancellable       *cancellable,
+                                     GError            **error);
+
+/**
+ * qmi_device_command_abortable_sync:
+ * @self: a #QmiDevice.
+ * @message: the message to send.
+ * @message_context: the context of the message.
+ * @timeout: maximum time, in seconds, to wait for the response.
+ * @abort_build_request_fn: (scope async): callback to build an abort request.
+ * @abort_parse_response_fn: (scope async): callback to parse an abort response.
+ * @abort_user_data: (closure): user data to pass to @build_request_fn and @parse_response_fn.
+ * @abort_user_data_free: (destroy abort_user_data): a #GDestroyNotify to free @abort_user_data.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @error: Return location for error or %NULL.
+ *
+ * Synchronous version of qmi_device_command_abortable(), which works the same
+ * way as qmi_device_command_sync().
+ *
+ * If the thread running the #GMainContext of @self does not report the
+ * result within @timeout plus the time required to abort the operation, the
+ * operation is cancelled and a %QMI_CORE_ERROR_TIMEOUT error is returned.
+ *
+ * Returns: (transfer full): a #QmiMessage response, or %NULL if @error is set. The returned value should be freed with qmi_message_unref().
+ *
+ * Since: 1.36
+ */
+QmiMessage *qmi_device_command_abortable_sync (QmiDevice                                 *self,
+                                               QmiMessage                                *message,
+                                               QmiMessageContext                         *message_context,
+                                               guint                                      timeout,
+                                               QmiDeviceCommandAbortableBuildRequestFn    abort_build_request_fn,
+                                               QmiDeviceCommandAbortableParseResponseFn   abort_parse_response_fn,
+                                               gpointer                                   abort_user_data,
+                                               GDestroyNotify                             abort_user_data_free,
+                                               GCancellable                              *cancellable,
+                                               GError                                   **error);
+
 /**
  * QmiDeviceServiceVersionInfo:
  * @service: a #QmiService.
@@ -742,6 +999,470 @@ GArray *qmi_device_get_service_version_info_finish (QmiDevice     *self,
  */
 guint qmi_device_get_consecutive_timeouts (QmiDevice *self);
 
+/**
+ * qmi_device_get_n_pending_transactions:
+ * @self: a #QmiDevice.
+ *
+ * Gets the number of transactions in the device that are waiting for a
+ * response.
+ *
+ * Returns: a #guint.
+ *
+ * Since: 1.36
+ */
+guint qmi_device_get_n_pending_transactions (QmiDevice *self);
+
+/**
+ * qmi_device_get_n_queued_indications:
+ * @self: a #QmiDevice.
+ *
+ * Gets the number of indications received by the device that are still
+ * waiting to be reported to their clients.
+ *
+ * Returns: a #guint.
+ *
+ * Since: 1.36
+ */
+guint qmi_device_get_n_queued_indications (QmiDevice *self);
+
+/**
+ * qmi_device_set_synchronous_completion:
+ * @self: a #QmiDevice.
+ * @enabled: whether synchronous completion should be enabled.
+ *
+ * Configures how the results of the requests are reported.
+ *
+ * By default, the callbacks of the requests run from their own main loop
+ * source after the response has been processed. If synchronous completion is
+ * enabled, the callbacks of the requests completed by the input received from
+ * the device run right after that input has been processed, saving one main
+ * loop iteration per response.
+ *
+ * In both cases the callbacks run in the thread-default main context of the
+ * thread where the request was issued, and never from within the call that
+ * issued it.
+ *
+ * Synchronous commands cannot be run from the callbacks completed right after
+ * processing the input, see qmi_device_command_sync().
+ *
+ * Since: 1.36
+ */
+void qmi_device_set_synchronous_completion (QmiDevice *self,
+                                            gboolean   enabled);
+
+/**
+ * qmi_device_set_request_window:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @max_in_flight: maximum number of requests of @service waiting for a
+ *  response at the same time, or 0 for no limit.
+ * @max_in_flight_per_client: maximum number of requests of @service sent by
+ *  the same client waiting for a response at the same time, or 0 for no limit.
+ *
+ * Limits the number of requests of @service that are sent to the device
+ * without having received their response yet.
+ *
+ * Requests exceeding the limits wait in a queue, and are sent in the same
+ * order once the ones in flight are completed. The time spent in the queue
+ * counts towards the timeout of each request. A request that times out while
+ * queued is never sent to the device, and so it doesn't increase the
+ * #QmiDevice:device-consecutive-timeouts count.
+ *
+ * Only the requests sent after the window is configured are accounted.
+ *
+ * Since: 1.36
+ */
+void qmi_device_set_request_window (QmiDevice  *self,
+                                    QmiService  service,
+                                    guint       max_in_flight,
+                                    guint       max_in_flight_per_client);
+
+/**
+ * qmi_device_set_request_coalescing:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService, other than %QMI_SERVICE_CTL.
+ * @message_id: the message id of the request.
+ * @enabled: whether requests should be coalesced.
+ *
+ * Sets whether requests of the given @service and @message_id may be
+ * coalesced.
+ *
+ * When enabled, a request with exactly the same contents as another one
+ * already in flight, even if sent by a different client, is not sent to the
+ * device; instead, it gets the same response as the one in flight. Each
+ * request still times out on its own, and if the request in flight is
+ * cancelled, the ones attached to it keep waiting for the response.
+ *
+ * This should only be enabled for requests that don't have any side effect in
+ * the device, e.g. those just querying some state. Vendor-specific requests
+ * are never coalesced.
+ *
+ * Since: 1.36
+ */
+void qmi_device_set_request_coalescing (QmiDevice  *self,
+                                        QmiService  service,
+                                        guint16     message_id,
+                                        gboolean    enabled);
+
+/**
+ * qmi_device_get_request_window_stats:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @n_in_flight: (out) (optional): return location for the number of requests
+ *  waiting for a response, or %NULL.
+ * @queue_length: (out) (optional): return location for the number of requests
+ *  waiting to be sent, or %NULL.
+ * @max_queue_length: (out) (optional): return location for the largest number
+ *  of requests that were waiting to be sent at the same time, or %NULL.
+ * @n_queued: (out) (optional): return location for the number of requests
+ *  that had to wait to be sent, or %NULL.
+ * @average_wait: (out) (optional): return location for the average time, in
+ *  microseconds, that requests waited to be sent, or %NULL.
+ * @max_wait: (out) (optional): return location for the longest time, in
+ *  microseconds, that a request waited to be sent, or %NULL.
+ *
+ * Gets statistics of the request window configured for @service with
+ * qmi_device_set_request_window().
+ *
+ * Returns: %TRUE if the statistics were retrieved, %FALSE if no window is
+ * configured for @service.
+ *
+ * Since: 1.36
+ */
+gboolean qmi_device_get_request_window_stats (QmiDevice  *self,
+                                              QmiService  service,
+                                              guint      *n_in_flight,
+                                              guint      *queue_length,
+                                              guint      *max_queue_length,
+                                              guint64    *n_queued,
+                                              guint64    *average_wait,
+                                              guint64    *max_wait);
+
+/**
+ * qmi_device_get_input_stats:
+ * @self: a #QmiDevice.
+ * @n_wakeups: (out) (optional): return location for the number of times the
+ *  device was found readable, or %NULL.
+ * @n_reads: (out) (optional): return location for the number of reads done,
+ *  or %NULL.
+ * @n_bytes: (out) (optional): return location for the number of bytes read,
+ *  or %NULL.
+ * @max_reads_per_wakeup: (out) (optional): return location for the largest
+ *  number of reads done in a single wakeup, or %NULL.
+ * @max_bytes_per_wakeup: (out) (optional): return location for the largest
+ *  number of bytes read in a single wakeup, or %NULL.
+ *
+ * Gets statistics of the reads done on the QMI port since the device was
+ * opened.
+ *
+ * These statistics are only available when the device is open and the QMI
+ * messages are read from a character device or from the proxy socket; i.e.
+ * not when using MBIM or QRTR.
+ *
+ * Returns: %TRUE if the statistics were retrieved, %FALSE otherwise.
+ *
+ * Since: 1.36
+ */
+gboolean qmi_device_get_input_stats (QmiDevice *self,
+                                     guint64   *n_wakeups,
+                                     guint64   *n_reads,
+                                     guint64   *n_bytes,
+                                     guint     *max_reads_per_wakeup,
+                                     gsize     *max_bytes_per_wakeup);
+
+/**
+ * qmi_device_get_output_stats:
+ * @self: a #QmiDevice.
+ * @queue_length: (out) (optional): return location for the number of messages
+ *  waiting to be written, or %NULL.
+ * @max_queue_length: (out) (optional): return location for the largest number
+ *  of messages that were waiting to be written at the same time, or %NULL.
+ * @n_writes: (out) (optional): return location for the number of writes done,
+ *  or %NULL.
+ * @n_messages: (out) (optional): return location for the number of messages
+ *  written, or %NULL.
+ * @average_latency: (out) (optional): return location for the average time,
+ *  in microseconds, since a message was sent until it was fully written, or
+ *  %NULL.
+ * @max_latency: (out) (optional): return location for the longest time, in
+ *  microseconds, since a message was sent until it was fully written, or
+ *  %NULL.
+ *
+ * Gets statistics of the writes done on the QMI port since the device was
+ * opened.
+ *
+ * Messages are written asynchronously, in the same order as they are sent.
+ * When talking to the qmi-proxy, several messages waiting to be written may
+ * be sent in one single write.
+ *
+ * These statistics are only available when the device is open and the QMI
+ * messages are written to a character device or to the proxy socket; i.e.
+ * not when using MBIM or QRTR.
+ *
+ * Returns: %TRUE if the statistics were retrieved, %FALSE otherwise.
+ *
+ * Since: 1.36
+ */
+gboolean qmi_device_get_output_stats (QmiDevice *self,
+                                      guint     *queue_length,
+                                      guint     *max_queue_length,
+                                      guint64   *n_writes,
+                                      guint64   *n_messages,
+                                      guint64   *average_latency,
+                                      guint64   *max_latency);
+
+/**
+ * QMI_DEVICE_METRICS_N_LATENCY_BUCKETS:
+ *
+ * Number of buckets in the latency histogram of #QmiDeviceMessageMetrics.
+ *
+ * The first bucket counts the responses received in less than 1 millisecond,
+ * bucket <literal>i</literal> counts those received in [2^(i-1), 2^i)
+ * milliseconds, and the last bucket counts all the slower ones.
+ *
+ * Since: 1.36
+ */
+#define QMI_DEVICE_METRICS_N_LATENCY_BUCKETS 16
+
+/**
+ * QmiDeviceMessageMetrics:
+ * @service: a #QmiService.
+ * @message_id: the message id of the request.
+ * @n_requests: number of requests sent.
+ * @n_in_flight: number of requests still waiting for a response.
+ * @n_timeouts: number of requests that timed out.
+ * @n_failures: number of requests completed with an error, including the
+ *  ones that timed out.
+ * @n_coalesced: number of requests that were not sent because an identical
+ *  one was already in flight, see qmi_device_set_request_coalescing().
+ * @n_cached: number of requests that were not sent because a cached response
+ *  was available, see qmi_device_set_response_cache_ttl().
+ * @bytes_out: number of bytes of the requests sent.
+ * @bytes_in: number of bytes of the responses received.
+ * @total_latency: sum of the time, in microseconds, since each request was
+ *  sent until its response was received.
+ * @max_latency: longest time, in microseconds, since a request was sent until
+ *  its response was received.
+ * @latency_histogram: number of responses received in each latency range, see
+ *  %QMI_DEVICE_METRICS_N_LATENCY_BUCKETS.
+ *
+ * Metrics of the requests of a given service and message id sent through a
+ * #QmiDevice.
+ *
+ * Latencies are only measured for requests completed with a response
+ * received from the device.
+ *
+ * Since: 1.36
+ */
+typedef struct {
+    QmiService service;
+    guint16    message_id;
+    guint64    n_requests;
+    guint      n_in_flight;
+    guint64    n_timeouts;
+    guint64    n_failures;
+    guint64    n_coalesced;
+    guint64    n_cached;
+    guint64    bytes_out;
+    guint64    bytes_in;
+    guint64    total_latency;
+    guint64    max_latency;
+    guint64    latency_histogram[QMI_DEVICE_METRICS_N_LATENCY_BUCKETS];
+} QmiDeviceMessageMetrics;
+
+/**
+ * QmiDeviceIndicationMetrics:
+ * @service: a #QmiService.
+ * @n_indications: number of indications received.
+ * @bytes_in: number of bytes of the indications received.
+ *
+ * Metrics of the indications of a given service received by a #QmiDevice.
+ *
+ * Since: 1.36
+ */
+typedef struct {
+    QmiService service;
+    guint64    n_indications;
+    guint64    bytes_in;
+} QmiDeviceIndicationMetrics;
+
+/**
+ * qmi_device_get_message_metrics:
+ * @self: a #QmiDevice.
+ *
+ * Gets a snapshot of the metrics of the requests sent through the device since
+ * it was created or since the last qmi_device_reset_metrics() call, with one
+ * entry per service and message id, sorted by both.
+ *
+ * Returns: (transfer full) (element-type QmiDeviceMessageMetrics): a #GArray
+ *  of #QmiDeviceMessageMetrics elements. The returned value should be freed
+ *  with g_array_unref().
+ *
+ * Since: 1.36
+ */
+GArray *qmi_device_get_message_metrics (QmiDevice *self);
+
+/**
+ * qmi_device_get_indication_metrics:
+ * @self: a #QmiDevice.
+ *
+ * Gets a snapshot of the metrics of the indications received by the device
+ * since it was created or since the last qmi_device_reset_metrics() call, with
+ * one entry per service, sorted by service.
+ *
+ * Returns: (transfer full) (element-type QmiDeviceIndicationMetrics): a
+ *  #GArray of #QmiDeviceIndicationMetrics elements. The returned value should
+ *  be freed with g_array_unref().
+ *
+ * Since: 1.36
+ */
+GArray *qmi_device_get_indication_metrics (QmiDevice *self);
+
+/**
+ * qmi_device_reset_metrics:
+ * @self: a #QmiDevice.
+ *
+ * Resets all the request and indication metrics of the device. The number of
+ * requests in flight is kept, so that it stays consistent once they complete.
+ *
+ * Since: 1.36
+ */
+void qmi_device_reset_metrics (QmiDevice *self);
+
+/**
+ * QMI_DEVICE_RESPONSE_CACHE_TTL_FOREVER:
+ *
+ * TTL to use in qmi_device_set_response_cache_ttl() so that responses are kept
+ * until the device is closed, removed or resynchronized.
+ *
+ * Since: 1.36
+ */
+#define QMI_DEVICE_RESPONSE_CACHE_TTL_FOREVER G_MAXUINT
+
+/**
+ * qmi_device_set_response_cache_ttl:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @message_id: the message id of the request.
+ * @ttl_ms: time, in milliseconds, during which responses are kept,
+ *  %QMI_DEVICE_RESPONSE_CACHE_TTL_FOREVER, or 0 to disable caching.
+ *
+ * Configures the device to keep the successful responses of the given
+ * @service and @message_id during @ttl_ms milliseconds.
+ *
+ * While a response is cached, requests with exactly the same contents, even
+ * if sent by a different client, are not sent to the device; instead, they
+ * are completed right away with a copy of the cached response.
+ *
+ * All the cached responses are discarded when the device is open, closed,
+ * removed or resynchronized. Those of a given service may also be discarded
+ * with qmi_device_invalidate_response_cache(), or whenever an indication
+ * configured with qmi_device_add_response_cache_invalidation() is received.
+ * At most 256 responses are kept; when full, the expired ones are discarded
+ * to make room for a new one, or otherwise the oldest one.
+ *
+ * This should only be enabled for requests that don't have any side effect in
+ * the device and that query data not expected to change, or change rarely.
+ * Vendor-specific requests are never cached.
+ *
+ * Since: 1.36
+ */
+void qmi_device_set_response_cache_ttl (QmiDevice  *self,
+                                        QmiService  service,
+                                        guint16     message_id,
+                                        guint       ttl_ms);
+
+/**
+ * qmi_device_add_response_cache_invalidation:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService.
+ * @indication_id: the message id of the indication.
+ *
+ * Configures the device to discard all the cached responses of @service
+ * whenever the given indication is received.
+ *
+ * Since: 1.36
+ */
+void qmi_device_add_response_cache_invalidation (QmiDevice  *self,
+                                                 QmiService  service,
+                                                 guint16     indication_id);
+
+/**
+ * qmi_device_invalidate_response_cache:
+ * @self: a #QmiDevice.
+ * @service: a #QmiService, or %QMI_SERVICE_UNKNOWN for all services.
+ *
+ * Discards all the cached responses of @service.
+ *
+ * Since: 1.36
+ */
+void qmi_device_invalidate_response_cache (QmiDevice  *self,
+                                           QmiService  service);
+
+/**
+ * qmi_device_get_response_cache_stats:
+ * @self: a #QmiDevice.
+ * @n_entries: (out) (optional): return location for the number of responses
+ *  currently cached, or %NULL.
+ * @n_hits: (out) (optional): return location for the number of requests
+ *  completed with a cached response, or %NULL.
+ * @n_misses: (out) (optional): return location for the number of requests
+ *  that could have been cached but had to be sent to the device, or %NULL.
+ *
+ * Gets statistics of the response cache of the device.
+ *
+ * Since: 1.36
+ */
+void qmi_device_get_response_cache_stats (QmiDevice *self,
+                                          guint     *n_entries,
+                                          guint64   *n_hits,
+                                          guint64   *n_misses);
+
+/**
+ * qmi_device_add_simulated_response:
+ * @self: a #QmiDevice.
+ * @response: a #QmiMessage response.
+ * @latency_ms: time to wait, in milliseconds, before replying.
+ *
+ * Configures the simulated modem used when the device is opened with
+ * %QMI_DEVICE_OPEN_FLAGS_SIMULATED to reply with @response to every request
+ * of the same service and message id, @latency_ms milliseconds after the
+ * request is sent. The client id and transaction id of each request are used
+ * in its response.
+ *
+ * If a response for the same service and message id had already been added,
+ * it is replaced.
+ *
+ * Requests without a configured response are replied with a
+ * %QMI_PROTOCOL_ERROR_INVALID_QMI_COMMAND error, except for the CTL ones
+ * required to manage clients and open the device, which are always
+ * supported by the simulated modem.
+ *
+ * Since: 1.36
+ */
+void qmi_device_add_simulated_response (QmiDevice  *self,
+                                        QmiMessage *response,
+                                        guint       latency_ms);
+
+/**
+ * qmi_device_add_simulated_indication:
+ * @self: a #QmiDevice.
+ * @indication: a #QmiMessage indication.
+ * @interval_ms: time between indications, in milliseconds.
+ *
+ * Configures the simulated modem used when the device is opened with
+ * %QMI_DEVICE_OPEN_FLAGS_SIMULATED to emit @indication every @interval_ms
+ * milliseconds while the device is open.
+ *
+ * The indication is sent with the client id given in @indication, so
+ * %QMI_CID_BROADCAST may be used to report it to all clients of the service.
+ *
+ * Since: 1.36
+ */
+void qmi_device_add_simulated_indication (QmiDevice  *self,
+                                          QmiMessage *indication,
+                                          guint       interval_ms);
+
 /******************************************************************************/
 /* qmi_wwan specific APIs */
 
@@ -1271,6 +1992,16 @@ QrtrNode *qmi_device_peek_node (QmiDevice *self);
 
 #endif /* QMI_QRTR_SUPPORTED */
 
+/* not part of the public API */
+
+#if defined (LIBQMI_GLIB_COMPILATION)
+G_GNUC_INTERNAL
+gboolean __qmi_device_is_transaction_in_flight (QmiDevice  *self,
+                                                QmiService  service,
+                                                guint8      cid,
+                                                guint16     transaction_id);
+#endif
+
 G_END_DECLS
 
 #endif /* _LIBQMI_GLIB_QMI_DEVICE_H_ */
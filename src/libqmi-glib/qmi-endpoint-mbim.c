@@ -57,6 +57,31 @@ mbim_device_removed_cb (MbimDevice *device,
 
 /*****************************************************************************/
 
+static void
+add_raw_message (QmiEndpointMbim *self,
+                 const guint8    *buf,
+                 guint32          len)
+{
+    /* The information buffer usually holds one single complete QMUX message,
+     * so build it right away instead of going through the generic buffer */
+    if (len > 0 &&
+        buf[0] == QMI_MESSAGE_QMUX_MARKER &&
+        __qmi_message_get_raw_frame_length (buf, len) == len) {
+        g_autoptr(QmiMessage) message = NULL;
+        gsize                 consumed = 0;
+
+        message = __qmi_message_new_from_raw_buffer (buf, len, &consumed, NULL);
+        if (message) {
+            qmi_endpoint_add_parsed_message (QMI_ENDPOINT (self), message);
+            return;
+        }
+    }
+
+    /* Anything else is left to the generic parser, which also takes care of
+     * reporting errors */
+    qmi_endpoint_add_message (QMI_ENDPOINT (self), buf, len);
+}
+
 static void
 mbim_device_command_ready (MbimDevice      *dev,
                            GAsyncResult    *res,
@@ -78,10 +103,10 @@ mbim_device_command_ready (MbimDevice      *dev,
         return;
     }
 
-    /* Store the raw information buffer in the internal reception buffer,
-     * as if we had read from a iochannel. */
+    /* Report the QMI message in the raw information buffer, as if we had
+     * read it from a iochannel. */
     buf = mbim_message_command_done_get_raw_information_buffer (response, &len);
-    qmi_endpoint_add_message (QMI_ENDPOINT (self), buf, len);
+    add_raw_message (self, buf, len);
     mbim_message_unref (response);
     g_object_unref (self);
 }
@@ -100,7 +125,7 @@ mbim_qmi_notification_cb (MbimDevice      *device,
         return;
 
     buf = mbim_message_indicate_status_get_raw_information_buffer (notification, &len);
-    qmi_endpoint_add_message (QMI_ENDPOINT (self), buf, len);
+    add_raw_message (self, buf, len);
 }
 
 static void
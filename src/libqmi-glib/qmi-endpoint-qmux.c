@@ -46,6 +46,29 @@ struct _QmiEndpointQmuxPrivate {
     GInputStream *istream;
     GOutputStream *ostream;
     GSource *input_source;
+    guint read_size;
+
+    /* I/O thread, if requested */
+    gboolean use_io_thread;
+    struct _IoThread *io_thread;
+
+    /* Input statistics */
+    guint64 n_input_wakeups;
+    guint64 n_input_reads;
+    guint64 n_input_bytes;
+    guint   max_input_reads_per_wakeup;
+    gsize   max_input_bytes_per_wakeup;
+
+    /* Output queue */
+    GQueue              output_queue;
+    struct _OutputWrite *output_write;
+
+    /* Output statistics */
+    guint   max_output_queue_length;
+    guint64 n_output_writes;
+    guint64 n_output_messages;
+    guint64 total_output_latency;
+    guint64 max_output_latency;
 
     /* Proxy socket */
     gchar *proxy_path;
@@ -56,45 +79,115 @@ struct _QmiEndpointQmuxPrivate {
     QmiClientCtl *client_ctl;
 };
 
-#define BUFFER_SIZE 2048
+/* Upper limit of reads done in a single wakeup, so that a device flooding us
+ * with data doesn't starve the main loop */
+#define MAX_READS_PER_WAKEUP 32
 #define MAX_SPAWN_RETRIES 10
 
-static void destroy_iostream (QmiEndpointQmux *self);
+/* Maximum number of messages waiting to be written */
+#define MAX_OUTPUT_QUEUE_LENGTH 256
+/* Maximum size of a single write when several messages are coalesced */
+#define MAX_COALESCED_WRITE_SIZE 16384
+
+static void     destroy_iostream (QmiEndpointQmux  *self);
+static gboolean io_thread_start  (QmiEndpointQmux  *self,
+                                  GError          **error);
 
 /*****************************************************************************/
 
+static void
+update_input_stats (QmiEndpointQmux *self,
+                    guint            n_reads,
+                    gsize            n_bytes)
+{
+    self->priv->n_input_wakeups++;
+    self->priv->n_input_reads += n_reads;
+    self->priv->n_input_bytes += n_bytes;
+    self->priv->max_input_reads_per_wakeup = MAX (self->priv->max_input_reads_per_wakeup, n_reads);
+    self->priv->max_input_bytes_per_wakeup = MAX (self->priv->max_input_bytes_per_wakeup, n_bytes);
+}
+
 static gboolean
 input_ready_cb (GInputStream *istream,
                 QmiEndpointQmux *self)
 {
-    guint8 buffer[BUFFER_SIZE];
-    GError *error = NULL;
-    gssize r;
-
-    r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (istream),
-                                                  buffer,
-                                                  BUFFER_SIZE,
-                                                  NULL,
-                                                  &error);
-    if (r < 0) {
-        g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
-        if (error)
-            g_error_free (error);
-        /* Hang up the endpoint */
-        g_signal_emit_by_name (QMI_ENDPOINT (self), QMI_ENDPOINT_SIGNAL_HANGUP);
-        return G_SOURCE_REMOVE;
-    }
+    QmiEndpoint *endpoint = QMI_ENDPOINT (self);
+    gboolean hangup = FALSE;
+    guint n_reads = 0;
+    gsize n_bytes = 0;
+
+    /* Drain the stream until it would block, reading straight into the
+     * endpoint buffer, and only parse once all that is available has been
+     * read */
+    while (n_reads < MAX_READS_PER_WAKEUP) {
+        GError *error = NULL;
+        guint8 *buffer;
+        gssize r;
+
+        buffer = qmi_endpoint_reserve_buffer (endpoint, self->priv->read_size);
+        r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (istream),
+                                                      buffer,
+                                                      self->priv->read_size,
+                                                      NULL,
+                                                      &error);
+        qmi_endpoint_commit_buffer (endpoint, r > 0 ? (guint)r : 0);
+
+        if (r < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free (error);
+                break;
+            }
+            g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
+            if (error)
+                g_error_free (error);
+            hangup = TRUE;
+            break;
+        }
 
-    if (r == 0) {
-        /* HUP! */
-        g_warning ("Cannot read from istream: connection broken");
-        g_signal_emit_by_name (QMI_ENDPOINT (self), QMI_ENDPOINT_SIGNAL_HANGUP);
-        return G_SOURCE_REMOVE;
+        if (r == 0) {
+            /* HUP! */
+            g_warning ("Cannot read from istream: connection broken");
+            hangup = TRUE;
+            break;
+        }
+
+        /* else, r > 0 */
+        n_reads++;
+        n_bytes += r;
     }
 
-    /* else, r > 0 */
-    qmi_endpoint_add_message (QMI_ENDPOINT (self), buffer, r);
-    return G_SOURCE_CONTINUE;
+    update_input_stats (self, n_reads, n_bytes);
+
+    /* The endpoint may get closed while processing the new data */
+    g_object_ref (self);
+    if (n_bytes)
+        qmi_endpoint_notify_new_data (endpoint);
+    if (hangup)
+        /* Hang up the endpoint */
+        g_signal_emit_by_name (endpoint, QMI_ENDPOINT_SIGNAL_HANGUP);
+    g_object_unref (self);
+
+    return hangup ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+}
+
+void
+qmi_endpoint_qmux_get_input_stats (QmiEndpointQmux *self,
+                                   guint64         *n_wakeups,
+                                   guint64         *n_reads,
+                                   guint64         *n_bytes,
+                                   guint           *max_reads_per_wakeup,
+                                   gsize           *max_bytes_per_wakeup)
+{
+    if (n_wakeups)
+        *n_wakeups = self->priv->n_input_wakeups;
+    if (n_reads)
+        *n_reads = self->priv->n_input_reads;
+    if (n_bytes)
+        *n_bytes = self->priv->n_input_bytes;
+    if (max_reads_per_wakeup)
+        *max_reads_per_wakeup = self->priv->max_input_reads_per_wakeup;
+    if (max_bytes_per_wakeup)
+        *max_bytes_per_wakeup = self->priv->max_input_bytes_per_wakeup;
 }
 
 /*****************************************************************************/
@@ -189,15 +282,27 @@ setup_iostream (GTask *task)
         return;
     }
 
-    /* Setup input events */
-    self->priv->input_source = g_pollable_input_stream_create_source (
-                                   G_POLLABLE_INPUT_STREAM (self->priv->istream),
-                                   NULL);
-    g_source_set_callback (self->priv->input_source,
-                           (GSourceFunc)input_ready_cb,
-                           self,
-                           NULL);
-    g_source_attach (self->priv->input_source, g_main_context_get_thread_default ());
+    /* Setup input events, either in our own thread or in the one of the
+     * caller */
+    if (self->priv->use_io_thread) {
+        GError *error = NULL;
+
+        if (!io_thread_start (self, &error)) {
+            destroy_iostream (self);
+            g_task_return_error (task, error);
+            g_object_unref (task);
+            return;
+        }
+    } else {
+        self->priv->input_source = g_pollable_input_stream_create_source (
+                                       G_POLLABLE_INPUT_STREAM (self->priv->istream),
+                                       NULL);
+        g_source_set_callback (self->priv->input_source,
+                               (GSourceFunc)input_ready_cb,
+                               self,
+                               NULL);
+        g_source_attach (self->priv->input_source, g_main_context_get_thread_default ());
+    }
 
     if (!ctx->use_proxy) {
         /* We're done here */
@@ -455,16 +560,713 @@ endpoint_is_open (QmiEndpoint *self)
               QMI_ENDPOINT_QMUX (self)->priv->ostream);
 }
 
+/*****************************************************************************/
+/* Output queue
+ *
+ * Messages are written asynchronously, one write at a time. When talking to
+ * a socket, all the messages waiting in the queue are coalesced into a single
+ * write; character devices instead require one write per message.
+ */
+
+typedef struct {
+    QmiMessage *message;
+    gint64      queued_time;
+} QueuedOutput;
+
+static void
+queued_output_free (QueuedOutput *output)
+{
+    qmi_message_unref (output->message);
+    g_slice_free (QueuedOutput, output);
+}
+
+/* The messages and the coalesced data are owned by the write operation until
+ * it returns, even if the endpoint gets closed in the meantime */
+typedef struct _OutputWrite {
+    QmiEndpointQmux *self;
+    GQueue           outputs;
+    GByteArray      *buffer;
+    GCancellable    *cancellable;
+} OutputWrite;
+
+static void
+output_write_free (OutputWrite *write)
+{
+    QueuedOutput *output;
+
+    while ((output = g_queue_pop_head (&write->outputs)) != NULL)
+        queued_output_free (output);
+    if (write->buffer)
+        g_byte_array_unref (write->buffer);
+    g_object_unref (write->cancellable);
+    g_object_unref (write->self);
+    g_slice_free (OutputWrite, write);
+}
+
+static void
+output_complete (QmiEndpointQmux *self,
+                 GQueue          *outputs,
+                 const GError    *error)
+{
+    QueuedOutput *output;
+    gint64        now;
+
+    now = g_get_monotonic_time ();
+    while ((output = g_queue_pop_head (outputs)) != NULL) {
+        if (error)
+            g_signal_emit_by_name (self, QMI_ENDPOINT_SIGNAL_SEND_FAILED, output->message, error);
+        else {
+            guint64 latency;
+
+            latency = (guint64)(now - output->queued_time);
+            self->priv->n_output_messages++;
+            self->priv->total_output_latency += latency;
+            self->priv->max_output_latency = MAX (self->priv->max_output_latency, latency);
+        }
+        queued_output_free (output);
+    }
+}
+
+static void output_queue_process (QmiEndpointQmux *self);
+
+static void
+output_write_ready (GOutputStream *ostream,
+                    GAsyncResult  *res,
+                    OutputWrite   *write)
+{
+    QmiEndpointQmux *self;
+    GError          *error = NULL;
+
+    self = write->self;
+    g_output_stream_write_all_finish (ostream, res, NULL, &error);
+
+    /* If the endpoint was closed, the messages were already reported */
+    if (g_cancellable_is_cancelled (write->cancellable)) {
+        g_clear_error (&error);
+        output_write_free (write);
+        return;
+    }
+
+    g_assert (self->priv->output_write == write);
+    self->priv->output_write = NULL;
+    self->priv->n_output_writes++;
+
+    if (error) {
+        g_prefix_error (&error, "Cannot write message: ");
+        g_warning ("[%s] %s", qmi_endpoint_get_name (QMI_ENDPOINT (self)), error->message);
+    }
+    output_complete (self, &write->outputs, error);
+    g_clear_error (&error);
+
+    /* Keep on writing whatever got queued in the meantime */
+    output_queue_process (self);
+    output_write_free (write);
+}
+
+static void
+output_queue_process (QmiEndpointQmux *self)
+{
+    OutputWrite   *write;
+    QueuedOutput  *output;
+    gconstpointer  data;
+    gsize          data_len;
+
+    /* One single write at a time */
+    if (!self->priv->ostream ||
+        self->priv->output_write ||
+        !self->priv->output_queue.length)
+        return;
+
+    write = g_slice_new0 (OutputWrite);
+    write->self = g_object_ref (self);
+    write->cancellable = g_cancellable_new ();
+    g_queue_init (&write->outputs);
+
+    output = g_queue_pop_head (&self->priv->output_queue);
+    g_queue_push_tail (&write->outputs, output);
+    data = qmi_message_get_raw (output->message, &data_len, NULL);
+
+    /* Coalesce all queued messages that fit into the same write */
+    if (self->priv->socket_connection && self->priv->output_queue.length) {
+        write->buffer = g_byte_array_sized_new (MAX_COALESCED_WRITE_SIZE);
+        g_byte_array_append (write->buffer, data, data_len);
+
+        while ((output = g_queue_peek_head (&self->priv->output_queue)) != NULL) {
+            gconstpointer next;
+            gsize         next_len;
+
+            next = qmi_message_get_raw (output->message, &next_len, NULL);
+            if (write->buffer->len + next_len > MAX_COALESCED_WRITE_SIZE)
+                break;
+            g_byte_array_append (write->buffer, next, next_len);
+            g_queue_push_tail (&write->outputs, g_queue_pop_head (&self->priv->output_queue));
+        }
+
+        data = write->buffer->data;
+        data_len = write->buffer->len;
+    }
+
+    self->priv->output_write = write;
+    g_output_stream_write_all_async (self->priv->ostream,
+                                     data,
+                                     data_len,
+                                     G_PRIORITY_DEFAULT,
+                                     write->cancellable,
+                                     (GAsyncReadyCallback)output_write_ready,
+                                     write);
+}
+
+static void
+output_queue_cancel (QmiEndpointQmux *self)
+{
+    g_autoptr(GError)  error = NULL;
+    OutputWrite       *write;
+
+    error = g_error_new (QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE, "Endpoint closed");
+
+    /* Messages not yet fully written are reported as failed right away */
+    write = g_steal_pointer (&self->priv->output_write);
+    if (write) {
+        GList *l;
+
+        g_cancellable_cancel (write->cancellable);
+        for (l = write->outputs.head; l; l = g_list_next (l))
+            g_signal_emit_by_name (self,
+                                   QMI_ENDPOINT_SIGNAL_SEND_FAILED,
+                                   ((QueuedOutput *)l->data)->message,
+                                   error);
+    }
+    output_complete (self, &self->priv->output_queue, error);
+}
+
+/*****************************************************************************/
+/* I/O thread
+ *
+ * When requested, the port is read and written in a dedicated thread, which
+ * also takes care of the framing and validation of the received messages.
+ * Only complete messages, data that broke framing and the results of the
+ * writes are handed over to the context of the endpoint owner, and only messages ready to be written
+ * are handed over to the I/O thread, each direction with its own queue. A
+ * single wakeup is scheduled for all the items pushed to a queue until the
+ * other side starts draining it.
+ */
+
+typedef enum {
+    IO_EVENT_MESSAGE,
+    IO_EVENT_DATA,
+    IO_EVENT_READ,
+    IO_EVENT_WRITE,
+    IO_EVENT_HANGUP,
+} IoEventType;
+
+typedef struct {
+    IoEventType  type;
+    /* IO_EVENT_MESSAGE */
+    QmiMessage  *message;
+    /* IO_EVENT_DATA */
+    GByteArray  *data;
+    /* IO_EVENT_READ */
+    guint        n_reads;
+    gsize        n_bytes;
+    /* IO_EVENT_WRITE */
+    GQueue       outputs;
+    GError      *error;
+} IoEvent;
+
+typedef struct _IoThread {
+    volatile gint    ref_count;
+    volatile gint    stopping;
+
+    /* Owner context only; unset once the thread is stopped */
+    QmiEndpointQmux *self;
+    GMainContext    *owner_context;
+    guint            n_outputs;
+
+    GThread         *thread;
+    gchar           *name;
+    GMainContext    *context;
+    GCancellable    *cancellable;
+    GInputStream    *istream;
+    GOutputStream   *ostream;
+    guint            read_size;
+    gboolean         coalesce_writes;
+
+    /* I/O thread only */
+    GSource         *input_source;
+    GByteArray      *buffer;
+    QueuedOutput    *next_output;
+
+    /* I/O thread -> owner context */
+    GAsyncQueue     *events;
+    volatile gint    events_scheduled;
+    /* Owner context -> I/O thread */
+    GAsyncQueue     *outputs;
+    volatile gint    outputs_scheduled;
+} IoThread;
+
+static IoEvent *
+io_event_new (IoEventType type)
+{
+    IoEvent *event;
+
+    event = g_slice_new0 (IoEvent);
+    event->type = type;
+    g_queue_init (&event->outputs);
+    return event;
+}
+
+static void
+io_event_free (IoEvent *event)
+{
+    QueuedOutput *output;
+
+    if (event->message)
+        qmi_message_unref (event->message);
+    if (event->data)
+        g_byte_array_unref (event->data);
+    while ((output = g_queue_pop_head (&event->outputs)) != NULL)
+        queued_output_free (output);
+    g_clear_error (&event->error);
+    g_slice_free (IoEvent, event);
+}
+
+static IoThread *
+io_thread_ref (IoThread *io)
+{
+    g_atomic_int_inc (&io->ref_count);
+    return io;
+}
+
+static void
+io_thread_unref (IoThread *io)
+{
+    if (!g_atomic_int_dec_and_test (&io->ref_count))
+        return;
+
+    g_assert (!io->thread);
+    if (io->input_source) {
+        g_source_destroy (io->input_source);
+        g_source_unref (io->input_source);
+    }
+    if (io->next_output)
+        queued_output_free (io->next_output);
+    g_async_queue_unref (io->events);
+    g_async_queue_unref (io->outputs);
+    g_byte_array_unref (io->buffer);
+    g_object_unref (io->istream);
+    g_object_unref (io->ostream);
+    g_object_unref (io->cancellable);
+    g_main_context_unref (io->context);
+    g_main_context_unref (io->owner_context);
+    g_free (io->name);
+    g_slice_free (IoThread, io);
+}
+
+/* Owner context */
+
+static void
+io_thread_process_event (IoThread        *io,
+                         QmiEndpointQmux *self,
+                         IoEvent         *event)
+{
+    switch (event->type) {
+    case IO_EVENT_MESSAGE:
+        qmi_endpoint_add_parsed_message (QMI_ENDPOINT (self), event->message);
+        break;
+    case IO_EVENT_DATA:
+        qmi_endpoint_add_message (QMI_ENDPOINT (self), event->data->data, event->data->len);
+        break;
+    case IO_EVENT_READ:
+        update_input_stats (self, event->n_reads, event->n_bytes);
+        break;
+    case IO_EVENT_WRITE:
+        io->n_outputs -= event->outputs.length;
+        self->priv->n_output_writes++;
+        if (event->error) {
+            g_prefix_error (&event->error, "Cannot write message: ");
+            g_warning ("[%s] %s", qmi_endpoint_get_name (QMI_ENDPOINT (self)), event->error->message);
+        }
+        output_complete (self, &event->outputs, event->error);
+        break;
+    case IO_EVENT_HANGUP:
+        g_signal_emit_by_name (self, QMI_ENDPOINT_SIGNAL_HANGUP);
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+}
+
 static gboolean
-endpoint_send (QmiEndpoint   *self,
+io_thread_events_cb (IoThread *io)
+{
+    QmiEndpointQmux *self;
+    IoEvent         *event;
+
+    /* Anything pushed from now on requires a new wakeup */
+    g_atomic_int_set (&io->events_scheduled, 0);
+
+    if (!io->self)
+        return G_SOURCE_REMOVE;
+
+    /* The endpoint may get closed while processing the events */
+    self = g_object_ref (io->self);
+    while (io->self && (event = g_async_queue_try_pop (io->events)) != NULL) {
+        io_thread_process_event (io, self, event);
+        io_event_free (event);
+    }
+    g_object_unref (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void io_thread_schedule_outputs (IoThread *io);
+
+static void
+io_thread_queue_output (IoThread     *io,
+                        QueuedOutput *output)
+{
+    io->n_outputs++;
+    g_async_queue_push (io->outputs, output);
+    io_thread_schedule_outputs (io);
+}
+
+/* I/O thread */
+
+static void
+io_thread_push_event (IoThread *io,
+                      IoEvent  *event)
+{
+    g_async_queue_push (io->events, event);
+
+    if (g_atomic_int_compare_and_exchange (&io->events_scheduled, 0, 1)) {
+        GSource *source;
+
+        source = g_idle_source_new ();
+        g_source_set_priority (source, G_PRIORITY_DEFAULT);
+        g_source_set_callback (source,
+                               (GSourceFunc)io_thread_events_cb,
+                               io_thread_ref (io),
+                               (GDestroyNotify)io_thread_unref);
+        g_source_attach (source, io->owner_context);
+        g_source_unref (source);
+    }
+}
+
+static void
+io_thread_push_message (QmiMessage *message,
+                        IoThread   *io)
+{
+    IoEvent *event;
+
+    event = io_event_new (IO_EVENT_MESSAGE);
+    event->message = qmi_message_ref (message);
+    io_thread_push_event (io, event);
+}
+
+static gboolean
+io_thread_parse_buffer (IoThread *io)
+{
+    g_autoptr(GError)  error = NULL;
+    IoEvent           *event;
+    guint              offset = 0;
+
+    if (qmi_endpoint_parse_messages (io->name,
+                                     &io->buffer,
+                                     &offset,
+                                     (QmiMessageHandler)io_thread_push_message,
+                                     io,
+                                     &error)) {
+        g_byte_array_remove_range (io->buffer, 0, offset);
+        return TRUE;
+    }
+
+    /* The unframed data is handed over to the endpoint owner, so that the
+     * framing error is reported and the port closed the same way as when the
+     * data is parsed in its own context */
+    event = io_event_new (IO_EVENT_DATA);
+    event->data = g_byte_array_sized_new (io->buffer->len - offset);
+    g_byte_array_append (event->data, &io->buffer->data[offset], io->buffer->len - offset);
+    io_thread_push_event (io, event);
+    g_byte_array_set_size (io->buffer, 0);
+    return FALSE;
+}
+
+static gboolean
+io_thread_input_ready_cb (GInputStream *istream,
+                          IoThread     *io)
+{
+    gboolean  hangup = FALSE;
+    gboolean  unframed = FALSE;
+    guint     n_reads = 0;
+    gsize     n_bytes = 0;
+
+    while (n_reads < MAX_READS_PER_WAKEUP) {
+        GError *error = NULL;
+        guint   len;
+        gssize  r;
+
+        len = io->buffer->len;
+        g_byte_array_set_size (io->buffer, len + io->read_size);
+        r = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (istream),
+                                                      &io->buffer->data[len],
+                                                      io->read_size,
+                                                      NULL,
+                                                      &error);
+        g_byte_array_set_size (io->buffer, len + (r > 0 ? (guint)r : 0));
+
+        if (r < 0) {
+            if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free (error);
+                break;
+            }
+            g_warning ("Error reading from istream: %s", error ? error->message : "unknown");
+            if (error)
+                g_error_free (error);
+            hangup = TRUE;
+            break;
+        }
+
+        if (r == 0) {
+            /* HUP! */
+            g_warning ("Cannot read from istream: connection broken");
+            hangup = TRUE;
+            break;
+        }
+
+        /* else, r > 0 */
+        n_reads++;
+        n_bytes += r;
+    }
+
+    if (n_reads > 0) {
+        IoEvent *event;
+
+        unframed = !io_thread_parse_buffer (io);
+
+        event = io_event_new (IO_EVENT_READ);
+        event->n_reads = n_reads;
+        event->n_bytes = n_bytes;
+        io_thread_push_event (io, event);
+    }
+
+    if (hangup)
+        io_thread_push_event (io, io_event_new (IO_EVENT_HANGUP));
+
+    /* Nothing else is read after a framing error, the port gets closed */
+    return (hangup || unframed) ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+}
+
+static QueuedOutput *
+io_thread_pop_output (IoThread *io)
+{
+    if (io->next_output)
+        return g_steal_pointer (&io->next_output);
+    return g_async_queue_try_pop (io->outputs);
+}
+
+static gboolean
+io_thread_outputs_cb (IoThread *io)
+{
+    QueuedOutput *output;
+
+    /* Anything pushed from now on requires a new wakeup */
+    g_atomic_int_set (&io->outputs_scheduled, 0);
+
+    while (!g_cancellable_is_cancelled (io->cancellable) &&
+           (output = io_thread_pop_output (io)) != NULL) {
+        g_autoptr(GByteArray)  buffer = NULL;
+        IoEvent               *event;
+        gconstpointer          data;
+        gsize                  data_len;
+
+        event = io_event_new (IO_EVENT_WRITE);
+        g_queue_push_tail (&event->outputs, output);
+        data = qmi_message_get_raw (output->message, &data_len, NULL);
+
+        /* Coalesce all queued messages that fit into the same write */
+        if (io->coalesce_writes) {
+            while ((io->next_output = g_async_queue_try_pop (io->outputs)) != NULL) {
+                gconstpointer next;
+                gsize         next_len;
+
+                next = qmi_message_get_raw (io->next_output->message, &next_len, NULL);
+                if (!buffer) {
+                    buffer = g_byte_array_sized_new (MAX_COALESCED_WRITE_SIZE);
+                    g_byte_array_append (buffer, data, data_len);
+                }
+                if (buffer->len + next_len > MAX_COALESCED_WRITE_SIZE)
+                    break;
+                g_byte_array_append (buffer, next, next_len);
+                g_queue_push_tail (&event->outputs, g_steal_pointer (&io->next_output));
+            }
+            if (buffer) {
+                data = buffer->data;
+                data_len = buffer->len;
+            }
+        }
+
+        /* The I/O thread is all about this, so just block until written */
+        g_output_stream_write_all (io->ostream, data, data_len, NULL, io->cancellable, &event->error);
+        io_thread_push_event (io, event);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+io_thread_schedule_outputs (IoThread *io)
+{
+    GSource *source;
+
+    if (!g_atomic_int_compare_and_exchange (&io->outputs_scheduled, 0, 1))
+        return;
+
+    /* Only dispatched while the thread runs, which keeps a reference */
+    source = g_idle_source_new ();
+    g_source_set_priority (source, G_PRIORITY_DEFAULT);
+    g_source_set_callback (source, (GSourceFunc)io_thread_outputs_cb, io, NULL);
+    g_source_attach (source, io->context);
+    g_source_unref (source);
+}
+
+static gpointer
+io_thread_func (IoThread *io)
+{
+    g_main_context_push_thread_default (io->context);
+    while (!g_atomic_int_get (&io->stopping))
+        g_main_context_iteration (io->context, TRUE);
+    g_main_context_pop_thread_default (io->context);
+    return NULL;
+}
+
+/* Owner context */
+
+static gboolean
+io_thread_start (QmiEndpointQmux  *self,
+                 GError          **error)
+{
+    IoThread *io;
+    GError   *inner_error = NULL;
+
+    io = g_slice_new0 (IoThread);
+    io->ref_count = 1;
+    io->self = self;
+    io->owner_context = g_main_context_ref_thread_default ();
+    io->context = g_main_context_new ();
+    io->cancellable = g_cancellable_new ();
+    io->istream = g_object_ref (self->priv->istream);
+    io->ostream = g_object_ref (self->priv->ostream);
+    io->name = g_strdup (qmi_endpoint_get_name (QMI_ENDPOINT (self)));
+    io->read_size = self->priv->read_size;
+    io->coalesce_writes = !!self->priv->socket_connection;
+    io->buffer = g_byte_array_new ();
+    io->events = g_async_queue_new ();
+    io->outputs = g_async_queue_new ();
+
+    io->input_source = g_pollable_input_stream_create_source (G_POLLABLE_INPUT_STREAM (io->istream), NULL);
+    g_source_set_callback (io->input_source, (GSourceFunc)io_thread_input_ready_cb, io, NULL);
+    g_source_attach (io->input_source, io->context);
+
+    io->thread = g_thread_try_new ("qmi-endpoint-io", (GThreadFunc)io_thread_func, io, &inner_error);
+    if (!io->thread) {
+        g_propagate_prefixed_error (error, inner_error, "Cannot create I/O thread: ");
+        io_thread_unref (io);
+        return FALSE;
+    }
+
+    self->priv->io_thread = io;
+    return TRUE;
+}
+
+static void
+io_thread_stop (QmiEndpointQmux *self)
+{
+    g_autoptr(GError)  error = NULL;
+    IoThread          *io;
+    IoEvent           *event;
+    QueuedOutput      *output;
+
+    io = g_steal_pointer (&self->priv->io_thread);
+    if (!io)
+        return;
+
+    /* Abort any blocking write and wait for the thread to exit */
+    g_cancellable_cancel (io->cancellable);
+    g_atomic_int_set (&io->stopping, 1);
+    g_main_context_wakeup (io->context);
+    g_thread_join (g_steal_pointer (&io->thread));
+    io->self = NULL;
+
+    /* Account the writes that were done and report the ones that didn't
+     * complete, as well as the pending ones, as failed; messages received
+     * but not yet processed are discarded */
+    error = g_error_new (QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE, "Endpoint closed");
+    while ((event = g_async_queue_try_pop (io->events)) != NULL) {
+        if (event->type == IO_EVENT_WRITE) {
+            self->priv->n_output_writes++;
+            output_complete (self,
+                             &event->outputs,
+                             (g_error_matches (event->error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ?
+                              error : event->error));
+        }
+        io_event_free (event);
+    }
+    while ((output = io_thread_pop_output (io)) != NULL) {
+        g_signal_emit_by_name (self, QMI_ENDPOINT_SIGNAL_SEND_FAILED, output->message, error);
+        queued_output_free (output);
+    }
+
+    io_thread_unref (io);
+}
+
+/*****************************************************************************/
+
+static guint
+get_output_queue_length (QmiEndpointQmux *self)
+{
+    if (self->priv->io_thread)
+        return self->priv->io_thread->n_outputs;
+    return (self->priv->output_queue.length +
+            (self->priv->output_write ? self->priv->output_write->outputs.length : 0));
+}
+
+void
+qmi_endpoint_qmux_get_output_stats (QmiEndpointQmux *self,
+                                    guint           *queue_length,
+                                    guint           *max_queue_length,
+                                    guint64         *n_writes,
+                                    guint64         *n_messages,
+                                    guint64         *average_latency,
+                                    guint64         *max_latency)
+{
+    if (queue_length)
+        *queue_length = get_output_queue_length (self);
+    if (max_queue_length)
+        *max_queue_length = self->priv->max_output_queue_length;
+    if (n_writes)
+        *n_writes = self->priv->n_output_writes;
+    if (n_messages)
+        *n_messages = self->priv->n_output_messages;
+    if (average_latency)
+        *average_latency = (self->priv->n_output_messages ?
+                            self->priv->total_output_latency / self->priv->n_output_messages :
+                            0);
+    if (max_latency)
+        *max_latency = self->priv->max_output_latency;
+}
+
+/*****************************************************************************/
+
+static gboolean
+endpoint_send (QmiEndpoint   *endpoint,
                QmiMessage    *message,
                guint          timeout,
                GCancellable  *cancellable,
                GError       **error)
 {
-    gconstpointer  raw_message;
-    gsize          raw_message_len;
-    GError        *inner_error = NULL;
+    QmiEndpointQmux *self = QMI_ENDPOINT_QMUX (endpoint);
+    QueuedOutput    *output;
+    guint            queue_length;
 
     /* QMUX endpoint allows only QMUX messages */
     if (qmi_message_get_marker (message) != QMI_MESSAGE_QMUX_MARKER) {
@@ -482,25 +1284,33 @@ endpoint_send (QmiEndpoint   *self,
         return FALSE;
     }
 
-    /* Get raw message */
-    raw_message = qmi_message_get_raw (message, &raw_message_len, &inner_error);
-    if (!raw_message) {
-        g_propagate_prefixed_error (error, inner_error, "Cannot get raw message: ");
+    if (!self->priv->ostream) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Endpoint is not open");
         return FALSE;
     }
 
-    if (!g_output_stream_write_all (QMI_ENDPOINT_QMUX (self)->priv->ostream,
-                                    raw_message,
-                                    raw_message_len,
-                                    NULL, /* bytes_written */
-                                    NULL, /* cancellable */
-                                    &inner_error)) {
-        g_propagate_prefixed_error (error, inner_error, "Cannot write message: ");
+    /* Don't let callers queue requests without limit if the device doesn't
+     * keep up with them */
+    queue_length = get_output_queue_length (self);
+    if (queue_length >= MAX_OUTPUT_QUEUE_LENGTH) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED,
+                     "Cannot write message: output queue is full");
         return FALSE;
     }
 
-    /* Flush explicitly if correctly written */
-    g_output_stream_flush (QMI_ENDPOINT_QMUX (self)->priv->ostream, NULL, NULL);
+    output = g_slice_new (QueuedOutput);
+    output->message = qmi_message_ref (message);
+    output->queued_time = g_get_monotonic_time ();
+    self->priv->max_output_queue_length = MAX (self->priv->max_output_queue_length, queue_length + 1);
+
+    if (self->priv->io_thread) {
+        io_thread_queue_output (self->priv->io_thread, output);
+        return TRUE;
+    }
+
+    g_queue_push_tail (&self->priv->output_queue, output);
+    output_queue_process (self);
     return TRUE;
 }
 
@@ -517,6 +1327,8 @@ endpoint_close_finish (QmiEndpoint   *self,
 static void
 destroy_iostream (QmiEndpointQmux *self)
 {
+    io_thread_stop (self);
+    output_queue_cancel (self);
     if (self->priv->input_source) {
         g_source_destroy (self->priv->input_source);
         g_clear_pointer (&self->priv->input_source, g_source_unref);
@@ -555,7 +1367,9 @@ endpoint_close (QmiEndpoint         *endpoint,
 QmiEndpointQmux *
 qmi_endpoint_qmux_new (QmiFile      *file,
                        const gchar  *proxy_path,
-                       QmiClientCtl *client_ctl)
+                       QmiClientCtl *client_ctl,
+                       guint         read_size,
+                       gboolean      use_io_thread)
 {
     QmiEndpointQmux *self;
 
@@ -567,6 +1381,8 @@ qmi_endpoint_qmux_new (QmiFile      *file,
                          NULL);
     self->priv->proxy_path = g_strdup (proxy_path);
     self->priv->client_ctl = g_object_ref (client_ctl);
+    self->priv->read_size = MIN (read_size, QMI_ENDPOINT_BUFFER_MAX_RETAINED_SIZE);
+    self->priv->use_io_thread = use_io_thread;
     return self;
 }
 
@@ -52,8 +52,27 @@ struct _QmiEndpointQmuxClass {
 GType qmi_endpoint_qmux_get_type (void);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (QmiEndpointQmux, g_object_unref)
 
+/* If @use_io_thread is set, the port is read and written in a dedicated
+ * thread, and only complete messages are reported in the caller context */
 QmiEndpointQmux *qmi_endpoint_qmux_new (QmiFile      *file,
                                         const gchar  *proxy_path,
-                                        QmiClientCtl *client_ctl);
+                                        QmiClientCtl *client_ctl,
+                                        guint         read_size,
+                                        gboolean      use_io_thread);
+
+void qmi_endpoint_qmux_get_input_stats (QmiEndpointQmux *self,
+                                        guint64         *n_wakeups,
+                                        guint64         *n_reads,
+                                        guint64         *n_bytes,
+                                        guint           *max_reads_per_wakeup,
+                                        gsize           *max_bytes_per_wakeup);
+
+void qmi_endpoint_qmux_get_output_stats (QmiEndpointQmux *self,
+                                         guint           *queue_length,
+                                         guint           *max_queue_length,
+                                         guint64         *n_writes,
+                                         guint64         *n_messages,
+                                         guint64         *average_latency,
+                                         guint64         *max_latency);
 
 #endif /* _LIBQMI_GLIB_QMI_ENDPOINT_QMUX_H_ */
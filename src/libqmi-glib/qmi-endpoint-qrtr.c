@@ -54,26 +54,22 @@ struct _QmiEndpointQrtrPrivate {
     guint     node_removed_id;
     gboolean  node_removed;
 
-    gboolean  endpoint_open;
-    GList    *clients;
+    gboolean    endpoint_open;
+    /* HT of (service,cid) -> ClientInfo */
+    GHashTable *clients;
+    /* HT of service -> ServiceCids */
+    GHashTable *service_cids;
 };
 
 /*****************************************************************************/
 
 static void
-add_qmi_message_to_buffer (QmiEndpointQrtr *self,
-                           QmiMessage      *message)
+report_qmi_message (QmiEndpointQrtr *self,
+                    QmiMessage      *message)
 {
-    g_autoptr(GError)  error = NULL;
-    const guint8      *raw_message;
-    gsize              raw_message_len;
-
-    raw_message = qmi_message_get_raw (message, &raw_message_len, &error);
-    if (!raw_message)
-        g_warning ("[%s] Got malformed QMI message: %s",
-                   qmi_endpoint_get_name (QMI_ENDPOINT (self)), error->message);
-    else
-        qmi_endpoint_add_message (QMI_ENDPOINT (self), raw_message, raw_message_len);
+    /* Messages are already complete, so there is no need to go through the
+     * generic buffer and parse them again */
+    qmi_endpoint_add_parsed_message (QMI_ENDPOINT (self), message);
     qmi_message_unref (message);
 }
 
@@ -97,10 +93,11 @@ client_info_free (ClientInfo *client_info)
     g_slice_free (ClientInfo, client_info);
 }
 
-static void
-client_info_list_free (GList *list)
+static gpointer
+build_client_info_key (QmiService service,
+                       guint      cid)
 {
-    g_list_free_full (list, (GDestroyNotify) client_info_free);
+    return GUINT_TO_POINTER (((guint16)service << 8) | (guint8)cid);
 }
 
 static ClientInfo *
@@ -108,27 +105,95 @@ client_info_lookup (QmiEndpointQrtr *self,
                     QmiService       service,
                     guint            cid)
 {
-    GList *l;
+    if (!self->priv->clients)
+        return NULL;
+    return g_hash_table_lookup (self->priv->clients, build_client_info_key (service, cid));
+}
+
+/*****************************************************************************/
+/* CIDs in use, per service */
 
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
-        ClientInfo *client_info = l->data;
+#define CID_BITMAP_WORDS ((G_MAXUINT8 + 1) / 32)
 
-        if ((service == client_info->service) &&
-            (cid == client_info->cid))
-            return client_info;
+typedef struct {
+    guint32 used[CID_BITMAP_WORDS];
+    guint   last_cid;
+} ServiceCids;
+
+static void
+service_cids_free (ServiceCids *cids)
+{
+    g_slice_free (ServiceCids, cids);
+}
+
+static ServiceCids *
+service_cids_get (QmiEndpointQrtr *self,
+                  QmiService       service)
+{
+    ServiceCids *cids;
+
+    if (!self->priv->service_cids)
+        self->priv->service_cids = g_hash_table_new_full (g_direct_hash,
+                                                          g_direct_equal,
+                                                          NULL,
+                                                          (GDestroyNotify)service_cids_free);
+
+    cids = g_hash_table_lookup (self->priv->service_cids, GUINT_TO_POINTER (service));
+    if (!cids) {
+        cids = g_slice_new0 (ServiceCids);
+        /* CID 0 is never allocated */
+        cids->used[0] = 1;
+        g_hash_table_insert (self->priv->service_cids, GUINT_TO_POINTER (service), cids);
     }
-    return NULL;
+    return cids;
 }
 
-static gint
-client_info_cmp (const ClientInfo *a,
-                 const ClientInfo *b)
+/* Lowest CID not in use starting at @from, or 0 if none available */
+static guint
+service_cids_find_free (const ServiceCids *cids,
+                        guint              from)
 {
-    if (a->service != b->service)
-        return a->service - b->service;
-    return a->cid - b->cid;
+    guint word;
+
+    for (word = from / 32; word < CID_BITMAP_WORDS; word++) {
+        guint32 available;
+
+        available = ~cids->used[word];
+        if (word == from / 32)
+            available &= G_MAXUINT32 << (from % 32);
+        if (available)
+            return (word * 32) + g_bit_nth_lsf (available, -1);
+    }
+    return 0;
+}
+
+static guint
+service_cids_allocate (ServiceCids *cids)
+{
+    guint cid;
+
+    /* Keep on using new CIDs after the last one allocated, and only reuse
+     * the released ones once the whole range has been used */
+    cid = service_cids_find_free (cids, cids->last_cid + 1);
+    if (!cid)
+        cid = service_cids_find_free (cids, 1);
+    if (!cid)
+        return 0;
+
+    cids->used[cid / 32] |= (1U << (cid % 32));
+    cids->last_cid = cid;
+    return cid;
 }
 
+static void
+service_cids_release (ServiceCids *cids,
+                      guint        cid)
+{
+    cids->used[cid / 32] &= ~(1U << (cid % 32));
+}
+
+/*****************************************************************************/
+
 static void
 client_message_cb (QrtrClient      *qrtr_client,
                    GByteArray      *qrtr_message,
@@ -142,13 +207,13 @@ client_message_cb (QrtrClient      *qrtr_client,
     service = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (qrtr_client), QRTR_CLIENT_DATA_SERVICE));
     cid     = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (qrtr_client), QRTR_CLIENT_DATA_CID));
 
-    /* Create a fake QMUX/QRTR header and add this message to the buffer */
+    /* Create a fake QMUX/QRTR header and report this message */
     message = qmi_message_new_from_data (service, cid, qrtr_message, &error);
     if (!message)
         g_warning ("[%s] Got malformed QMI message: %s",
                    qmi_endpoint_get_name (QMI_ENDPOINT (self)), error->message);
     else
-        add_qmi_message_to_buffer (self, message);
+        report_qmi_message (self, message);
 }
 
 static ClientInfo *
@@ -156,34 +221,11 @@ client_info_new (QmiEndpointQrtr  *self,
                  QmiService        service,
                  GError          **error)
 {
-    ClientInfo *client_info;
-    QrtrClient *qrtr_client;
-    GList      *l;
-    guint       max_cid = 0;
-    guint       min_available_cid = 1;
-    guint       cid = 0;
-    gint32      port;
-
-    for (l = self->priv->clients; l; l = g_list_next (l)) {
-        client_info = l->data;
-
-        if (service != client_info->service)
-            continue;
-
-        max_cid = client_info->cid;
-        if (min_available_cid == client_info->cid)
-            min_available_cid++;
-    }
-
-    cid = max_cid + 1;
-    if (cid > G_MAXUINT8) {
-        cid = min_available_cid;
-        if (min_available_cid > G_MAXUINT8) {
-            g_set_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_CLIENT_IDS_EXHAUSTED,
-                         "Client IDs have been exhausted");
-            return NULL;
-        }
-    }
+    ClientInfo  *client_info;
+    ServiceCids *cids;
+    QrtrClient  *qrtr_client;
+    guint        cid = 0;
+    gint32       port;
 
     port = qrtr_node_lookup_port (self->priv->node, service);
     if (port < 0) {
@@ -192,9 +234,18 @@ client_info_new (QmiEndpointQrtr  *self,
         return NULL;
     }
 
+    cids = service_cids_get (self, service);
+    cid = service_cids_allocate (cids);
+    if (!cid) {
+        g_set_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_CLIENT_IDS_EXHAUSTED,
+                     "Client IDs have been exhausted");
+        return NULL;
+    }
+
     qrtr_client = qrtr_client_new (self->priv->node, (guint)port, NULL, error);
     if (!qrtr_client) {
         g_prefix_error (error, "Couldn't create QRTR client: ");
+        service_cids_release (cids, cid);
         return NULL;
     }
 
@@ -211,9 +262,12 @@ client_info_new (QmiEndpointQrtr  *self,
                                                        G_CALLBACK (client_message_cb),
                                                        self);
 
-    self->priv->clients = g_list_insert_sorted (self->priv->clients,
-                                                client_info,
-                                                (GCompareFunc)client_info_cmp);
+    if (!self->priv->clients)
+        self->priv->clients = g_hash_table_new_full (g_direct_hash,
+                                                     g_direct_equal,
+                                                     NULL,
+                                                     (GDestroyNotify)client_info_free);
+    g_hash_table_insert (self->priv->clients, build_client_info_key (service, cid), client_info);
 
     return client_info;
 }
@@ -252,8 +306,8 @@ release_client (QmiEndpointQrtr *self,
     if (!client_info)
         return;
 
-    self->priv->clients = g_list_remove (self->priv->clients, client_info);
-    client_info_free (client_info);
+    service_cids_release (service_cids_get (self, service), cid);
+    g_hash_table_remove (self->priv->clients, build_client_info_key (service, cid));
 }
 
 /*****************************************************************************/
@@ -299,7 +353,7 @@ reply_protocol_error (QmiEndpointQrtr  *self,
 
     response = qmi_message_response_new (message, error);
     if (response)
-        add_qmi_message_to_buffer (self, response);
+        report_qmi_message (self, response);
 }
 
 static void
@@ -358,7 +412,7 @@ handle_alloc_cid (QmiEndpointQrtr *self,
     if (!construct_alloc_tlv (response, service, cid))
         return;
 
-    add_qmi_message_to_buffer (self, g_steal_pointer (&response));
+    report_qmi_message (self, g_steal_pointer (&response));
 }
 
 static void
@@ -418,7 +472,7 @@ handle_release_cid (QmiEndpointQrtr *self,
     if (!construct_alloc_tlv (response, service, cid))
         return;
 
-    add_qmi_message_to_buffer (self, g_steal_pointer (&response));
+    report_qmi_message (self, g_steal_pointer (&response));
 }
 
 static void
@@ -564,7 +618,8 @@ endpoint_send (QmiEndpoint   *endpoint,
 static void
 internal_close (QmiEndpointQrtr *self)
 {
-    g_clear_pointer (&self->priv->clients, client_info_list_free);
+    g_clear_pointer (&self->priv->clients, g_hash_table_unref);
+    g_clear_pointer (&self->priv->service_cids, g_hash_table_unref);
     self->priv->endpoint_open = FALSE;
 }
 
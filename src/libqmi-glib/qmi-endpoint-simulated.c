@@ -0,0 +1,715 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <gio/gio.h>
+
+#include "qmi-endpoint-simulated.h"
+#include "qmi-errors.h"
+#include "qmi-enum-types.h"
+#include "qmi-error-types.h"
+#include "qmi-message.h"
+
+#define QMI_MESSAGE_TLV_ALLOCATION_INFO 0x01
+#define QMI_MESSAGE_TLV_SERVICE_LIST    0x01
+
+#define QMI_MESSAGE_CTL_GET_VERSION_INFO 0x0021
+#define QMI_MESSAGE_CTL_SET_DATA_FORMAT  0x0026
+#define QMI_MESSAGE_CTL_SYNC             0x0027
+
+/* Version reported for every service in the version info response */
+#define SIMULATED_SERVICE_MAJOR_VERSION 1
+#define SIMULATED_SERVICE_MINOR_VERSION 0
+
+G_DEFINE_TYPE (QmiEndpointSimulated, qmi_endpoint_simulated, QMI_TYPE_ENDPOINT)
+
+struct _QmiEndpointSimulatedPrivate {
+    gboolean endpoint_open;
+
+    /* Context where the endpoint was open, like the input of a real port */
+    GMainContext *context;
+
+    /* Configuration, shared with the owner */
+    GHashTable *responses;
+    GPtrArray  *indications;
+
+    /* HT of (service,cid) of the allocated clients */
+    GHashTable *clients;
+    /* HT of service -> last CID allocated */
+    GHashTable *last_cids;
+
+    /* Responses waiting for their latency to elapse */
+    GQueue     pending_replies;
+    /* Sources emitting the indications */
+    GPtrArray *indication_sources;
+};
+
+/*****************************************************************************/
+
+QmiSimulatedResponse *
+qmi_simulated_response_new (QmiMessage *response,
+                            guint       latency_ms)
+{
+    QmiSimulatedResponse *self;
+
+    self = g_slice_new (QmiSimulatedResponse);
+    self->response = qmi_message_ref (response);
+    self->latency_ms = latency_ms;
+    return self;
+}
+
+void
+qmi_simulated_response_free (QmiSimulatedResponse *self)
+{
+    qmi_message_unref (self->response);
+    g_slice_free (QmiSimulatedResponse, self);
+}
+
+gpointer
+qmi_simulated_response_key (QmiService service,
+                            guint16    message_id)
+{
+    return GUINT_TO_POINTER (((guint32)service << 16) | message_id);
+}
+
+QmiSimulatedIndication *
+qmi_simulated_indication_new (QmiMessage *indication,
+                              guint       interval_ms)
+{
+    QmiSimulatedIndication *self;
+
+    self = g_slice_new (QmiSimulatedIndication);
+    self->indication = qmi_message_ref (indication);
+    self->interval_ms = interval_ms;
+    return self;
+}
+
+void
+qmi_simulated_indication_free (QmiSimulatedIndication *self)
+{
+    qmi_message_unref (self->indication);
+    g_slice_free (QmiSimulatedIndication, self);
+}
+
+/*****************************************************************************/
+
+/* Builds a new message with the contents of @message_template, as if it had
+ * just been received from the modem */
+static QmiMessage *
+build_message_from_template (QmiMessage  *message_template,
+                             guint8       client_id,
+                             GError     **error)
+{
+    const guint8          *data;
+    gsize                  data_len;
+    g_autoptr(GByteArray)  qmi_data = NULL;
+
+    data = qmi_message_get_data (message_template, &data_len, error);
+    if (!data)
+        return NULL;
+
+    qmi_data = g_byte_array_sized_new (data_len);
+    g_byte_array_append (qmi_data, data, data_len);
+    return qmi_message_new_from_data (qmi_message_get_service (message_template), client_id, qmi_data, error);
+}
+
+static void
+report_qmi_message (QmiEndpointSimulated *self,
+                    QmiMessage           *message)
+{
+    qmi_endpoint_add_parsed_message (QMI_ENDPOINT (self), message);
+    qmi_message_unref (message);
+}
+
+/*****************************************************************************/
+/* Replies, always reported asynchronously like a real modem would */
+
+typedef struct {
+    QmiEndpointSimulated *self;
+    QmiMessage           *response;
+    GSource              *source;
+    GList                 link;
+} PendingReply;
+
+static void
+pending_reply_free (PendingReply *reply)
+{
+    qmi_message_unref (reply->response);
+    g_slice_free (PendingReply, reply);
+}
+
+static gboolean
+pending_reply_cb (PendingReply *reply)
+{
+    QmiEndpointSimulated *self;
+
+    self = g_object_ref (reply->self);
+    g_queue_unlink (&self->priv->pending_replies, &reply->link);
+    report_qmi_message (self, qmi_message_ref (reply->response));
+    g_object_unref (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_reply (QmiEndpointSimulated *self,
+                QmiMessage           *response,
+                guint                 latency_ms)
+{
+    PendingReply *reply;
+
+    reply = g_slice_new0 (PendingReply);
+    reply->self = self;
+    reply->response = response;
+    reply->link.data = reply;
+
+    reply->source = latency_ms ? g_timeout_source_new (latency_ms) : g_idle_source_new ();
+    g_source_set_callback (reply->source,
+                           (GSourceFunc) pending_reply_cb,
+                           reply,
+                           (GDestroyNotify) pending_reply_free);
+    g_source_attach (reply->source, self->priv->context);
+    /* The context owns the source until it's destroyed */
+    g_source_unref (reply->source);
+
+    g_queue_push_tail_link (&self->priv->pending_replies, &reply->link);
+}
+
+static void
+cancel_pending_replies (QmiEndpointSimulated *self)
+{
+    GList *l;
+
+    while ((l = g_queue_pop_head_link (&self->priv->pending_replies)) != NULL)
+        g_source_destroy (((PendingReply *)l->data)->source);
+}
+
+static void
+reply_protocol_error (QmiEndpointSimulated *self,
+                      QmiMessage           *message,
+                      QmiProtocolError      error)
+{
+    schedule_reply (self, qmi_message_response_new (message, error), 0);
+}
+
+/*****************************************************************************/
+/* Indications */
+
+typedef struct {
+    QmiEndpointSimulated   *self;
+    QmiSimulatedIndication *indication;
+} IndicationContext;
+
+static void
+indication_context_free (IndicationContext *ctx)
+{
+    g_slice_free (IndicationContext, ctx);
+}
+
+static gboolean
+indication_cb (IndicationContext *ctx)
+{
+    QmiEndpointSimulated *self;
+    QmiMessage           *message;
+    g_autoptr(GError)     error = NULL;
+
+    message = build_message_from_template (ctx->indication->indication,
+                                           qmi_message_get_client_id (ctx->indication->indication),
+                                           &error);
+    if (!message) {
+        g_warning ("[%s] cannot build simulated indication: %s",
+                   qmi_endpoint_get_name (QMI_ENDPOINT (ctx->self)), error->message);
+        return G_SOURCE_REMOVE;
+    }
+
+    self = g_object_ref (ctx->self);
+    report_qmi_message (self, message);
+    g_object_unref (self);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+indication_source_free (GSource *source)
+{
+    g_source_destroy (source);
+    g_source_unref (source);
+}
+
+static void
+start_indication (QmiEndpointSimulated   *self,
+                  QmiSimulatedIndication *indication)
+{
+    IndicationContext *ctx;
+    GSource           *source;
+
+    ctx = g_slice_new (IndicationContext);
+    ctx->self = self;
+    ctx->indication = indication;
+
+    source = g_timeout_source_new (indication->interval_ms);
+    g_source_set_callback (source,
+                           (GSourceFunc) indication_cb,
+                           ctx,
+                           (GDestroyNotify) indication_context_free);
+    g_source_attach (source, self->priv->context);
+
+    if (!self->priv->indication_sources)
+        self->priv->indication_sources = g_ptr_array_new_with_free_func ((GDestroyNotify) indication_source_free);
+    g_ptr_array_add (self->priv->indication_sources, source);
+}
+
+void
+qmi_endpoint_simulated_start_indication (QmiEndpointSimulated   *self,
+                                         QmiSimulatedIndication *indication)
+{
+    if (self->priv->endpoint_open)
+        start_indication (self, indication);
+}
+
+/*****************************************************************************/
+/* Client ids */
+
+static gpointer
+build_client_key (QmiService service,
+                  guint      cid)
+{
+    return GUINT_TO_POINTER (((guint32)service << 8) | (guint8)cid);
+}
+
+static guint
+allocate_cid (QmiEndpointSimulated *self,
+              QmiService            service)
+{
+    guint last_cid;
+    guint i;
+
+    if (!self->priv->clients) {
+        self->priv->clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+        self->priv->last_cids = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+    /* Next-fit in the [1,254] range, as 255 is the broadcast CID */
+    last_cid = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->last_cids, GUINT_TO_POINTER (service)));
+    for (i = 0; i < G_MAXUINT8 - 1; i++) {
+        guint cid;
+
+        cid = ((last_cid + i) % (G_MAXUINT8 - 1)) + 1;
+        if (!g_hash_table_contains (self->priv->clients, build_client_key (service, cid))) {
+            g_hash_table_add (self->priv->clients, build_client_key (service, cid));
+            g_hash_table_insert (self->priv->last_cids, GUINT_TO_POINTER (service), GUINT_TO_POINTER (cid));
+            return cid;
+        }
+    }
+    return 0;
+}
+
+static void
+release_cid (QmiEndpointSimulated *self,
+             QmiService            service,
+             guint                 cid)
+{
+    if (self->priv->clients)
+        g_hash_table_remove (self->priv->clients, build_client_key (service, cid));
+}
+
+/*****************************************************************************/
+/* CTL service */
+
+static gboolean
+construct_alloc_tlv (QmiMessage *message,
+                     QmiService  service,
+                     guint8      client)
+{
+    gsize init_offset;
+
+    init_offset = qmi_message_tlv_write_init (message,
+                                              QMI_MESSAGE_TLV_ALLOCATION_INFO,
+                                              NULL);
+
+    if (qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_ALLOCATE_CID ||
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_RELEASE_CID)
+        return init_offset &&
+                qmi_message_tlv_write_guint8 (message, service, NULL) &&
+                qmi_message_tlv_write_guint8 (message, client, NULL) &&
+                qmi_message_tlv_write_complete (message, init_offset, NULL);
+
+    return init_offset &&
+            qmi_message_tlv_write_guint16 (message, QMI_ENDIAN_LITTLE, service, NULL) &&
+            qmi_message_tlv_write_guint8 (message, client, NULL) &&
+            qmi_message_tlv_write_complete (message, init_offset, NULL);
+}
+
+static gboolean
+read_alloc_tlv (QmiMessage  *message,
+                QmiService  *service,
+                guint8      *cid,
+                GError     **error)
+{
+    gsize offset = 0;
+    gsize init_offset;
+
+    if ((init_offset = qmi_message_tlv_read_init (message, QMI_MESSAGE_TLV_ALLOCATION_INFO, NULL, error)) == 0)
+        return FALSE;
+
+    if (qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_ALLOCATE_CID ||
+        qmi_message_get_message_id (message) == QMI_MESSAGE_CTL_RELEASE_CID) {
+        guint8 service_tmp;
+
+        if (!qmi_message_tlv_read_guint8 (message, init_offset, &offset, &service_tmp, error))
+            return FALSE;
+        *service = (QmiService)service_tmp;
+    } else {
+        guint16 service_tmp;
+
+        if (!qmi_message_tlv_read_guint16 (message, init_offset, &offset, QMI_ENDIAN_LITTLE, &service_tmp, error))
+            return FALSE;
+        *service = (QmiService)service_tmp;
+    }
+
+    /* Only given when releasing */
+    if (cid && !qmi_message_tlv_read_guint8 (message, init_offset, &offset, cid, error))
+        return FALSE;
+
+    return TRUE;
+}
+
+static void
+handle_alloc_cid (QmiEndpointSimulated *self,
+                  QmiMessage           *message)
+{
+    QmiService            service = QMI_SERVICE_UNKNOWN;
+    guint                 cid;
+    g_autoptr(QmiMessage) response = NULL;
+    g_autoptr(GError)     error = NULL;
+
+    if (!read_alloc_tlv (message, &service, NULL, &error)) {
+        g_debug ("[%s] error allocating CID: could not parse message: %s",
+                 qmi_endpoint_get_name (QMI_ENDPOINT (self)), error->message);
+        reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+        return;
+    }
+
+    cid = allocate_cid (self, service);
+    if (!cid) {
+        reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_CLIENT_IDS_EXHAUSTED);
+        return;
+    }
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_NONE);
+    if (!construct_alloc_tlv (response, service, cid))
+        return;
+
+    schedule_reply (self, g_steal_pointer (&response), 0);
+}
+
+static void
+handle_release_cid (QmiEndpointSimulated *self,
+                    QmiMessage           *message)
+{
+    QmiService            service = QMI_SERVICE_UNKNOWN;
+    guint8                cid = 0;
+    g_autoptr(QmiMessage) response = NULL;
+    g_autoptr(GError)     error = NULL;
+
+    if (!read_alloc_tlv (message, &service, &cid, &error)) {
+        g_debug ("[%s] error releasing CID: could not parse message: %s",
+                 qmi_endpoint_get_name (QMI_ENDPOINT (self)), error->message);
+        reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE);
+        return;
+    }
+
+    release_cid (self, service, cid);
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_NONE);
+    if (!construct_alloc_tlv (response, service, cid))
+        return;
+
+    schedule_reply (self, g_steal_pointer (&response), 0);
+}
+
+static void
+handle_get_version_info (QmiEndpointSimulated *self,
+                         QmiMessage           *message)
+{
+    g_autoptr(QmiMessage)  response = NULL;
+    GEnumClass            *enum_class;
+    gsize                  init_offset;
+    guint8                 n_services = 0;
+    guint                  i;
+
+    /* Every service known by the library is reported as supported */
+    enum_class = G_ENUM_CLASS (g_type_class_ref (QMI_TYPE_SERVICE));
+    for (i = 0; i < enum_class->n_values; i++) {
+        if (enum_class->values[i].value >= QMI_SERVICE_CTL && enum_class->values[i].value <= G_MAXUINT8)
+            n_services++;
+    }
+
+    response = qmi_message_response_new (message, QMI_PROTOCOL_ERROR_NONE);
+    init_offset = qmi_message_tlv_write_init (response, QMI_MESSAGE_TLV_SERVICE_LIST, NULL);
+    if (init_offset)
+        qmi_message_tlv_write_guint8 (response, n_services, NULL);
+    for (i = 0; init_offset && i < enum_class->n_values; i++) {
+        if (enum_class->values[i].value < QMI_SERVICE_CTL || enum_class->values[i].value > G_MAXUINT8)
+            continue;
+        if (!qmi_message_tlv_write_guint8 (response, (guint8)enum_class->values[i].value, NULL) ||
+            !qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, SIMULATED_SERVICE_MAJOR_VERSION, NULL) ||
+            !qmi_message_tlv_write_guint16 (response, QMI_ENDIAN_LITTLE, SIMULATED_SERVICE_MINOR_VERSION, NULL))
+            init_offset = 0;
+    }
+    g_type_class_unref (enum_class);
+
+    if (!init_offset || !qmi_message_tlv_write_complete (response, init_offset, NULL)) {
+        reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_INTERNAL);
+        return;
+    }
+
+    schedule_reply (self, g_steal_pointer (&response), 0);
+}
+
+static void
+handle_sync (QmiEndpointSimulated *self,
+             QmiMessage           *message)
+{
+    /* All client ids are released on a sync */
+    if (self->priv->clients)
+        g_hash_table_remove_all (self->priv->clients);
+    reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_NONE);
+}
+
+static void
+handle_ctl_message (QmiEndpointSimulated *self,
+                    QmiMessage           *message)
+{
+    switch (qmi_message_get_message_id (message)) {
+        case QMI_MESSAGE_CTL_ALLOCATE_CID:
+        case QMI_MESSAGE_CTL_INTERNAL_ALLOCATE_CID_QRTR:
+            handle_alloc_cid (self, message);
+            break;
+        case QMI_MESSAGE_CTL_RELEASE_CID:
+        case QMI_MESSAGE_CTL_INTERNAL_RELEASE_CID_QRTR:
+            handle_release_cid (self, message);
+            break;
+        case QMI_MESSAGE_CTL_GET_VERSION_INFO:
+            handle_get_version_info (self, message);
+            break;
+        case QMI_MESSAGE_CTL_SYNC:
+            handle_sync (self, message);
+            break;
+        case QMI_MESSAGE_CTL_SET_DATA_FORMAT:
+            reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_NONE);
+            break;
+        default:
+            reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_NOT_SUPPORTED);
+            break;
+    }
+}
+
+/*****************************************************************************/
+
+static gboolean
+endpoint_open_finish (QmiEndpoint   *self,
+                      GAsyncResult  *res,
+                      GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+endpoint_open (QmiEndpoint         *endpoint,
+               gboolean             use_proxy,
+               guint                timeout,
+               GCancellable        *cancellable,
+               GAsyncReadyCallback  callback,
+               gpointer             user_data)
+{
+    QmiEndpointSimulated *self = QMI_ENDPOINT_SIMULATED (endpoint);
+    GTask                *task;
+    guint                 i;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    if (self->priv->endpoint_open) {
+        g_task_return_new_error (task,
+                                 QMI_CORE_ERROR,
+                                 QMI_CORE_ERROR_WRONG_STATE,
+                                 "Already open");
+        g_object_unref (task);
+        return;
+    }
+
+    if (use_proxy)
+        g_debug ("[%s] proxy not used with simulated endpoint",
+                 qmi_endpoint_get_name (endpoint));
+
+    self->priv->endpoint_open = TRUE;
+    self->priv->context = g_main_context_ref_thread_default ();
+    for (i = 0; i < self->priv->indications->len; i++)
+        start_indication (self, g_ptr_array_index (self->priv->indications, i));
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+static gboolean
+endpoint_is_open (QmiEndpoint *self)
+{
+    return QMI_ENDPOINT_SIMULATED (self)->priv->endpoint_open;
+}
+
+static gboolean
+endpoint_send (QmiEndpoint   *endpoint,
+               QmiMessage    *message,
+               guint          timeout,
+               GCancellable  *cancellable,
+               GError       **error)
+{
+    QmiEndpointSimulated *self = QMI_ENDPOINT_SIMULATED (endpoint);
+    QmiSimulatedResponse *simulated;
+    QmiMessage           *response;
+
+    if (!self->priv->endpoint_open) {
+        g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE,
+                     "Endpoint is not open");
+        return FALSE;
+    }
+
+    /* Configured responses take precedence, even for CTL messages */
+    simulated = g_hash_table_lookup (self->priv->responses,
+                                     qmi_simulated_response_key (qmi_message_get_service (message),
+                                                                 qmi_message_get_message_id (message)));
+    if (!simulated) {
+        if (qmi_message_get_service (message) == QMI_SERVICE_CTL)
+            handle_ctl_message (self, message);
+        else
+            reply_protocol_error (self, message, QMI_PROTOCOL_ERROR_INVALID_QMI_COMMAND);
+        return TRUE;
+    }
+
+    response = build_message_from_template (simulated->response,
+                                            qmi_message_get_client_id (message),
+                                            error);
+    if (!response) {
+        g_prefix_error (error, "Invalid simulated response: ");
+        return FALSE;
+    }
+    qmi_message_set_transaction_id (response, qmi_message_get_transaction_id (message));
+
+    schedule_reply (self, response, simulated->latency_ms);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+static void
+internal_close (QmiEndpointSimulated *self)
+{
+    cancel_pending_replies (self);
+    g_clear_pointer (&self->priv->indication_sources, g_ptr_array_unref);
+    g_clear_pointer (&self->priv->clients, g_hash_table_unref);
+    g_clear_pointer (&self->priv->last_cids, g_hash_table_unref);
+    g_clear_pointer (&self->priv->context, g_main_context_unref);
+    self->priv->endpoint_open = FALSE;
+}
+
+static gboolean
+endpoint_close_finish (QmiEndpoint   *self,
+                       GAsyncResult  *res,
+                       GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+endpoint_close (QmiEndpoint         *endpoint,
+                guint                timeout,
+                GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             user_data)
+{
+    QmiEndpointSimulated *self = QMI_ENDPOINT_SIMULATED (endpoint);
+    GTask                *task;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    internal_close (self);
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+/*****************************************************************************/
+
+QmiEndpointSimulated *
+qmi_endpoint_simulated_new (QmiFile    *file,
+                            GHashTable *responses,
+                            GPtrArray  *indications)
+{
+    QmiEndpointSimulated *self;
+
+    g_assert (responses && indications);
+
+    self = g_object_new (QMI_TYPE_ENDPOINT_SIMULATED,
+                         QMI_ENDPOINT_FILE, file,
+                         NULL);
+
+    self->priv->responses = g_hash_table_ref (responses);
+    self->priv->indications = g_ptr_array_ref (indications);
+    return self;
+}
+
+/*****************************************************************************/
+
+static void
+qmi_endpoint_simulated_init (QmiEndpointSimulated *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
+                                              QMI_TYPE_ENDPOINT_SIMULATED,
+                                              QmiEndpointSimulatedPrivate);
+    g_queue_init (&self->priv->pending_replies);
+}
+
+static void
+dispose (GObject *object)
+{
+    QmiEndpointSimulated *self = QMI_ENDPOINT_SIMULATED (object);
+
+    internal_close (self);
+
+    g_clear_pointer (&self->priv->responses, g_hash_table_unref);
+    g_clear_pointer (&self->priv->indications, g_ptr_array_unref);
+
+    G_OBJECT_CLASS (qmi_endpoint_simulated_parent_class)->dispose (object);
+}
+
+static void
+qmi_endpoint_simulated_class_init (QmiEndpointSimulatedClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    QmiEndpointClass *endpoint_class = QMI_ENDPOINT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (QmiEndpointSimulatedPrivate));
+
+    object_class->dispose = dispose;
+
+    endpoint_class->open = endpoint_open;
+    endpoint_class->open_finish = endpoint_open_finish;
+    endpoint_class->is_open = endpoint_is_open;
+    endpoint_class->send = endpoint_send;
+    endpoint_class->close = endpoint_close;
+    endpoint_class->close_finish = endpoint_close_finish;
+}
@@ -0,0 +1,92 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * libqmi-glib -- GLib/GIO based library to control QMI devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LIBQMI_GLIB_QMI_ENDPOINT_SIMULATED_H_
+#define _LIBQMI_GLIB_QMI_ENDPOINT_SIMULATED_H_
+
+#include "qmi-endpoint.h"
+
+/*
+ * Response sent back by the simulated modem to every request with the same
+ * service and message id, after @latency_ms milliseconds. The client id and
+ * transaction id of the request are always used in the response.
+ */
+typedef struct {
+    QmiMessage *response;
+    guint       latency_ms;
+} QmiSimulatedResponse;
+
+/*
+ * Indication emitted by the simulated modem every @interval_ms milliseconds
+ * while the endpoint is open.
+ */
+typedef struct {
+    QmiMessage *indication;
+    guint       interval_ms;
+} QmiSimulatedIndication;
+
+QmiSimulatedResponse   *qmi_simulated_response_new    (QmiMessage             *response,
+                                                       guint                   latency_ms);
+void                    qmi_simulated_response_free   (QmiSimulatedResponse   *self);
+gpointer                qmi_simulated_response_key    (QmiService              service,
+                                                       guint16                 message_id);
+
+QmiSimulatedIndication *qmi_simulated_indication_new  (QmiMessage             *indication,
+                                                       guint                   interval_ms);
+void                    qmi_simulated_indication_free (QmiSimulatedIndication *self);
+
+#define QMI_TYPE_ENDPOINT_SIMULATED            (qmi_endpoint_simulated_get_type ())
+#define QMI_ENDPOINT_SIMULATED(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_ENDPOINT_SIMULATED, QmiEndpointSimulated))
+#define QMI_ENDPOINT_SIMULATED_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_ENDPOINT_SIMULATED, QmiEndpointSimulatedClass))
+#define QMI_IS_ENDPOINT_SIMULATED(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), QMI_TYPE_ENDPOINT_SIMULATED))
+#define QMI_IS_ENDPOINT_SIMULATED_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  QMI_TYPE_ENDPOINT_SIMULATED))
+#define QMI_ENDPOINT_SIMULATED_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  QMI_TYPE_ENDPOINT_SIMULATED, QmiEndpointSimulatedClass))
+
+typedef struct _QmiEndpointSimulated QmiEndpointSimulated;
+typedef struct _QmiEndpointSimulatedClass QmiEndpointSimulatedClass;
+typedef struct _QmiEndpointSimulatedPrivate QmiEndpointSimulatedPrivate;
+
+struct _QmiEndpointSimulated {
+    /*< private >*/
+    QmiEndpoint parent;
+    QmiEndpointSimulatedPrivate *priv;
+};
+
+struct _QmiEndpointSimulatedClass {
+    /*< private >*/
+    QmiEndpointClass parent;
+};
+
+GType qmi_endpoint_simulated_get_type (void);
+
+/*
+ * The endpoint takes a reference to both the HT of
+ * qmi_simulated_response_key() -> QmiSimulatedResponse and the array of
+ * QmiSimulatedIndication, so that the owner may keep on updating them.
+ */
+QmiEndpointSimulated *qmi_endpoint_simulated_new (QmiFile    *file,
+                                                  GHashTable *responses,
+                                                  GPtrArray  *indications);
+
+/* Starts emitting an indication added after the endpoint was open */
+void qmi_endpoint_simulated_start_indication (QmiEndpointSimulated   *self,
+                                              QmiSimulatedIndication *indication);
+
+#endif /* _LIBQMI_GLIB_QMI_ENDPOINT_SIMULATED_H_ */
@@ -22,6 +22,8 @@
  * Copyright (C) 2019 Eric Caruso <ejcaruso@chromium.org>
  */
 
+#include <string.h>
+
 #include "qmi-endpoint.h"
 
 #include "qmi-helpers.h"
@@ -31,7 +33,16 @@
 G_DEFINE_TYPE (QmiEndpoint, qmi_endpoint, G_TYPE_OBJECT)
 
 struct _QmiEndpointPrivate {
+    /* Receive buffer, messages are consumed in place starting at
+     * buffer_offset, and the pending bytes are only moved to the beginning
+     * of the buffer once all complete messages have been processed */
     GByteArray *buffer;
+    guint       buffer_offset;
+    /* Largest amount of data the current buffer storage ever held, not
+     * including the space reserved but not committed */
+    guint       buffer_max_len;
+    /* Bytes reserved at the end of the buffer, not yet committed */
+    guint       buffer_reserved;
     QmiFile *file;
 };
 
@@ -43,6 +54,8 @@ enum {
 
 enum {
     SIGNAL_NEW_DATA,
+    SIGNAL_NEW_MESSAGE,
+    SIGNAL_SEND_FAILED,
     SIGNAL_HANGUP,
     SIGNAL_LAST
 };
@@ -52,75 +65,246 @@ static guint signals[SIGNAL_LAST] = { 0 };
 
 /*****************************************************************************/
 
+/* The storage may be much larger than the data if it was reserved for reading
+ * directly into it; shrinking it (usually in place) avoids keeping all that
+ * alive with the messages built from the buffer */
+static GByteArray *
+buffer_trim (GByteArray *buffer)
+{
+    guint8 *data;
+    guint   len;
+
+    len = buffer->len;
+    data = g_byte_array_free (buffer, FALSE);
+    return g_byte_array_new_take (g_realloc (data, len), len);
+}
+
+static void
+buffer_compact (QmiEndpoint *self)
+{
+    guint pending;
+
+    if (!self->priv->buffer_offset)
+        return;
+
+    pending = self->priv->buffer->len - self->priv->buffer_offset;
+
+    /* Fully consumed; drop the storage altogether if a previous burst made it
+     * grow too much, otherwise just reuse it */
+    if (!pending) {
+        if (self->priv->buffer_max_len > QMI_ENDPOINT_BUFFER_MAX_RETAINED_SIZE) {
+            g_byte_array_unref (self->priv->buffer);
+            self->priv->buffer = g_byte_array_new ();
+            self->priv->buffer_max_len = 0;
+        } else
+            g_byte_array_set_size (self->priv->buffer, 0);
+        self->priv->buffer_offset = 0;
+        return;
+    }
+
+    /* Only the trailing partial message is moved */
+    memmove (self->priv->buffer->data,
+             &self->priv->buffer->data[self->priv->buffer_offset],
+             pending);
+    g_byte_array_set_size (self->priv->buffer, pending);
+    self->priv->buffer_offset = 0;
+}
+
+static void
+report_invalid_message (const gchar  *name,
+                        const guint8 *raw,
+                        guint         raw_len,
+                        GError       *error)
+{
+    /* Warn about the issue */
+    g_warning ("[%s] invalid message received: '%s'", name, error->message);
+
+    if (qmi_utils_get_traces_enabled ()) {
+        gchar *printable;
+
+        printable = qmi_helpers_str_hex (raw, MIN (raw_len, 2048), ':');
+        g_debug ("<<<<<< RAW INVALID MESSAGE:\n"
+                 "<<<<<<   length = %u\n"
+                 "<<<<<<   data   = %s\n",
+                 raw_len, /* show full buffer len */
+                 printable);
+        g_free (printable);
+    }
+}
+
 gboolean
-qmi_endpoint_parse_buffer (QmiEndpoint        *self,
-                           QmiMessageHandler   handler,
-                           gpointer            user_data,
-                           GError            **error)
+qmi_endpoint_parse_messages (const gchar        *name,
+                             GByteArray        **buffer,
+                             guint              *offset,
+                             QmiMessageHandler   handler,
+                             gpointer            user_data,
+                             GError            **error)
 {
-    do {
-        GError *inner_error = NULL;
-        QmiMessage *message;
+    while (*offset < (*buffer)->len) {
+        GError       *inner_error = NULL;
+        QmiMessage   *message;
+        const guint8 *pending;
+        guint         pending_len;
+        gsize         frame_len;
+
+        pending = &(*buffer)->data[*offset];
+        pending_len = (*buffer)->len - *offset;
 
         /* Every message received must start with the QMUX or QRTR marker.
-         * If it doesn't, we broke framing :-/
-         * If we broke framing, an error should be reported and the device
-         * should get closed */
-        if (self->priv->buffer->len > 0 &&
-            self->priv->buffer->data[0] != QMI_MESSAGE_QMUX_MARKER &&
-            self->priv->buffer->data[0] != QMI_MESSAGE_QRTR_MARKER) {
+         * If it doesn't, we broke framing :-/ */
+        if (pending[0] != QMI_MESSAGE_QMUX_MARKER &&
+            pending[0] != QMI_MESSAGE_QRTR_MARKER) {
             g_set_error (error,
                          QMI_PROTOCOL_ERROR,
                          QMI_PROTOCOL_ERROR_MALFORMED_MESSAGE,
                          "QMI framing error detected");
-            g_signal_emit (self, signals[SIGNAL_HANGUP], 0);
             return FALSE;
         }
 
-        message = qmi_message_new_from_raw (self->priv->buffer, &inner_error);
-        if (!message) {
-            if (!inner_error)
-                /* More data we need */
-                return TRUE;
-
-            /* Warn about the issue */
-            g_warning ("[%s] invalid message received: '%s'",
-                       qmi_file_get_path_display (self->priv->file),
-                       inner_error->message);
-            g_error_free (inner_error);
-
-            if (qmi_utils_get_traces_enabled ()) {
-                gchar *printable;
-                guint len = MIN (self->priv->buffer->len, 2048);
-
-                printable = qmi_helpers_str_hex (self->priv->buffer->data, len, ':');
-                g_debug ("<<<<<< RAW INVALID MESSAGE:\n"
-                         "<<<<<<   length = %u\n"
-                         "<<<<<<   data   = %s\n",
-                         self->priv->buffer->len, /* show full buffer len */
-                         printable);
-                g_free (printable);
+        frame_len = __qmi_message_get_raw_frame_length (pending, pending_len);
+        if (!frame_len || frame_len > pending_len)
+            /* More data we need */
+            break;
+
+        if (!*offset && frame_len == pending_len) {
+            GByteArray *raw;
+
+            /* The receive buffer holds exactly one complete message, which is
+             * the most common case, so hand over the whole buffer as message
+             * instead of copying it. The new receive buffer is not
+             * preallocated, so that its size follows what is read next. */
+            raw = buffer_trim (g_steal_pointer (buffer));
+            *buffer = g_byte_array_new ();
+
+            message = __qmi_message_new_from_raw_take (raw, &inner_error);
+            if (!message) {
+                report_invalid_message (name, raw->data, raw->len, inner_error);
+                g_error_free (inner_error);
+                g_byte_array_unref (raw);
             }
-
         } else {
+            gsize consumed = 0;
+
+            message = __qmi_message_new_from_raw_buffer (pending, pending_len, &consumed, &inner_error);
+            g_assert (consumed == frame_len);
+
+            /* Whatever we got, it is consumed now */
+            *offset += consumed;
+
+            if (!message) {
+                report_invalid_message (name, pending, pending_len, inner_error);
+                g_error_free (inner_error);
+            }
+        }
+
+        if (message) {
             /* Play with the received message */
             handler (message, user_data);
             qmi_message_unref (message);
         }
-    } while (self->priv->buffer->len > 0);
+    }
 
     return TRUE;
 }
 
+gboolean
+qmi_endpoint_parse_buffer (QmiEndpoint        *self,
+                           QmiMessageHandler   handler,
+                           gpointer            user_data,
+                           GError            **error)
+{
+    GByteArray *buffer;
+    gboolean    parsed;
+
+    buffer = self->priv->buffer;
+    parsed = qmi_endpoint_parse_messages (qmi_file_get_path_display (self->priv->file),
+                                          &self->priv->buffer,
+                                          &self->priv->buffer_offset,
+                                          handler,
+                                          user_data,
+                                          error);
+
+    /* The whole storage was handed over with a message */
+    if (self->priv->buffer != buffer)
+        self->priv->buffer_max_len = self->priv->buffer->len;
+
+    /* If we broke framing, the device should get closed */
+    if (!parsed) {
+        g_signal_emit (self, signals[SIGNAL_HANGUP], 0);
+        return FALSE;
+    }
+
+    buffer_compact (self);
+    return TRUE;
+}
+
 void
 qmi_endpoint_add_message (QmiEndpoint  *self,
                           const guint8 *data,
                           guint         len)
 {
-    self->priv->buffer = g_byte_array_append (self->priv->buffer, data, len);
+    g_assert (!self->priv->buffer_reserved);
+
+    g_byte_array_append (self->priv->buffer, data, len);
+    self->priv->buffer_max_len = MAX (self->priv->buffer_max_len, self->priv->buffer->len);
+    g_signal_emit (self, signals[SIGNAL_NEW_DATA], 0);
+}
+
+guint8 *
+qmi_endpoint_reserve_buffer (QmiEndpoint *self,
+                             guint        len)
+{
+    guint current_len;
+
+    g_assert (!self->priv->buffer_reserved);
+
+    current_len = self->priv->buffer->len;
+    g_byte_array_set_size (self->priv->buffer, current_len + len);
+    self->priv->buffer_reserved = len;
+    return &self->priv->buffer->data[current_len];
+}
+
+void
+qmi_endpoint_commit_buffer (QmiEndpoint *self,
+                            guint        len)
+{
+    g_assert (len <= self->priv->buffer_reserved);
+
+    g_byte_array_set_size (self->priv->buffer,
+                           self->priv->buffer->len - (self->priv->buffer_reserved - len));
+    self->priv->buffer_max_len = MAX (self->priv->buffer_max_len, self->priv->buffer->len);
+    self->priv->buffer_reserved = 0;
+}
+
+void
+qmi_endpoint_notify_new_data (QmiEndpoint *self)
+{
     g_signal_emit (self, signals[SIGNAL_NEW_DATA], 0);
 }
 
+void
+qmi_endpoint_add_parsed_message (QmiEndpoint *self,
+                                 QmiMessage  *message)
+{
+    /* Messages must be reported in the same order as they were received, so
+     * if there is still something in the buffer, queue this one after it */
+    if (self->priv->buffer_offset < self->priv->buffer->len) {
+        g_autoptr(GError)  error = NULL;
+        const guint8      *raw;
+        gsize              raw_len;
+
+        raw = qmi_message_get_raw (message, &raw_len, &error);
+        if (!raw)
+            g_warning ("[%s] cannot queue message: %s",
+                       qmi_file_get_path_display (self->priv->file), error->message);
+        else
+            qmi_endpoint_add_message (self, raw, raw_len);
+        return;
+    }
+
+    g_signal_emit (self, signals[SIGNAL_NEW_MESSAGE], 0, message);
+}
+
 /*****************************************************************************/
 
 static gboolean
@@ -346,6 +530,31 @@ qmi_endpoint_class_init (QmiEndpointClass *klass)
                       G_TYPE_NONE,
                       0);
 
+    signals[SIGNAL_NEW_MESSAGE] =
+        g_signal_new (QMI_ENDPOINT_SIGNAL_NEW_MESSAGE,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      1,
+                      G_TYPE_POINTER);
+
+    signals[SIGNAL_SEND_FAILED] =
+        g_signal_new (QMI_ENDPOINT_SIGNAL_SEND_FAILED,
+                      G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      NULL,
+                      G_TYPE_NONE,
+                      2,
+                      G_TYPE_POINTER,
+                      G_TYPE_POINTER);
+
     signals[SIGNAL_HANGUP] =
         g_signal_new (QMI_ENDPOINT_SIGNAL_HANGUP,
                       G_OBJECT_CLASS_TYPE (G_OBJECT_CLASS (klass)),
@@ -40,6 +40,11 @@
 typedef void (*QmiMessageHandler) (QmiMessage *message,
                                    gpointer user_data);
 
+/* If a burst of data makes the receive buffer grow beyond this size, it will
+ * be reallocated once it gets fully consumed; reads into the buffer should
+ * never be larger than this */
+#define QMI_ENDPOINT_BUFFER_MAX_RETAINED_SIZE 65536
+
 #define QMI_TYPE_ENDPOINT            (qmi_endpoint_get_type ())
 #define QMI_ENDPOINT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), QMI_TYPE_ENDPOINT, QmiEndpoint))
 #define QMI_ENDPOINT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  QMI_TYPE_ENDPOINT, QmiEndpointClass))
@@ -52,8 +57,10 @@ typedef struct _QmiEndpointClass QmiEndpointClass;
 typedef struct _QmiEndpointPrivate QmiEndpointPrivate;
 
 #define QMI_ENDPOINT_FILE            "endpoint-file"
-#define QMI_ENDPOINT_SIGNAL_NEW_DATA "new-data"
-#define QMI_ENDPOINT_SIGNAL_HANGUP   "hangup"
+#define QMI_ENDPOINT_SIGNAL_NEW_DATA    "new-data"
+#define QMI_ENDPOINT_SIGNAL_NEW_MESSAGE "new-message"
+#define QMI_ENDPOINT_SIGNAL_SEND_FAILED "send-failed"
+#define QMI_ENDPOINT_SIGNAL_HANGUP      "hangup"
 
 struct _QmiEndpoint {
     /*< private >*/
@@ -87,6 +94,8 @@ struct _QmiEndpointClass {
                                            GAsyncResult  *res,
                                            GError       **error);
 
+    /* Endpoints that write asynchronously may accept the message and fail
+     * sending it later, which is reported with the send-failed signal */
     gboolean (* send) (QmiEndpoint   *self,
                        QmiMessage    *message,
                        guint          timeout,
@@ -144,6 +153,27 @@ gboolean qmi_endpoint_close_finish (QmiEndpoint   *self,
                                     GAsyncResult  *res,
                                     GError       **error);
 
+/*
+ * Parse all complete messages in @buffer starting at @offset, calling
+ * @handler on each one while also passing along @user_data, and leaving
+ * @offset right after the last one. Invalid messages are reported, using
+ * @name in the warnings, and skipped. When @buffer holds exactly one message,
+ * the whole storage is handed over to it and @buffer is replaced by a new
+ * empty one.
+ *
+ * If it hits a framing issue, returns false and sets @error, leaving @offset
+ * at the start of the unframed data. Otherwise, returns true.
+ *
+ * This function doesn't need the endpoint, so it may be used from any thread
+ * owning @buffer.
+ */
+gboolean qmi_endpoint_parse_messages (const gchar        *name,
+                                      GByteArray        **buffer,
+                                      guint              *offset,
+                                      QmiMessageHandler   handler,
+                                      gpointer            user_data,
+                                      GError            **error);
+
 /*
  * Parse all messages, calling @handler on each one while also passing
  * along @user_data.
@@ -166,4 +196,31 @@ void qmi_endpoint_add_message (QmiEndpoint *self,
                                const guint8 *buf,
                                guint len);
 
+/*
+ * Reserves @len bytes at the end of the buffer, so that subclasses can read
+ * from the underlying transport directly into it. Every reservation must be
+ * followed by qmi_endpoint_commit_buffer(), giving the amount of bytes that
+ * were actually written, before any other operation on the buffer.
+ */
+guint8 *qmi_endpoint_reserve_buffer (QmiEndpoint *self,
+                                     guint        len);
+void    qmi_endpoint_commit_buffer  (QmiEndpoint *self,
+                                     guint        len);
+
+/*
+ * Notifies that new data was committed to the buffer, and so that it should
+ * be parsed.
+ */
+void qmi_endpoint_notify_new_data (QmiEndpoint *self);
+
+/*
+ * Reports the already built @message right away, without going through the
+ * buffer, unless there is data pending to be parsed in it.
+ *
+ * This function should only be called by subclasses that receive complete
+ * messages from the underlying transport.
+ */
+void qmi_endpoint_add_parsed_message (QmiEndpoint *self,
+                                      QmiMessage  *message);
+
 #endif /* _LIBQMI_GLIB_QMI_ENDPOINT_H_ */
@@ -345,6 +345,115 @@ qmi_tlv_next (QmiMessage *self,
     return (next < end ? next : NULL);
 }
 
+/*****************************************************************************/
+/* TLV index
+ *
+ * QmiMessage is a plain GByteArray, so there is no room to store the TLV
+ * offsets within the message itself. Instead, each thread keeps the index of
+ * the last message validated or read, mapping each TLV type to the offset of
+ * its first occurrence, so that reading all fields of a message doesn't
+ * require walking the whole TLV list once per field.
+ *
+ * The index doesn't keep a reference to the message, so the global generation
+ * counter is bumped whenever a message is modified or unreferenced, as either
+ * may happen in a different thread, and a released message may have its
+ * memory reused by a new one; validating or reading messages never touches it.
+ */
+
+typedef struct {
+    gconstpointer  message;
+    gconstpointer  data;
+    guint          len;
+    gint           generation;
+    guint16        offsets[G_MAXUINT8 + 1];
+} TlvIndex;
+
+static gint     tlv_index_generation;
+static GPrivate tlv_index_private = G_PRIVATE_INIT (g_free);
+
+static TlvIndex *
+tlv_index_peek (void)
+{
+    TlvIndex *tlv_index;
+
+    tlv_index = g_private_get (&tlv_index_private);
+    if (!tlv_index) {
+        tlv_index = g_new0 (TlvIndex, 1);
+        g_private_set (&tlv_index_private, tlv_index);
+    }
+    return tlv_index;
+}
+
+static inline void
+tlv_index_invalidate (void)
+{
+    g_atomic_int_inc (&tlv_index_generation);
+}
+
+static inline gboolean
+tlv_index_is_valid (TlvIndex   *tlv_index,
+                    QmiMessage *self)
+{
+    return (tlv_index->message == (gconstpointer)self &&
+            tlv_index->data == (gconstpointer)self->data &&
+            tlv_index->len == self->len &&
+            tlv_index->generation == g_atomic_int_get (&tlv_index_generation));
+}
+
+static inline void
+tlv_index_reset (TlvIndex *tlv_index)
+{
+    tlv_index->message = NULL;
+    memset (tlv_index->offsets, 0, sizeof (tlv_index->offsets));
+}
+
+static inline void
+tlv_index_add (TlvIndex   *tlv_index,
+               QmiMessage *self,
+               struct tlv *tlv)
+{
+    /* Only the first TLV of a given type is indexed, as the lookup by type
+     * always reported the first one found. Offset 0 is never a valid TLV
+     * offset, so it is used to flag missing TLVs. */
+    if (!tlv_index->offsets[tlv->type])
+        tlv_index->offsets[tlv->type] = (guint16)(((guint8 *)tlv) - self->data);
+}
+
+static inline void
+tlv_index_complete (TlvIndex   *tlv_index,
+                    QmiMessage *self,
+                    gint        generation)
+{
+    tlv_index->message = self;
+    tlv_index->data = self->data;
+    tlv_index->len = self->len;
+    tlv_index->generation = generation;
+}
+
+static struct tlv *
+tlv_index_lookup (QmiMessage *self,
+                  guint8      type)
+{
+    TlvIndex *tlv_index;
+
+    tlv_index = tlv_index_peek ();
+    if (!tlv_index_is_valid (tlv_index, self)) {
+        struct tlv *tlv;
+        gint        generation;
+
+        generation = g_atomic_int_get (&tlv_index_generation);
+        tlv_index_reset (tlv_index);
+        for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv))
+            tlv_index_add (tlv_index, self, tlv);
+        tlv_index_complete (tlv_index, self, generation);
+    }
+
+    if (!tlv_index->offsets[type])
+        return NULL;
+
+    return (struct tlv *)(&self->data[tlv_index->offsets[type]]);
+}
+
 /*
  * Checks the validity of a QMI message.
  *
@@ -364,6 +473,11 @@ message_check (QmiMessage  *self,
     gsize       message_length;
     guint8     *end;
     struct tlv *tlv;
+    TlvIndex   *tlv_index;
+    gint        generation;
+
+    /* Modifications always invalidate the index themselves */
+    generation = g_atomic_int_get (&tlv_index_generation);
 
     if (self->len < (1 + sizeof (struct qmux_header))) {
         g_set_error (error,
@@ -419,6 +533,10 @@ message_check (QmiMessage  *self,
         return FALSE;
     }
 
+    /* Build the TLV index while validating */
+    tlv_index = tlv_index_peek ();
+    tlv_index_reset (tlv_index);
+
     end = qmi_end (self);
     for (tlv = qmi_tlv (self); tlv < (struct tlv *)end; tlv = tlv_next (tlv)) {
         if (tlv->value > end) {
@@ -437,6 +555,7 @@ message_check (QmiMessage  *self,
                          tlv->value, GUINT16_FROM_LE (tlv->length), end);
             return FALSE;
         }
+        tlv_index_add (tlv_index, self, tlv);
     }
 
     /*
@@ -445,6 +564,7 @@ message_check (QmiMessage  *self,
      */
     g_assert (tlv == (struct tlv *)end);
 
+    tlv_index_complete (tlv_index, self, generation);
     return TRUE;
 }
 
@@ -503,6 +623,7 @@ qmi_message_new (QmiService service,
     /* Update length fields. */
     set_message_length (self, buffer_len - 1); /* marker not included in length */
     set_all_tlvs_length (self, 0);
+    tlv_index_invalidate ();
 
     /* We shouldn't create invalid empty messages */
     g_assert (message_check (self, NULL));
@@ -615,6 +736,8 @@ qmi_message_unref (QmiMessage *self)
 {
     g_return_if_fail (self != NULL);
 
+    /* The memory may be reused by a different message once released */
+    tlv_index_invalidate ();
     g_byte_array_unref (self);
 }
 
@@ -654,6 +777,17 @@ qmi_message_get_data (QmiMessage *self,
     return (guint8 *)(&((struct full_message *)(self->data))->qmi);
 }
 
+const guint8 *
+__qmi_message_get_tlvs (QmiMessage *self,
+                        gsize      *length)
+{
+    g_assert (self != NULL);
+    g_assert (length != NULL);
+
+    *length = get_all_tlvs_length (self);
+    return (const guint8 *) qmi_tlv (self);
+}
+
 /*****************************************************************************/
 /* TLV builder & writer */
 
@@ -717,6 +851,7 @@ qmi_message_tlv_write_reset (QmiMessage *self,
     g_return_if_fail (self != NULL);
 
     g_byte_array_set_size (self, tlv_offset);
+    tlv_index_invalidate ();
 }
 
 gboolean
@@ -739,6 +874,7 @@ qmi_message_tlv_write_complete (QmiMessage  *self,
     tlv->length = GUINT16_TO_LE (tlv_length - sizeof (struct tlv));
     set_message_length (self, (guint16)(get_message_length (self) + tlv_length));
     set_all_tlvs_length (self, (guint16)(get_all_tlvs_length (self) + tlv_length));
+    tlv_index_invalidate ();
 
     /* Make sure we didn't break anything. */
     g_assert (message_check (self, NULL));
@@ -1000,11 +1136,7 @@ qmi_message_tlv_read_init (QmiMessage  *self,
     g_return_val_if_fail (self != NULL, 0);
     g_return_val_if_fail (self->len > 0, 0);
 
-    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        if (tlv->type == type)
-            break;
-    }
-
+    tlv = tlv_index_lookup (self, type);
     if (!tlv) {
         g_set_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND,
                      "TLV 0x%02X not found", type);
@@ -1025,6 +1157,32 @@ qmi_message_tlv_read_init (QmiMessage  *self,
     return (((guint8 *)tlv) - self->data);
 }
 
+gsize
+__qmi_message_tlv_read_next (QmiMessage *self,
+                             gsize       tlv_offset,
+                             guint8     *out_tlv_type)
+{
+    struct tlv *tlv;
+
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (self->len > 0, 0);
+    g_return_val_if_fail (out_tlv_type != NULL, 0);
+
+    if (!tlv_offset)
+        tlv = qmi_tlv_first (self);
+    else
+        tlv = qmi_tlv_next (self, (struct tlv *) &(self->data[tlv_offset]));
+
+    /* A truncated TLV ends the iteration, as there is nothing valid to read */
+    if (!tlv ||
+        ((guint8 *) tlv + sizeof (struct tlv)) > qmi_end (self) ||
+        ((guint8 *) tlv_next (tlv)) > qmi_end (self))
+        return 0;
+
+    *out_tlv_type = tlv->type;
+    return (((guint8 *)tlv) - self->data);
+}
+
 static const guint8 *
 tlv_error_if_read_overflow (QmiMessage  *self,
                             gsize        tlv_offset,
@@ -1495,14 +1653,12 @@ qmi_message_get_raw_tlv (QmiMessage *self,
     g_return_val_if_fail (self != NULL, NULL);
     g_return_val_if_fail (length != NULL, NULL);
 
-    for (tlv = qmi_tlv_first (self); tlv; tlv = qmi_tlv_next (self, tlv)) {
-        if (tlv->type == type) {
-            *length = GUINT16_FROM_LE (tlv->length);
-            return (guint8 *)&(tlv->value[0]);
-        }
-    }
+    tlv = tlv_index_lookup (self, type);
+    if (!tlv)
+        return NULL;
 
-    return NULL;
+    *length = GUINT16_FROM_LE (tlv->length);
+    return (guint8 *)&(tlv->value[0]);
 }
 
 void
@@ -1561,6 +1717,7 @@ qmi_message_add_raw_tlv (QmiMessage *self,
     /* Update length fields. */
     set_message_length (self, (guint16)(get_message_length (self) + tlv_len));
     set_all_tlvs_length (self, (guint16)(get_all_tlvs_length (self) + tlv_len));
+    tlv_index_invalidate ();
 
     /* Make sure we didn't break anything. */
     g_assert (message_check (self, NULL));
@@ -1568,36 +1725,49 @@ qmi_message_add_raw_tlv (QmiMessage *self,
     return TRUE;
 }
 
-QmiMessage *
-qmi_message_new_from_raw (GByteArray *raw,
-                          GError **error)
+gsize
+__qmi_message_get_raw_frame_length (const guint8 *raw,
+                                    gsize         raw_len)
 {
-    GByteArray *self;
-    gsize message_len;
-
-    g_return_val_if_fail (raw != NULL, NULL);
-
-    if (MESSAGE_IS_QMUX (raw))
-        message_len = GUINT16_FROM_LE (((struct full_message *)raw->data)->header.qmux.length);
-    else
-        message_len = GUINT16_FROM_LE (((struct full_message *)raw->data)->header.qrtr.length);
+    const struct full_message *buffer;
 
     /* If we didn't even read the QMUX header (comes after the 1-byte marker),
      * leave */
-    if (raw->len < (sizeof (struct qrtr_header) + 1))
-        return NULL;
+    if (raw_len < (sizeof (struct qrtr_header) + 1))
+        return 0;
 
-    /* We need to have read the length reported by the QMUX header (plus the
-     * initial 1-byte marker) */
-    if (raw->len < (message_len + 1))
+    /* The length reported by the QMUX header doesn't include the initial
+     * 1-byte marker */
+    buffer = (const struct full_message *)raw;
+    if (buffer->marker == QMI_MESSAGE_QMUX_MARKER)
+        return GUINT16_FROM_LE (buffer->header.qmux.length) + 1;
+    return GUINT16_FROM_LE (buffer->header.qrtr.length) + 1;
+}
+
+QmiMessage *
+__qmi_message_new_from_raw_buffer (const guint8  *raw,
+                                   gsize          raw_len,
+                                   gsize         *consumed,
+                                   GError       **error)
+{
+    GByteArray *self;
+    gsize       frame_len;
+
+    g_assert (consumed);
+    *consumed = 0;
+
+    /* We need to have read the length reported by the QMUX header */
+    frame_len = __qmi_message_get_raw_frame_length (raw, raw_len);
+    if (!frame_len || raw_len < frame_len)
         return NULL;
 
     /* Ok, so we should have all the data available already */
-    self = g_byte_array_sized_new (message_len + 1);
-    g_byte_array_prepend (self, raw->data, message_len + 1);
+    self = g_byte_array_sized_new (frame_len);
+    g_byte_array_append (self, raw, frame_len);
 
-    /* We got a complete QMI message, remove from input buffer */
-    g_byte_array_remove_range (raw, 0, self->len);
+    /* We got a complete QMI message, report it as consumed even if it
+     * ends up being invalid */
+    *consumed = frame_len;
 
     /* Check input message validity as soon as we create the QmiMessage */
     if (!message_check (self, error)) {
@@ -1609,6 +1779,37 @@ qmi_message_new_from_raw (GByteArray *raw,
     return (QmiMessage *)self;
 }
 
+QmiMessage *
+__qmi_message_new_from_raw_take (GByteArray  *raw,
+                                 GError     **error)
+{
+    g_assert (__qmi_message_get_raw_frame_length (raw->data, raw->len) == raw->len);
+
+    /* The array itself becomes the message, no need to copy anything */
+    if (!message_check (raw, error))
+        return NULL;
+
+    return (QmiMessage *)raw;
+}
+
+QmiMessage *
+qmi_message_new_from_raw (GByteArray *raw,
+                          GError **error)
+{
+    QmiMessage *self;
+    gsize       consumed = 0;
+
+    g_return_val_if_fail (raw != NULL, NULL);
+
+    self = __qmi_message_new_from_raw_buffer (raw->data, raw->len, &consumed, error);
+
+    /* We got a complete QMI message, remove from input buffer */
+    if (consumed)
+        g_byte_array_remove_range (raw, 0, consumed);
+
+    return self;
+}
+
 gchar *
 qmi_message_get_tlv_printable (QmiMessage *self,
                                const gchar *line_prefix,
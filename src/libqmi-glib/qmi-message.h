@@ -124,6 +124,38 @@ QmiMessage *qmi_message_new (QmiService service,
 QmiMessage *qmi_message_new_from_raw (GByteArray  *raw,
                                       GError     **error);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+/*
+ * Gets the full length of the message starting at @raw, as reported in its
+ * QMUX header, including the initial marker; or 0 if the header itself isn't
+ * complete yet.
+ */
+G_GNUC_INTERNAL
+gsize __qmi_message_get_raw_frame_length (const guint8 *raw,
+                                          gsize         raw_len);
+
+/*
+ * Same as qmi_message_new_from_raw(), but the complete message is read from
+ * the beginning of the @raw buffer, which is left untouched. The number of
+ * bytes that the caller should consider processed is returned in @consumed,
+ * both for valid and invalid messages; 0 if there is not enough data yet.
+ */
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_new_from_raw_buffer (const guint8  *raw,
+                                               gsize          raw_len,
+                                               gsize         *consumed,
+                                               GError       **error);
+
+/*
+ * Validates @raw, which must contain exactly one complete message, and
+ * returns it as a #QmiMessage without copying its contents. Ownership of
+ * @raw is transferred only if the message is valid.
+ */
+G_GNUC_INTERNAL
+QmiMessage *__qmi_message_new_from_raw_take (GByteArray  *raw,
+                                             GError     **error);
+#endif
+
 /**
  * qmi_message_new_from_data:
  * @service: a #QmiService
@@ -316,6 +348,16 @@ const guint8 *qmi_message_get_data (QmiMessage  *self,
                                     gsize       *length,
                                     GError     **error);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+/*
+ * Gets the buffer with all the TLVs of the message, i.e. the message
+ * without the QMUX and QMI headers.
+ */
+G_GNUC_INTERNAL
+const guint8 *__qmi_message_get_tlvs (QmiMessage *self,
+                                      gsize      *length);
+#endif
+
 /**
  * qmi_message_get_marker:
  * @self: a #QmiMessage.
@@ -605,6 +647,19 @@ gsize qmi_message_tlv_read_init (QmiMessage  *self,
                                  guint16     *out_tlv_length,
                                  GError     **error);
 
+#if defined (LIBQMI_GLIB_COMPILATION)
+/*
+ * Iterates over all the TLVs in the message, in the order they were given.
+ * Starting with a @tlv_offset of 0, returns the offset of the TLV following
+ * the one at @tlv_offset (usable as in qmi_message_tlv_read_init()), and its
+ * type in @out_tlv_type; or 0 if there are no more TLVs.
+ */
+G_GNUC_INTERNAL
+gsize __qmi_message_tlv_read_next (QmiMessage *self,
+                                   gsize       tlv_offset,
+                                   guint8     *out_tlv_type);
+#endif
+
 /**
  * qmi_message_tlv_read_guint8:
  * @self: a #QmiMessage.
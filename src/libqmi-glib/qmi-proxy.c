@@ -164,7 +164,7 @@ client_unref (Client *client)
         }
 
         g_clear_pointer (&client->buffer,                      g_byte_array_unref);
-        g_clear_pointer (&client->internal_proxy_open_request, g_byte_array_unref);
+        g_clear_pointer (&client->internal_proxy_open_request, qmi_message_unref);
         g_clear_pointer (&client->qmi_client_info_array,       g_array_unref);
 
         g_slice_free (Client, client);
@@ -84,7 +84,8 @@ device_virtual_new_ready (GObject      *source,
 }
 
 void
-test_fixture_setup (TestFixture *fixture)
+test_fixture_setup (TestFixture             *fixture,
+                    const TestFixtureConfig *config)
 {
     GFile *file;
     guint  i;
@@ -115,6 +116,9 @@ test_fixture_setup (TestFixture *fixture)
     g_object_unref (file);
     test_fixture_loop_run (fixture);
 
+    if (config && config->read_size)
+        g_object_set (fixture->device, QMI_DEVICE_READ_SIZE, config->read_size, NULL);
+
     /* Open device */
     {
         guint8 expected[] = {
@@ -161,7 +165,7 @@ test_fixture_setup (TestFixture *fixture)
                                        response, G_N_ELEMENTS (response),
                                        fixture->service_info[QMI_SERVICE_CTL].transaction_id++);
     }
-    qmi_device_open (fixture->device, QMI_DEVICE_OPEN_FLAGS_PROXY, 1, NULL,
+    qmi_device_open (fixture->device, QMI_DEVICE_OPEN_FLAGS_PROXY | (config ? config->open_flags : 0), 1, NULL,
                      (GAsyncReadyCallback) device_open_ready,
                      fixture);
     test_fixture_loop_run (fixture);
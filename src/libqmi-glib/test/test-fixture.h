@@ -37,7 +37,14 @@ typedef struct {
     TestServiceInfo  service_info[255];
 } TestFixture;
 
-void test_fixture_setup     (TestFixture *fixture);
+/* Optional settings of the device, given as test data */
+typedef struct {
+    QmiDeviceOpenFlags open_flags; /* on top of PROXY */
+    guint              read_size;  /* 0 for the default */
+} TestFixtureConfig;
+
+void test_fixture_setup     (TestFixture             *fixture,
+                             const TestFixtureConfig *config);
 void test_fixture_teardown  (TestFixture *fixture);
 void test_fixture_loop_run  (TestFixture *fixture);
 void test_fixture_loop_stop (TestFixture *fixture);
@@ -51,4 +58,12 @@ typedef void (*TCFunc) (TestFixture *, gconstpointer);
                 (TCFunc)method,                      \
                 (TCFunc)test_fixture_teardown)
 
+#define TEST_ADD_WITH_CONFIG(path,config,method)     \
+    g_test_add (path,                                \
+                TestFixture,                         \
+                config,                              \
+                (TCFunc)test_fixture_setup,          \
+                (TCFunc)method,                      \
+                (TCFunc)test_fixture_teardown)
+
 #endif /* TEST_FIXTURE_H */
@@ -26,6 +26,531 @@ test_generated_core (TestFixture *fixture)
     /* Noop */
 }
 
+/*****************************************************************************/
+/* Broadcast indications */
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS && defined HAVE_QMI_INDICATION_DMS_EVENT_REPORT
+
+typedef struct {
+    TestFixture *fixture;
+    GPtrArray   *clients;
+    guint        n_expected;
+    guint        n_reported;
+    gboolean     command_done;
+} BroadcastContext;
+
+static void
+broadcast_allocate_client_ready (QmiDevice        *device,
+                                 GAsyncResult     *res,
+                                 BroadcastContext *ctx)
+{
+    QmiClient *client;
+    GError *error = NULL;
+
+    client = qmi_device_allocate_client_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT (client));
+    g_ptr_array_add (ctx->clients, client);
+
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+broadcast_check_completed (BroadcastContext *ctx)
+{
+    if (ctx->command_done && ctx->n_reported == ctx->n_expected)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+static void
+broadcast_event_report (QmiClientDms                      *client,
+                        QmiIndicationDmsEventReportOutput *output,
+                        BroadcastContext                  *ctx)
+{
+    g_assert_cmpuint (qmi_client_get_service (QMI_CLIENT (client)), ==, QMI_SERVICE_DMS);
+    ctx->n_reported++;
+    g_assert_cmpuint (ctx->n_reported, <=, ctx->n_expected);
+    broadcast_check_completed (ctx);
+}
+
+static void
+broadcast_dms_get_ids_ready (QmiClientDms     *client,
+                             GAsyncResult     *res,
+                             BroadcastContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    ctx->command_done = TRUE;
+    broadcast_check_completed (ctx);
+}
+
+static void
+test_generated_core_broadcast_indications (TestFixture *fixture)
+{
+    static const QmiService broadcast_services[] = {
+        QMI_SERVICE_DMS,
+#if defined HAVE_QMI_SERVICE_NAS
+        QMI_SERVICE_NAS,
+#endif
+#if defined HAVE_QMI_SERVICE_WDS
+        QMI_SERVICE_WDS,
+#endif
+#if defined HAVE_QMI_SERVICE_PDS
+        QMI_SERVICE_PDS,
+#endif
+    };
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    const guint8 indication[] = {
+        0x01,
+        0x0C, 0x00, 0x80, 0x02, 0xFF, /* DMS, broadcast */
+        0x04, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00
+    };
+    BroadcastContext ctx = { 0 };
+    GByteArray *buffer;
+    guint n_clients_per_service;
+    guint n_indications;
+    guint n_dms_clients = 0;
+    guint i;
+    guint j;
+
+    /* Many clients of several services, only the ones of the indication
+     * service should ever be looked at when routing */
+    n_clients_per_service = g_test_perf () ? 60 : 15;
+    n_indications = g_test_perf () ? 5000 : 100;
+
+    /* Don't measure traces */
+    qmi_utils_set_traces_enabled (FALSE);
+
+    ctx.fixture = fixture;
+    ctx.clients = g_ptr_array_new_with_free_func (g_object_unref);
+
+    for (i = 0; i < G_N_ELEMENTS (broadcast_services); i++) {
+        for (j = 0; j < n_clients_per_service; j++) {
+            qmi_device_allocate_client (fixture->device, broadcast_services[i], 2 + j, 10, NULL,
+                                        (GAsyncReadyCallback) broadcast_allocate_client_ready,
+                                        &ctx);
+            test_fixture_loop_run (fixture);
+        }
+    }
+
+    /* Listen in all DMS clients, including the one from the fixture */
+    g_ptr_array_add (ctx.clients, g_object_ref (fixture->service_info[QMI_SERVICE_DMS].client));
+    for (i = 0; i < ctx.clients->len; i++) {
+        QmiClient *client = g_ptr_array_index (ctx.clients, i);
+
+        if (qmi_client_get_service (client) != QMI_SERVICE_DMS)
+            continue;
+        g_signal_connect (client, "event-report", G_CALLBACK (broadcast_event_report), &ctx);
+        n_dms_clients++;
+    }
+    g_assert_cmpuint (n_dms_clients, ==, n_clients_per_service + 1);
+    ctx.n_expected = n_dms_clients * n_indications;
+
+    /* The indications are sent right after the response to a DMS request */
+    buffer = g_byte_array_sized_new (G_N_ELEMENTS (response) + n_indications * G_N_ELEMENTS (indication));
+    g_byte_array_append (buffer, response, G_N_ELEMENTS (response));
+    for (i = 0; i < n_indications; i++)
+        g_byte_array_append (buffer, indication, G_N_ELEMENTS (indication));
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   buffer->data, buffer->len,
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    g_byte_array_unref (buffer);
+
+    g_test_timer_start ();
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) broadcast_dms_get_ids_ready,
+                            &ctx);
+    test_fixture_loop_run (fixture);
+    g_test_minimized_result (g_test_timer_elapsed (),
+                             "reported %u broadcast indications to %u out of %u clients",
+                             n_indications, n_dms_clients, ctx.clients->len);
+
+    g_assert_cmpuint (ctx.n_reported, ==, ctx.n_expected);
+
+    for (i = 0; i < ctx.clients->len; i++) {
+        QmiClient *client = g_ptr_array_index (ctx.clients, i);
+
+        g_signal_handlers_disconnect_by_func (client, broadcast_event_report, &ctx);
+        if (client != fixture->service_info[QMI_SERVICE_DMS].client)
+            qmi_device_release_client (fixture->device, client, QMI_DEVICE_RELEASE_CLIENT_FLAGS_NONE, 10, NULL, NULL, NULL);
+    }
+    g_ptr_array_unref (ctx.clients);
+}
+
+#endif /* HAVE_QMI_MESSAGE_DMS_GET_IDS && HAVE_QMI_INDICATION_DMS_EVENT_REPORT */
+
+/*****************************************************************************/
+/* Indication filter */
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS && defined HAVE_QMI_INDICATION_DMS_EVENT_REPORT
+
+typedef struct {
+    TestFixture *fixture;
+    guint        n_reported;
+} IndicationFilterContext;
+
+static void
+indication_filter_event_report (QmiClientDms                      *client,
+                                QmiIndicationDmsEventReportOutput *output,
+                                IndicationFilterContext           *ctx)
+{
+    g_assert (output);
+    ctx->n_reported++;
+}
+
+static void
+indication_filter_dms_get_ids_ready (QmiClientDms            *client,
+                                     GAsyncResult            *res,
+                                     IndicationFilterContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+    test_fixture_loop_stop (ctx->fixture);
+}
+
+/* Sends a DMS request whose response comes right after the given amount of
+ * indications, so that all of them have been processed once it completes */
+static void
+indication_filter_run (IndicationFilterContext *ctx,
+                       guint                    n_indications)
+{
+    TestFixture *fixture = ctx->fixture;
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    const guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    const guint8 indication[] = {
+        0x01,
+        0x0C, 0x00, 0x80, 0x02, 0xFF, /* DMS, broadcast */
+        0x04, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00
+    };
+    GByteArray *buffer;
+    guint       i;
+
+    buffer = g_byte_array_new ();
+    for (i = 0; i < n_indications; i++)
+        g_byte_array_append (buffer, indication, G_N_ELEMENTS (indication));
+    g_byte_array_append (buffer, response, G_N_ELEMENTS (response));
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   buffer->data, buffer->len,
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+    g_byte_array_unref (buffer);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) indication_filter_dms_get_ids_ready,
+                            ctx);
+    test_fixture_loop_run (fixture);
+}
+
+static void
+test_generated_core_indication_filter (TestFixture *fixture)
+{
+    const guint16 excluded_ids[] = { QMI_INDICATION_DMS_EVENT_REPORT + 1 };
+    const guint16 allowed_ids[] = { QMI_INDICATION_DMS_EVENT_REPORT };
+    IndicationFilterContext ctx = { 0 };
+    QmiClient *client;
+
+    ctx.fixture = fixture;
+    client = fixture->service_info[QMI_SERVICE_DMS].client;
+
+    /* Skipped without being parsed, as there is no handler yet */
+    indication_filter_run (&ctx, 2);
+
+    /* Once a handler is connected, they are parsed and emitted again */
+    g_signal_connect (client, "event-report", G_CALLBACK (indication_filter_event_report), &ctx);
+    indication_filter_run (&ctx, 2);
+    g_assert_cmpuint (ctx.n_reported, ==, 2);
+
+    /* Not emitted if excluded by the filter... */
+    ctx.n_reported = 0;
+    qmi_client_set_indication_filter (client, excluded_ids, G_N_ELEMENTS (excluded_ids));
+    indication_filter_run (&ctx, 2);
+    g_assert_cmpuint (ctx.n_reported, ==, 0);
+
+    /* ...but emitted if allowed by it */
+    qmi_client_set_indication_filter (client, allowed_ids, G_N_ELEMENTS (allowed_ids));
+    indication_filter_run (&ctx, 2);
+    g_assert_cmpuint (ctx.n_reported, ==, 2);
+
+    /* And all emitted again once the filter is removed */
+    ctx.n_reported = 0;
+    qmi_client_set_indication_filter (client, NULL, 0);
+    indication_filter_run (&ctx, 2);
+    g_assert_cmpuint (ctx.n_reported, ==, 2);
+
+    g_signal_handlers_disconnect_by_func (client, indication_filter_event_report, &ctx);
+}
+
+#endif /* HAVE_QMI_MESSAGE_DMS_GET_IDS && HAVE_QMI_INDICATION_DMS_EVENT_REPORT */
+
+/*****************************************************************************/
+/* Input */
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+
+static const TestFixtureConfig small_read_size_config = {
+    .read_size = 512,
+};
+
+static void
+input_dms_get_ids_ready (QmiClientDms *client,
+                         GAsyncResult *res,
+                         TestFixture  *fixture)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+    test_fixture_loop_stop (fixture);
+}
+
+static void
+test_generated_core_read_size (TestFixture *fixture)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    const guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    const guint8 indication[] = {
+        0x01,
+        0x0C, 0x00, 0x80, 0x02, 0xFF, /* DMS, broadcast */
+        0x04, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00
+    };
+    GByteArray *buffer;
+    guint       read_size = 0;
+    guint64     n_wakeups_before;
+    guint64     n_reads_before;
+    guint64     n_bytes_before;
+    guint64     n_wakeups;
+    guint64     n_reads;
+    guint64     n_bytes;
+    guint       max_reads_per_wakeup;
+    gsize       max_bytes_per_wakeup;
+    guint       i;
+
+    g_object_get (fixture->device, QMI_DEVICE_READ_SIZE, &read_size, NULL);
+    g_assert_cmpuint (read_size, ==, small_read_size_config.read_size);
+
+    /* Several times the read size, all in one go; the response goes last so
+     * that everything has been read once it is reported */
+    buffer = g_byte_array_new ();
+    for (i = 0; i < 100; i++)
+        g_byte_array_append (buffer, indication, G_N_ELEMENTS (indication));
+    g_byte_array_append (buffer, response, G_N_ELEMENTS (response));
+
+    test_port_context_set_command (fixture->ctx,
+                                   expected, G_N_ELEMENTS (expected),
+                                   buffer->data, buffer->len,
+                                   fixture->service_info[QMI_SERVICE_DMS].transaction_id++);
+
+    g_assert (qmi_device_get_input_stats (fixture->device, &n_wakeups_before, &n_reads_before, &n_bytes_before, NULL, NULL));
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 3, NULL,
+                            (GAsyncReadyCallback) input_dms_get_ids_ready,
+                            fixture);
+    test_fixture_loop_run (fixture);
+    g_assert (qmi_device_get_input_stats (fixture->device, &n_wakeups, &n_reads, &n_bytes, &max_reads_per_wakeup, &max_bytes_per_wakeup));
+
+    g_assert_cmpuint (n_bytes - n_bytes_before, ==, buffer->len);
+    g_assert_cmpuint (n_reads - n_reads_before, >=, (buffer->len + read_size - 1) / read_size);
+    g_assert_cmpuint (n_wakeups - n_wakeups_before, >=, 1);
+    g_assert_cmpuint (n_wakeups - n_wakeups_before, <=, n_reads - n_reads_before);
+    g_assert_cmpuint (max_reads_per_wakeup, >=, 1);
+    g_assert_cmpuint (max_bytes_per_wakeup, <=, n_bytes);
+
+    g_byte_array_unref (buffer);
+}
+
+#endif /* HAVE_QMI_MESSAGE_DMS_GET_IDS */
+
+/*****************************************************************************/
+/* Output */
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+
+/* Same as in the QMUX endpoint */
+#define MAX_OUTPUT_QUEUE_LENGTH 256
+
+typedef struct {
+    TestFixture *fixture;
+    guint        n_pending;
+    guint        n_failed;
+} OutputContext;
+
+static void
+output_dms_get_ids_ready (QmiClientDms  *client,
+                          GAsyncResult  *res,
+                          OutputContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    if (output)
+        qmi_message_dms_get_ids_output_unref (output);
+    else {
+        g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_FAILED);
+        g_error_free (error);
+        ctx->n_failed++;
+    }
+
+    g_assert_cmpuint (ctx->n_pending, >, 0);
+    if (--ctx->n_pending == 0)
+        test_fixture_loop_stop (ctx->fixture);
+}
+
+/* Sends all the requests in one go, with only the first @n_replied ones
+ * expected by the modem */
+static void
+output_send_burst (TestFixture   *fixture,
+                   OutputContext *ctx,
+                   guint          n_requests,
+                   guint          n_replied)
+{
+    guint8 expected[] = {
+        0x01,
+        0x0C, 0x00, 0x00, 0x02, 0x01,
+        0x00, 0xFF, 0xFF, 0x25, 0x00, 0x00, 0x00
+    };
+    guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x01,
+        0x02, 0xFF, 0xFF, 0x25, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    guint i;
+
+    for (i = 0; i < n_requests; i++) {
+        guint16 transaction_id;
+
+        transaction_id = fixture->service_info[QMI_SERVICE_DMS].transaction_id++;
+        if (i < n_replied)
+            test_port_context_set_command (fixture->ctx,
+                                           expected, G_N_ELEMENTS (expected),
+                                           response, G_N_ELEMENTS (response),
+                                           transaction_id);
+    }
+
+    ctx->fixture = fixture;
+    ctx->n_pending = n_requests;
+    for (i = 0; i < n_requests; i++)
+        qmi_client_dms_get_ids (QMI_CLIENT_DMS (fixture->service_info[QMI_SERVICE_DMS].client), NULL, 10, NULL,
+                                (GAsyncReadyCallback) output_dms_get_ids_ready,
+                                ctx);
+    test_fixture_loop_run (fixture);
+}
+
+static void
+test_generated_core_output_coalescing (TestFixture *fixture)
+{
+    OutputContext ctx = { 0 };
+    guint64       n_writes_before;
+    guint64       n_messages_before;
+    guint64       n_writes;
+    guint64       n_messages;
+    guint         queue_length;
+    guint         max_queue_length;
+
+    g_assert (qmi_device_get_output_stats (fixture->device, NULL, NULL, &n_writes_before, &n_messages_before, NULL, NULL));
+
+    /* The first request is written right away, and the other ones queued
+     * meanwhile are all written together once that is done */
+    output_send_burst (fixture, &ctx, 4, 4);
+    g_assert_cmpuint (ctx.n_failed, ==, 0);
+
+    g_assert (qmi_device_get_output_stats (fixture->device, &queue_length, &max_queue_length, &n_writes, &n_messages, NULL, NULL));
+    g_assert_cmpuint (queue_length, ==, 0);
+    g_assert_cmpuint (max_queue_length, >=, 4);
+    g_assert_cmpuint (n_messages - n_messages_before, ==, 4);
+    g_assert_cmpuint (n_writes - n_writes_before, ==, 2);
+}
+
+static void
+test_generated_core_output_queue_full (TestFixture *fixture)
+{
+    OutputContext ctx = { 0 };
+    guint         max_queue_length;
+
+    /* Only the request not fitting in the queue fails */
+    output_send_burst (fixture, &ctx, MAX_OUTPUT_QUEUE_LENGTH + 1, MAX_OUTPUT_QUEUE_LENGTH);
+    g_assert_cmpuint (ctx.n_failed, ==, 1);
+
+    g_assert (qmi_device_get_output_stats (fixture->device, NULL, &max_queue_length, NULL, NULL, NULL, NULL));
+    g_assert_cmpuint (max_queue_length, ==, MAX_OUTPUT_QUEUE_LENGTH);
+}
+
+static const TestFixtureConfig io_thread_config = {
+    .open_flags = QMI_DEVICE_OPEN_FLAGS_IO_THREAD,
+};
+
+static void
+test_generated_core_io_thread (TestFixture *fixture)
+{
+    OutputContext ctx = { 0 };
+    guint64       n_bytes_before;
+    guint64       n_messages_before;
+    guint64       n_bytes;
+    guint64       n_messages;
+    guint         queue_length;
+
+    /* Client allocation already went through the I/O thread during setup,
+     * and the release and close go through it during teardown */
+    g_assert (qmi_device_get_input_stats (fixture->device, NULL, NULL, &n_bytes_before, NULL, NULL));
+    g_assert (qmi_device_get_output_stats (fixture->device, NULL, NULL, NULL, &n_messages_before, NULL, NULL));
+
+    output_send_burst (fixture, &ctx, 4, 4);
+    g_assert_cmpuint (ctx.n_failed, ==, 0);
+
+    g_assert (qmi_device_get_input_stats (fixture->device, NULL, NULL, &n_bytes, NULL, NULL));
+    g_assert (qmi_device_get_output_stats (fixture->device, &queue_length, NULL, NULL, &n_messages, NULL, NULL));
+    g_assert_cmpuint (queue_length, ==, 0);
+    g_assert_cmpuint (n_messages - n_messages_before, ==, 4);
+    g_assert_cmpuint (n_bytes - n_bytes_before, ==, 4 * 20);
+}
+
+#endif /* HAVE_QMI_MESSAGE_DMS_GET_IDS */
+
 /*****************************************************************************/
 /* DMS Get IDs */
 
@@ -1318,6 +1843,17 @@ int main (int argc, char **argv)
 
     /* Test the setup/teardown test methods */
     TEST_ADD ("/libqmi-glib/generated/core", test_generated_core);
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS && defined HAVE_QMI_INDICATION_DMS_EVENT_REPORT
+    TEST_ADD ("/libqmi-glib/generated/core/broadcast-indications", test_generated_core_broadcast_indications);
+    TEST_ADD ("/libqmi-glib/generated/core/indication-filter",     test_generated_core_indication_filter);
+#endif
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+    TEST_ADD_WITH_CONFIG ("/libqmi-glib/generated/core/read-size", &small_read_size_config, test_generated_core_read_size);
+    TEST_ADD ("/libqmi-glib/generated/core/output-coalescing", test_generated_core_output_coalescing);
+    TEST_ADD ("/libqmi-glib/generated/core/output-queue-full", test_generated_core_output_queue_full);
+    TEST_ADD_WITH_CONFIG ("/libqmi-glib/generated/core/io-thread", &io_thread_config, test_generated_core_io_thread);
+#endif
 
 #if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
     TEST_ADD ("/libqmi-glib/generated/dms/get-ids", test_generated_dms_get_ids);
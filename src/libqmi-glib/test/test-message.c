@@ -1569,6 +1569,262 @@ test_message_tlv_read_overflow_tlv (void)
 
 /*****************************************************************************/
 
+static void
+add_tlv_guint8 (QmiMessage *self,
+                guint8      type,
+                guint8      value)
+{
+    g_autoptr(GError) error = NULL;
+    gsize             init_offset;
+    gboolean          ret;
+
+    init_offset = qmi_message_tlv_write_init (self, type, &error);
+    g_assert_no_error (error);
+    g_assert (init_offset > 0);
+
+    ret = qmi_message_tlv_write_guint8 (self, value, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+
+    ret = qmi_message_tlv_write_complete (self, init_offset, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+}
+
+static void
+check_tlv_guint8 (QmiMessage *self,
+                  guint8      type,
+                  guint8      expected)
+{
+    g_autoptr(GError) error = NULL;
+    gsize             init_offset;
+    gsize             offset = 0;
+    guint8            value;
+    gboolean          ret;
+    const guint8     *raw;
+    guint16           raw_length = 0;
+
+    init_offset = qmi_message_tlv_read_init (self, type, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (init_offset > 0);
+
+    ret = qmi_message_tlv_read_guint8 (self, init_offset, &offset, &value, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert_cmpuint (value, ==, expected);
+
+    raw = qmi_message_get_raw_tlv (self, type, &raw_length);
+    g_assert (raw);
+    g_assert_cmpuint (raw_length, ==, 1);
+    g_assert_cmpuint (raw[0], ==, expected);
+}
+
+static void
+check_tlv_missing (QmiMessage *self,
+                   guint8      type)
+{
+    g_autoptr(GError) error = NULL;
+    guint16           raw_length = 0;
+
+    g_assert_cmpuint (qmi_message_tlv_read_init (self, type, NULL, &error), ==, 0);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND);
+    g_assert (!qmi_message_get_raw_tlv (self, type, &raw_length));
+}
+
+static void
+test_message_tlv_lookup (void)
+{
+    g_autoptr(QmiMessage) first = NULL;
+    g_autoptr(QmiMessage) second = NULL;
+    g_autoptr(GError)     error = NULL;
+    gsize                 init_offset;
+    gboolean              ret;
+
+    first = qmi_message_new (QMI_SERVICE_NAS, 0x01, 0x02, 0xFFFF);
+    add_tlv_guint8 (first, 0x10, 0xA0);
+    add_tlv_guint8 (first, 0x11, 0xA1);
+    add_tlv_guint8 (first, 0x12, 0xA2);
+    /* Duplicate TLVs always report the first one found */
+    add_tlv_guint8 (first, 0x11, 0xB1);
+
+    /* Read out of order */
+    check_tlv_guint8 (first, 0x12, 0xA2);
+    check_tlv_guint8 (first, 0x10, 0xA0);
+    check_tlv_guint8 (first, 0x11, 0xA1);
+    check_tlv_missing (first, 0x13);
+
+    /* Interleave reads with a different message */
+    second = qmi_message_new (QMI_SERVICE_NAS, 0x01, 0x03, 0xFFFF);
+    add_tlv_guint8 (second, 0x12, 0xC2);
+    add_tlv_guint8 (second, 0x13, 0xC3);
+
+    check_tlv_guint8 (first, 0x10, 0xA0);
+    check_tlv_guint8 (second, 0x12, 0xC2);
+    check_tlv_guint8 (first, 0x12, 0xA2);
+    check_tlv_missing (second, 0x10);
+    check_tlv_guint8 (second, 0x13, 0xC3);
+    check_tlv_missing (first, 0x13);
+
+    /* Modifying the message must be reflected in the lookups */
+    add_tlv_guint8 (first, 0x13, 0xA3);
+    check_tlv_guint8 (first, 0x13, 0xA3);
+
+    init_offset = qmi_message_tlv_write_init (first, 0x14, &error);
+    g_assert_no_error (error);
+    g_assert (init_offset > 0);
+    ret = qmi_message_tlv_write_guint8 (first, 0xA4, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    qmi_message_tlv_write_reset (first, init_offset);
+    check_tlv_missing (first, 0x14);
+    check_tlv_guint8 (first, 0x13, 0xA3);
+}
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+
+static void
+test_message_tlv_parse_any_order (void)
+{
+    g_autoptr(GByteArray)                buffer = NULL;
+    g_autoptr(QmiMessage)                message = NULL;
+    g_autoptr(QmiMessageDmsGetIdsOutput) output = NULL;
+    g_autoptr(GError)                    error = NULL;
+    const gchar                         *str = NULL;
+    gboolean                             ret;
+
+    const guint8 dms_message[] = {
+        0x01,                   /* marker */
+        0x26, 0x00,             /* qmux length */
+        0x80,                   /* qmux flags */
+        0x02,                   /* service: DMS */
+        0x03,                   /* client id */
+        0x02,                   /* service flags: response */
+        0x01, 0x00,             /* transaction */
+        0x25, 0x00,             /* message: Get IDs */
+        0x1A, 0x00,             /* all tlvs length: 26 bytes */
+        /* Meid, before the result */
+        0x12, 0x02, 0x00, 0x4D, 0x31,
+        /* Unknown TLV */
+        0x30, 0x01, 0x00, 0xFF,
+        /* Result */
+        0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* Esn, twice */
+        0x10, 0x02, 0x00, 0x45, 0x31,
+        0x10, 0x02, 0x00, 0x58, 0x58,
+    };
+
+    buffer = g_byte_array_append (g_byte_array_sized_new (sizeof (dms_message)), dms_message, sizeof (dms_message));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+
+    output = qmi_message_dms_get_ids_response_parse (message, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    ret = qmi_message_dms_get_ids_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+
+    /* TLVs given before the ones they depend on are still parsed */
+    ret = qmi_message_dms_get_ids_output_get_meid (output, &str, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert_cmpstr (str, ==, "M1");
+
+    /* Duplicate TLVs always report the first one found */
+    ret = qmi_message_dms_get_ids_output_get_esn (output, &str, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert_cmpstr (str, ==, "E1");
+
+    ret = qmi_message_dms_get_ids_output_get_imei (output, &str, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND);
+    g_assert (!ret);
+}
+
+#endif
+
+#if defined HAVE_QMI_MESSAGE_NAS_GET_SERVING_SYSTEM
+
+static void
+test_message_parse_lazy (void)
+{
+    g_autoptr(GByteArray)                          buffer = NULL;
+    g_autoptr(QmiMessageNasGetServingSystemOutput) output = NULL;
+    g_autoptr(GError)                              error = NULL;
+    QmiMessage                                    *message;
+    const gchar                                   *description = NULL;
+    const gchar                                   *description_again = NULL;
+    guint16                                        mcc = 0;
+    guint16                                        mnc = 0;
+    guint16                                        lac = 0;
+    guint16                                        sid = 0;
+    guint16                                        nid = 0;
+    gboolean                                       ret;
+
+    const guint8 nas_message[] = {
+        0x01,
+        0x6E, 0x00, 0x80, 0x03, 0x01,
+        0x02, 0x01, 0x00, 0x24, 0x00, 0x62, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x06,
+        0x00, 0x01, 0x01, 0x01, 0x02, 0x01, 0x05, 0x10,
+        0x01, 0x00, 0x01, 0x11, 0x04, 0x00, 0x03, 0x03,
+        0x04, 0x05, 0x12, 0x0A, 0x00, 0xDE, 0x00, 0x32,
+        0x00, 0x05, 0x49, 0x76, 0x3A, 0x4C, 0x06, 0x15,
+        0x03, 0x00, 0x01, 0x05, 0x01, 0x1B, 0x01, 0x00,
+        0x00, 0x1C, 0x02, 0x00, 0xB4, 0x5F, 0x1D, 0x04,
+        0x00, 0xCF, 0x5A, 0x13, 0x01, 0x21, 0x05, 0x00,
+        0x02, 0x03, 0x00, 0x00, 0x00, 0x25, 0x08, 0x00,
+        0x03, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+        0x26, 0x02, 0x00, 0x22, 0x01, 0x27, 0x05, 0x00,
+        0xDE, 0x00, 0x32, 0x00, 0x00, 0x28, 0x01, 0x00,
+        0x00
+    };
+
+    buffer = g_byte_array_append (g_byte_array_sized_new (sizeof (nas_message)), nas_message, sizeof (nas_message));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+
+    output = qmi_message_nas_get_serving_system_response_parse (message, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+
+    /* The output keeps the message around for the fields decoded later */
+    qmi_message_unref (message);
+
+    ret = qmi_message_nas_get_serving_system_output_get_result (output, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+
+    ret = qmi_message_nas_get_serving_system_output_get_current_plmn (output, &mcc, &mnc, &description, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert_cmpuint (mcc, ==, 222);
+    g_assert_cmpuint (mnc, ==, 50);
+    g_assert_cmpstr (description, ==, "Iliad");
+
+    /* Decoded only once */
+    ret = qmi_message_nas_get_serving_system_output_get_current_plmn (output, NULL, NULL, &description_again, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert (description_again == description);
+
+    ret = qmi_message_nas_get_serving_system_output_get_lac_3gpp (output, &lac, &error);
+    g_assert_no_error (error);
+    g_assert (ret);
+    g_assert_cmpuint (lac, ==, 24500);
+
+    ret = qmi_message_nas_get_serving_system_output_get_cdma_system_id (output, &sid, &nid, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TLV_NOT_FOUND);
+    g_assert (!ret);
+}
+
+#endif
+
+/*****************************************************************************/
+
 static void
 test_message_set_transaction_id_ctl (void)
 {
@@ -1730,6 +1986,13 @@ int main (int argc, char **argv)
     g_test_add_func ("/libqmi-glib/message/tlv-write/overflow",        test_message_tlv_write_overflow);
     g_test_add_func ("/libqmi-glib/message/tlv-read/overflow-message", test_message_tlv_read_overflow_message);
     g_test_add_func ("/libqmi-glib/message/tlv-read/overflow-tlv",     test_message_tlv_read_overflow_tlv);
+    g_test_add_func ("/libqmi-glib/message/tlv-read/lookup",           test_message_tlv_lookup);
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+    g_test_add_func ("/libqmi-glib/message/tlv-read/parse-any-order",  test_message_tlv_parse_any_order);
+#endif
+#if defined HAVE_QMI_MESSAGE_NAS_GET_SERVING_SYSTEM
+    g_test_add_func ("/libqmi-glib/message/parse/lazy", test_message_parse_lazy);
+#endif
 
     g_test_add_func ("/libqmi-glib/message/set-transaction-id/ctl",      test_message_set_transaction_id_ctl);
     g_test_add_func ("/libqmi-glib/message/set-transaction-id/services", test_message_set_transaction_id_services);
@@ -38,9 +38,22 @@ struct _TestPortContext {
     GSocketService *socket_service;
     GList *clients;
     GMutex command_mutex;
+    /* Commands expected, in order, each followed by its response */
+    GQueue commands;
+};
+
+typedef struct {
     GByteArray *command;
     GByteArray *response;
-};
+} Command;
+
+static void
+command_free (Command *command)
+{
+    g_byte_array_unref (command->command);
+    g_byte_array_unref (command->response);
+    g_slice_free (Command, command);
+}
 
 /*****************************************************************************/
 /* Helpers */
@@ -89,16 +102,16 @@ test_port_context_set_command (TestPortContext *ctx,
                                gsize            response_size,
                                guint16          transaction_id)
 {
-    g_mutex_lock (&ctx->command_mutex);
-    {
-        g_assert (!ctx->command);
-        ctx->command = g_byte_array_append (g_byte_array_sized_new (command_size), command, command_size);
-        qmi_message_set_transaction_id ((QmiMessage *)ctx->command, transaction_id);
+    Command *next;
 
-        g_assert (!ctx->response);
-        ctx->response = g_byte_array_append (g_byte_array_sized_new (response_size), response, response_size);
-        qmi_message_set_transaction_id ((QmiMessage *)ctx->response, transaction_id);
-    }
+    next = g_slice_new (Command);
+    next->command = g_byte_array_append (g_byte_array_sized_new (command_size), command, command_size);
+    qmi_message_set_transaction_id ((QmiMessage *)next->command, transaction_id);
+    next->response = g_byte_array_append (g_byte_array_sized_new (response_size), response, response_size);
+    qmi_message_set_transaction_id ((QmiMessage *)next->response, transaction_id);
+
+    g_mutex_lock (&ctx->command_mutex);
+    g_queue_push_tail (&ctx->commands, next);
     g_mutex_unlock (&ctx->command_mutex);
 }
 
@@ -112,6 +125,7 @@ process_next_command (TestPortContext *ctx,
     gsize         message_raw_length;
     gchar        *expected;
     gchar        *received;
+    Command      *command;
     GByteArray   *response;
 
     /* Every message received must start with the QMUX or QRTR marker.
@@ -141,27 +155,21 @@ process_next_command (TestPortContext *ctx,
      * different), compared to a simple memcmp(). */
     g_mutex_lock (&ctx->command_mutex);
     {
-        g_assert (ctx->command);
-        expected = str_hex (ctx->command->data, ctx->command->len, ':');
+        command = g_queue_pop_head (&ctx->commands);
+        g_assert (command);
     }
     g_mutex_unlock (&ctx->command_mutex);
+    expected = str_hex (command->command->data, command->command->len, ':');
 
     received = str_hex (message_raw, message_raw_length, ':');
     g_assert_cmpstr (expected, ==, received);
     g_free (expected);
     g_free (received);
     qmi_message_unref (message);
-    g_byte_array_unref (ctx->command);
-    ctx->command = NULL;
 
     /* Command Expected == Received, so now return the Response */
-    g_mutex_lock (&ctx->command_mutex);
-    {
-        response = ctx->response;
-        ctx->response = NULL;
-    }
-    g_mutex_unlock (&ctx->command_mutex);
-
+    response = g_byte_array_ref (command->response);
+    command_free (command);
     return response;
 }
 
@@ -423,10 +431,8 @@ test_port_context_free (TestPortContext *ctx)
         g_object_unref (ctx->socket_service);
     }
     g_free (ctx->name);
-    if (ctx->command)
-        g_byte_array_unref (ctx->command);
-    if (ctx->response)
-        g_byte_array_unref (ctx->response);
+    while (!g_queue_is_empty (&ctx->commands))
+        command_free (g_queue_pop_head (&ctx->commands));
     g_slice_free (TestPortContext, ctx);
 }
 
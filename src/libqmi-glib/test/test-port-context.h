@@ -27,6 +27,7 @@ TestPortContext *test_port_context_new           (const gchar     *name);
 void             test_port_context_start         (TestPortContext *ctx);
 void             test_port_context_stop          (TestPortContext *ctx);
 void             test_port_context_free          (TestPortContext *ctx);
+/* Commands may be set in advance; they're expected in the same order */
 void             test_port_context_set_command   (TestPortContext *ctx,
                                                   const guint8    *command,
                                                   gsize            command_size,
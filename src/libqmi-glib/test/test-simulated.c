@@ -0,0 +1,1251 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <libqmi-glib.h>
+
+typedef struct {
+    GMainLoop *loop;
+    QmiDevice *device;
+    QmiClient *client;
+    guint      n_indications;
+    guint      n_pending;
+    GPtrArray *clients;
+} TestContext;
+
+/*****************************************************************************/
+
+static void
+device_new_ready (GObject      *source,
+                  GAsyncResult *res,
+                  TestContext  *ctx)
+{
+    GError *error = NULL;
+
+    ctx->device = qmi_device_new_finish (res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_DEVICE (ctx->device));
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_open_ready (QmiDevice    *device,
+                   GAsyncResult *res,
+                   TestContext  *ctx)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_open_finish (device, res, &error));
+    g_assert_no_error (error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_allocate_client_ready (QmiDevice    *device,
+                              GAsyncResult *res,
+                              TestContext  *ctx)
+{
+    GError *error = NULL;
+
+    ctx->client = qmi_device_allocate_client_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (QMI_IS_CLIENT_DMS (ctx->client));
+    g_assert_cmpuint (qmi_client_get_cid (ctx->client), !=, 0);
+    g_assert_cmpuint (qmi_client_get_cid (ctx->client), !=, QMI_CID_BROADCAST);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_release_client_ready (QmiDevice    *device,
+                             GAsyncResult *res,
+                             TestContext  *ctx)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_release_client_finish (device, res, &error));
+    g_assert_no_error (error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_close_ready (QmiDevice    *device,
+                    GAsyncResult *res,
+                    TestContext  *ctx)
+{
+    GError *error = NULL;
+
+    g_assert (qmi_device_close_finish (device, res, &error));
+    g_assert_no_error (error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+test_context_setup (TestContext *ctx)
+{
+    GFile *file;
+
+    ctx->loop = g_main_loop_new (NULL, FALSE);
+
+    file = g_file_new_for_path ("/dev/simulated-qmi");
+    g_async_initable_new_async (QMI_TYPE_DEVICE,
+                                G_PRIORITY_DEFAULT,
+                                NULL,
+                                (GAsyncReadyCallback) device_new_ready,
+                                ctx,
+                                QMI_DEVICE_FILE,          file,
+                                QMI_DEVICE_NO_FILE_CHECK, TRUE,
+                                NULL);
+    g_object_unref (file);
+    g_main_loop_run (ctx->loop);
+}
+
+static void
+test_context_open (TestContext *ctx)
+{
+    qmi_device_open (ctx->device,
+                     (QMI_DEVICE_OPEN_FLAGS_SIMULATED |
+                      QMI_DEVICE_OPEN_FLAGS_VERSION_INFO |
+                      QMI_DEVICE_OPEN_FLAGS_SYNC),
+                     5, NULL,
+                     (GAsyncReadyCallback) device_open_ready,
+                     ctx);
+    g_main_loop_run (ctx->loop);
+    g_assert (qmi_device_is_open (ctx->device));
+
+    qmi_device_allocate_client (ctx->device, QMI_SERVICE_DMS, QMI_CID_NONE, 5, NULL,
+                                (GAsyncReadyCallback) device_allocate_client_ready,
+                                ctx);
+    g_main_loop_run (ctx->loop);
+}
+
+static void
+test_context_teardown (TestContext *ctx)
+{
+    qmi_device_release_client (ctx->device, ctx->client, QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 5, NULL,
+                               (GAsyncReadyCallback) device_release_client_ready,
+                               ctx);
+    g_main_loop_run (ctx->loop);
+    g_clear_object (&ctx->client);
+
+    qmi_device_close_async (ctx->device, 5, NULL,
+                            (GAsyncReadyCallback) device_close_ready,
+                            ctx);
+    g_main_loop_run (ctx->loop);
+
+    g_clear_object (&ctx->device);
+    g_main_loop_unref (ctx->loop);
+}
+
+/*****************************************************************************/
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+
+static void
+dms_get_ids_ready (QmiClientDms *client,
+                   GAsyncResult *res,
+                   TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    g_assert (qmi_message_dms_get_ids_output_get_result (output, &error));
+    g_assert_no_error (error);
+    qmi_message_dms_get_ids_output_unref (output);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+dms_get_ids_unsupported_ready (QmiClientDms *client,
+                               GAsyncResult *res,
+                               TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    g_assert (!qmi_message_dms_get_ids_output_get_result (output, &error));
+    g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_INVALID_QMI_COMMAND);
+    g_error_free (error);
+    qmi_message_dms_get_ids_output_unref (output);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+add_dms_get_ids_response (QmiDevice *device,
+                          guint      latency_ms)
+{
+    const guint8 response[] = {
+        0x01,
+        0x13, 0x00, 0x80, 0x02, 0x00,
+        0x02, 0x00, 0x00, 0x25, 0x00, 0x07, 0x00, 0x02,
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    QmiMessage *message;
+    GByteArray *buffer;
+    GError     *error = NULL;
+
+    buffer = g_byte_array_append (g_byte_array_new (), response, G_N_ELEMENTS (response));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    qmi_device_add_simulated_response (device, message, latency_ms);
+    qmi_message_unref (message);
+    g_byte_array_unref (buffer);
+}
+
+static void
+test_simulated_response (void)
+{
+    TestContext ctx = { 0 };
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    /* Not configured yet */
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_unsupported_ready,
+                            &ctx);
+    g_main_loop_run (ctx.loop);
+
+    add_dms_get_ids_response (ctx.device, 10);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            &ctx);
+    g_main_loop_run (ctx.loop);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_simulated_metrics (void)
+{
+    TestContext              ctx = { 0 };
+    GArray                  *array;
+    QmiDeviceMessageMetrics *metrics = NULL;
+    guint64                  n_latencies = 0;
+    guint                    i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_unsupported_ready,
+                            &ctx);
+    g_main_loop_run (ctx.loop);
+
+    array = qmi_device_get_message_metrics (ctx.device);
+    for (i = 0; i < array->len; i++) {
+        QmiDeviceMessageMetrics *current;
+
+        current = &g_array_index (array, QmiDeviceMessageMetrics, i);
+        if (current->service == QMI_SERVICE_DMS && current->message_id == QMI_MESSAGE_DMS_GET_IDS)
+            metrics = current;
+    }
+    g_assert (metrics);
+    g_assert_cmpuint (metrics->n_requests,  ==, 1);
+    g_assert_cmpuint (metrics->n_in_flight, ==, 0);
+    g_assert_cmpuint (metrics->n_timeouts,  ==, 0);
+    g_assert_cmpuint (metrics->n_failures,  ==, 0);
+    g_assert_cmpuint (metrics->bytes_out,   >,  0);
+    g_assert_cmpuint (metrics->bytes_in,    >,  0);
+    g_assert_cmpuint (metrics->max_latency, <=, metrics->total_latency);
+    for (i = 0; i < QMI_DEVICE_METRICS_N_LATENCY_BUCKETS; i++)
+        n_latencies += metrics->latency_histogram[i];
+    g_assert_cmpuint (n_latencies, ==, 1);
+    g_array_unref (array);
+
+    qmi_device_reset_metrics (ctx.device);
+    array = qmi_device_get_message_metrics (ctx.device);
+    g_assert_cmpuint (array->len, ==, 0);
+    g_array_unref (array);
+
+    test_context_teardown (&ctx);
+}
+
+#define N_WINDOW_REQUESTS 3
+
+static void
+dms_get_ids_window_ready (QmiClientDms *client,
+                          GAsyncResult *res,
+                          TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+    guint   n_in_flight = 0;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    g_assert (qmi_device_get_request_window_stats (ctx->device, QMI_SERVICE_DMS, &n_in_flight, NULL, NULL, NULL, NULL, NULL));
+    g_assert_cmpuint (n_in_flight, <=, 1);
+
+    if (--ctx->n_pending == 0)
+        g_main_loop_quit (ctx->loop);
+}
+
+static void
+test_simulated_window (void)
+{
+    TestContext ctx = { 0 };
+    guint       n_in_flight = 0;
+    guint       queue_length = 0;
+    guint       max_queue_length = 0;
+    guint64     n_queued = 0;
+    guint64     max_wait = 0;
+    guint       i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    g_assert (!qmi_device_get_request_window_stats (ctx.device, QMI_SERVICE_DMS, NULL, NULL, NULL, NULL, NULL, NULL));
+    qmi_device_set_request_window (ctx.device, QMI_SERVICE_DMS, 1, 0);
+    add_dms_get_ids_response (ctx.device, 50);
+
+    for (i = 0; i < N_WINDOW_REQUESTS; i++) {
+        ctx.n_pending++;
+        qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                                (GAsyncReadyCallback) dms_get_ids_window_ready,
+                                &ctx);
+    }
+
+    g_assert (qmi_device_get_request_window_stats (ctx.device, QMI_SERVICE_DMS,
+                                                   &n_in_flight, &queue_length, NULL, NULL, NULL, NULL));
+    g_assert_cmpuint (n_in_flight,  ==, 1);
+    g_assert_cmpuint (queue_length, ==, N_WINDOW_REQUESTS - 1);
+
+    g_main_loop_run (ctx.loop);
+
+    g_assert (qmi_device_get_request_window_stats (ctx.device, QMI_SERVICE_DMS,
+                                                   &n_in_flight, &queue_length, &max_queue_length,
+                                                   &n_queued, NULL, &max_wait));
+    g_assert_cmpuint (n_in_flight,      ==, 0);
+    g_assert_cmpuint (queue_length,     ==, 0);
+    g_assert_cmpuint (max_queue_length, ==, N_WINDOW_REQUESTS - 1);
+    g_assert_cmpuint (n_queued,         ==, N_WINDOW_REQUESTS - 1);
+    g_assert_cmpuint (max_wait,         >,  0);
+
+    test_context_teardown (&ctx);
+}
+
+#define N_COALESCED_REQUESTS 3
+
+static void
+dms_get_ids_coalesced_ready (QmiClientDms *client,
+                             GAsyncResult *res,
+                             TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    g_assert (qmi_message_dms_get_ids_output_get_result (output, &error));
+    g_assert_no_error (error);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    if (--ctx->n_pending == 0)
+        g_main_loop_quit (ctx->loop);
+}
+
+typedef struct {
+    TestContext *ctx;
+    QmiMessage  *request;
+} CoalescedRequest;
+
+static void
+command_full_coalesced_ready (QmiDevice        *device,
+                              GAsyncResult     *res,
+                              CoalescedRequest *request)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+
+    /* Each attached request gets a reply matching its own ids */
+    g_assert_cmpuint (qmi_message_get_client_id (response), ==, qmi_message_get_client_id (request->request));
+    g_assert_cmpuint (qmi_message_get_transaction_id (response), ==, qmi_message_get_transaction_id (request->request));
+    g_assert_cmpuint (qmi_message_get_message_id (response), ==, QMI_MESSAGE_DMS_GET_IDS);
+    qmi_message_unref (response);
+
+    if (--request->ctx->n_pending == 0)
+        g_main_loop_quit (request->ctx->loop);
+}
+
+static void
+test_simulated_coalescing (void)
+{
+    TestContext              ctx = { 0 };
+    QmiClient               *clients[2];
+    CoalescedRequest         requests[N_COALESCED_REQUESTS];
+    GArray                  *array;
+    QmiDeviceMessageMetrics *metrics = NULL;
+    guint                    i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    /* A second client, so that attached requests have different client ids */
+    clients[0] = g_object_ref (ctx.client);
+    qmi_device_allocate_client (ctx.device, QMI_SERVICE_DMS, QMI_CID_NONE, 5, NULL,
+                                (GAsyncReadyCallback) device_allocate_client_ready,
+                                &ctx);
+    g_main_loop_run (ctx.loop);
+    clients[1] = ctx.client;
+    ctx.client = clients[0];
+    g_assert_cmpuint (qmi_client_get_cid (clients[0]), !=, qmi_client_get_cid (clients[1]));
+
+    qmi_device_set_request_coalescing (ctx.device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, TRUE);
+    add_dms_get_ids_response (ctx.device, 50);
+
+    for (i = 0; i < N_COALESCED_REQUESTS; i++) {
+        QmiClient *client = clients[i % G_N_ELEMENTS (clients)];
+
+        requests[i].ctx = &ctx;
+        requests[i].request = qmi_message_new (QMI_SERVICE_DMS,
+                                               qmi_client_get_cid (client),
+                                               qmi_client_get_next_transaction_id (client),
+                                               QMI_MESSAGE_DMS_GET_IDS);
+        ctx.n_pending++;
+        qmi_device_command_full (ctx.device, requests[i].request, NULL, 5, NULL,
+                                 (GAsyncReadyCallback) command_full_coalesced_ready,
+                                 &requests[i]);
+    }
+    g_assert_cmpuint (qmi_device_get_n_pending_transactions (ctx.device), ==, 1);
+    g_main_loop_run (ctx.loop);
+
+    for (i = 0; i < N_COALESCED_REQUESTS; i++)
+        qmi_message_unref (requests[i].request);
+
+    array = qmi_device_get_message_metrics (ctx.device);
+    for (i = 0; i < array->len; i++) {
+        QmiDeviceMessageMetrics *current;
+
+        current = &g_array_index (array, QmiDeviceMessageMetrics, i);
+        if (current->service == QMI_SERVICE_DMS && current->message_id == QMI_MESSAGE_DMS_GET_IDS)
+            metrics = current;
+    }
+    g_assert (metrics);
+    g_assert_cmpuint (metrics->n_requests,  ==, N_COALESCED_REQUESTS);
+    g_assert_cmpuint (metrics->n_coalesced, ==, N_COALESCED_REQUESTS - 1);
+    g_assert_cmpuint (metrics->n_in_flight, ==, 0);
+    g_array_unref (array);
+
+    qmi_device_release_client (ctx.device, clients[1], QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 5, NULL,
+                               (GAsyncReadyCallback) device_release_client_ready,
+                               &ctx);
+    g_main_loop_run (ctx.loop);
+    g_object_unref (clients[1]);
+    g_object_unref (clients[0]);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+dms_get_ids_aborted_ready (QmiClientDms *client,
+                           GAsyncResult *res,
+                           TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_error (error, QMI_PROTOCOL_ERROR, QMI_PROTOCOL_ERROR_ABORTED);
+    g_assert (!output);
+    g_error_free (error);
+
+    if (--ctx->n_pending == 0)
+        g_main_loop_quit (ctx->loop);
+}
+
+static void
+test_simulated_coalescing_cancelled (void)
+{
+    TestContext   ctx = { 0 };
+    GCancellable *cancellable;
+    guint         queue_length = 0;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    qmi_device_set_request_window (ctx.device, QMI_SERVICE_DMS, 1, 0);
+    add_dms_get_ids_response (ctx.device, 50);
+
+    /* Sent before enabling coalescing, so that it only fills the window */
+    ctx.n_pending++;
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_coalesced_ready,
+                            &ctx);
+
+    /* The first one is queued, and the second one attached to it */
+    qmi_device_set_request_coalescing (ctx.device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, TRUE);
+    cancellable = g_cancellable_new ();
+    ctx.n_pending++;
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, cancellable,
+                            (GAsyncReadyCallback) dms_get_ids_aborted_ready,
+                            &ctx);
+    ctx.n_pending++;
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_coalesced_ready,
+                            &ctx);
+    g_assert (qmi_device_get_request_window_stats (ctx.device, QMI_SERVICE_DMS,
+                                                   NULL, &queue_length, NULL, NULL, NULL, NULL));
+    g_assert_cmpuint (queue_length, ==, 1);
+
+    /* Only the cancelled one is aborted, the queued request is still sent
+     * for the one attached to it */
+    g_cancellable_cancel (cancellable);
+    g_main_loop_run (ctx.loop);
+    g_assert_cmpuint (qmi_device_get_n_pending_transactions (ctx.device), ==, 0);
+    g_object_unref (cancellable);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_simulated_cache (void)
+{
+    TestContext ctx = { 0 };
+    guint       n_entries = 0;
+    guint64     n_hits = 0;
+    guint64     n_misses = 0;
+    guint       i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    qmi_device_set_response_cache_ttl (ctx.device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS,
+                                       QMI_DEVICE_RESPONSE_CACHE_TTL_FOREVER);
+    add_dms_get_ids_response (ctx.device, 10);
+
+    /* Only the first request is sent */
+    for (i = 0; i < 3; i++) {
+        qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                                (GAsyncReadyCallback) dms_get_ids_ready,
+                                &ctx);
+        g_main_loop_run (ctx.loop);
+    }
+
+    qmi_device_get_response_cache_stats (ctx.device, &n_entries, &n_hits, &n_misses);
+    g_assert_cmpuint (n_entries, ==, 1);
+    g_assert_cmpuint (n_hits,    ==, 2);
+    g_assert_cmpuint (n_misses,  ==, 1);
+
+    qmi_device_invalidate_response_cache (ctx.device, QMI_SERVICE_DMS);
+    qmi_device_get_response_cache_stats (ctx.device, &n_entries, NULL, NULL);
+    g_assert_cmpuint (n_entries, ==, 0);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+command_full_ready (QmiDevice    *device,
+                    GAsyncResult *res,
+                    TestContext  *ctx)
+{
+    QmiMessage *response;
+    GError     *error = NULL;
+
+    response = qmi_device_command_full_finish (device, res, &error);
+    g_assert_no_error (error);
+    g_assert (response);
+    qmi_message_unref (response);
+    g_main_loop_quit (ctx->loop);
+}
+
+/* Requests differing in an additional TLV are cached separately */
+static void
+send_dms_get_ids_with_tag (TestContext *ctx,
+                           guint16      tag)
+{
+    QmiMessage *request;
+    GError     *error = NULL;
+
+    request = qmi_message_new (QMI_SERVICE_DMS,
+                               qmi_client_get_cid (ctx->client),
+                               qmi_client_get_next_transaction_id (ctx->client),
+                               QMI_MESSAGE_DMS_GET_IDS);
+    g_assert (qmi_message_add_raw_tlv (request, 0x10, (const guint8 *)&tag, sizeof (tag), &error));
+    g_assert_no_error (error);
+
+    qmi_device_command_full (ctx->device, request, NULL, 5, NULL,
+                             (GAsyncReadyCallback) command_full_ready,
+                             ctx);
+    g_main_loop_run (ctx->loop);
+    qmi_message_unref (request);
+}
+
+/* Same as in the device */
+#define RESPONSE_CACHE_MAX_ENTRIES 256
+
+static void
+test_simulated_cache_limit (void)
+{
+    TestContext ctx = { 0 };
+    guint       n_entries = 0;
+    guint64     n_hits = 0;
+    guint64     n_hits_before = 0;
+    guint       i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    qmi_device_set_response_cache_ttl (ctx.device, QMI_SERVICE_DMS, QMI_MESSAGE_DMS_GET_IDS, 1000);
+    add_dms_get_ids_response (ctx.device, 0);
+
+    /* The oldest one is dropped when full */
+    for (i = 0; i <= RESPONSE_CACHE_MAX_ENTRIES; i++)
+        send_dms_get_ids_with_tag (&ctx, i);
+    qmi_device_get_response_cache_stats (ctx.device, &n_entries, &n_hits_before, NULL);
+    g_assert_cmpuint (n_entries, ==, RESPONSE_CACHE_MAX_ENTRIES);
+
+    send_dms_get_ids_with_tag (&ctx, RESPONSE_CACHE_MAX_ENTRIES);
+    qmi_device_get_response_cache_stats (ctx.device, &n_entries, &n_hits, NULL);
+    g_assert_cmpuint (n_hits, ==, n_hits_before + 1);
+    send_dms_get_ids_with_tag (&ctx, 0);
+    qmi_device_get_response_cache_stats (ctx.device, &n_entries, &n_hits, NULL);
+    g_assert_cmpuint (n_hits, ==, n_hits_before + 1);
+    g_assert_cmpuint (n_entries, ==, RESPONSE_CACHE_MAX_ENTRIES);
+
+    /* All the expired ones are dropped when full */
+    g_usleep (1100 * 1000);
+    send_dms_get_ids_with_tag (&ctx, RESPONSE_CACHE_MAX_ENTRIES + 1);
+    qmi_device_get_response_cache_stats (ctx.device, &n_entries, NULL, NULL);
+    g_assert_cmpuint (n_entries, ==, 1);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_simulated_transaction_ids (void)
+{
+    TestContext ctx = { 0 };
+    guint16     in_flight;
+    guint16     next;
+    guint       i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+    add_dms_get_ids_response (ctx.device, 500);
+
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            &ctx);
+    next = qmi_client_get_next_transaction_id (ctx.client);
+    g_assert_cmpuint (next, >, 1);
+    in_flight = next - 1;
+
+    /* A full wraparound never gives the ID of the request in flight */
+    for (i = 0; i < G_MAXUINT16; i++)
+        g_assert_cmpuint (qmi_client_get_next_transaction_id (ctx.client), !=, in_flight);
+    g_main_loop_run (ctx.loop);
+
+    /* Available again once complete */
+    for (i = 0; i < G_MAXUINT16; i++) {
+        if (qmi_client_get_next_transaction_id (ctx.client) == in_flight)
+            break;
+    }
+    g_assert_cmpuint (i, <, G_MAXUINT16);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+test_simulated_synchronous_completion (void)
+{
+    TestContext ctx = { 0 };
+    guint       i;
+    guint       j;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+    add_dms_get_ids_response (ctx.device, 0);
+
+    /* Same results either way, with the transaction records being reused */
+    for (i = 0; i < 2; i++) {
+        qmi_device_set_synchronous_completion (ctx.device, i == 1);
+        for (j = 0; j < 100; j++) {
+            ctx.n_pending++;
+            qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                                    (GAsyncReadyCallback) dms_get_ids_coalesced_ready,
+                                    &ctx);
+        }
+        g_main_loop_run (ctx.loop);
+        g_assert_cmpuint (qmi_device_get_n_pending_transactions (ctx.device), ==, 0);
+    }
+
+    test_context_teardown (&ctx);
+}
+
+static void
+dms_get_ids_flag_ready (QmiClientDms *client,
+                        GAsyncResult *res,
+                        gboolean     *done)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+    *done = TRUE;
+}
+
+static void
+test_simulated_completion_contexts (void)
+{
+    TestContext   ctx = { 0 };
+    GMainContext *private_context;
+    gboolean      private_done = FALSE;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+    add_dms_get_ids_response (ctx.device, 10);
+
+    /* First request issued from a private context, which is not iterated */
+    private_context = g_main_context_new ();
+    g_main_context_push_thread_default (private_context);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_flag_ready,
+                            &private_done);
+    g_main_context_pop_thread_default (private_context);
+
+    /* Requests from the main context don't depend on the private one */
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_ready,
+                            &ctx);
+    g_main_loop_run (ctx.loop);
+    g_assert (!private_done);
+
+    /* And the result of the first request is reported in its own context */
+    while (!private_done) {
+        g_main_context_iteration (NULL, FALSE);
+        g_main_context_iteration (private_context, FALSE);
+    }
+    g_main_context_unref (private_context);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+assert_dms_get_ids_reply (QmiMessage *reply,
+                          GError     *error)
+{
+    QmiMessageDmsGetIdsOutput *output;
+
+    g_assert_no_error (error);
+    g_assert (reply);
+    output = qmi_message_dms_get_ids_response_parse (reply, &error);
+    g_assert_no_error (error);
+    g_assert (qmi_message_dms_get_ids_output_get_result (output, &error));
+    g_assert_no_error (error);
+    qmi_message_dms_get_ids_output_unref (output);
+    qmi_message_unref (reply);
+}
+
+static gboolean
+quit_loop_idle (TestContext *ctx)
+{
+    g_main_loop_quit (ctx->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer
+dms_get_ids_sync_thread (TestContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_sync (QMI_CLIENT_DMS (ctx->client), NULL, 5, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    g_assert (qmi_message_dms_get_ids_output_get_result (output, &error));
+    g_assert_no_error (error);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    g_idle_add ((GSourceFunc) quit_loop_idle, ctx);
+    return NULL;
+}
+
+static gpointer
+dms_get_ids_sync_worker (TestContext *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_sync (QMI_CLIENT_DMS (ctx->client), NULL, 5, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    if (g_atomic_int_dec_and_test ((gint *)&ctx->n_pending))
+        g_idle_add ((GSourceFunc) quit_loop_idle, ctx);
+    return NULL;
+}
+
+static void
+dms_get_ids_nested_sync_ready (QmiClientDms *client,
+                               GAsyncResult *res,
+                               TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    output = qmi_client_dms_get_ids_sync (client, NULL, 5, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+dms_get_ids_nested_sync_unsupported_ready (QmiClientDms *client,
+                                           GAsyncResult *res,
+                                           TestContext  *ctx)
+{
+    QmiMessageDmsGetIdsOutput *output;
+    GError *error = NULL;
+
+    output = qmi_client_dms_get_ids_finish (client, res, &error);
+    g_assert_no_error (error);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    /* The input of the device is still being processed */
+    output = qmi_client_dms_get_ids_sync (client, NULL, 5, NULL, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_WRONG_STATE);
+    g_assert (!output);
+    g_error_free (error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+test_simulated_command_sync (void)
+{
+    TestContext                ctx = { 0 };
+    QmiMessageDmsGetIdsOutput *output;
+    QmiMessage                *request;
+    QmiMessage                *reply;
+    GThread                   *thread;
+    GThread                   *threads[2];
+    GError                    *error = NULL;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+    add_dms_get_ids_response (ctx.device, 10);
+
+    /* Inline, as the caller owns the main context */
+    g_main_context_acquire (NULL);
+    request = qmi_message_new (QMI_SERVICE_DMS, qmi_client_get_cid (ctx.client), 0, 0x0025);
+    reply = qmi_device_command_sync (ctx.device, request, NULL, 5, NULL, &error);
+    assert_dms_get_ids_reply (reply, error);
+    qmi_message_unref (request);
+
+    output = qmi_client_dms_get_ids_sync (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (output);
+    qmi_message_dms_get_ids_output_unref (output);
+
+    /* From a worker thread, while the main context is run by the loop */
+    thread = g_thread_new ("command-sync", (GThreadFunc) dms_get_ids_sync_thread, &ctx);
+    g_main_loop_run (ctx.loop);
+    g_thread_join (thread);
+    g_main_context_release (NULL);
+
+    /* From several worker threads, which never run the main context
+     * themselves, even while nobody else owns it */
+    ctx.n_pending = G_N_ELEMENTS (threads);
+    threads[0] = g_thread_new ("command-sync-0", (GThreadFunc) dms_get_ids_sync_worker, &ctx);
+    threads[1] = g_thread_new ("command-sync-1", (GThreadFunc) dms_get_ids_sync_worker, &ctx);
+    g_usleep (G_USEC_PER_SEC / 10);
+    g_assert_cmpuint (g_atomic_int_get ((gint *)&ctx.n_pending), ==, G_N_ELEMENTS (threads));
+    g_main_loop_run (ctx.loop);
+    g_thread_join (threads[0]);
+    g_thread_join (threads[1]);
+
+    /* From a callback, iterating the main context recursively */
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_nested_sync_ready,
+                            &ctx);
+    g_main_loop_run (ctx.loop);
+
+    /* But not from a callback completed while processing the input */
+    qmi_device_set_synchronous_completion (ctx.device, TRUE);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (ctx.client), NULL, 5, NULL,
+                            (GAsyncReadyCallback) dms_get_ids_nested_sync_unsupported_ready,
+                            &ctx);
+    g_main_loop_run (ctx.loop);
+
+    g_assert_cmpuint (qmi_device_get_n_pending_transactions (ctx.device), ==, 0);
+
+    test_context_teardown (&ctx);
+}
+
+#endif /* HAVE_QMI_MESSAGE_DMS_GET_IDS */
+
+/*****************************************************************************/
+
+#if defined HAVE_QMI_INDICATION_DMS_EVENT_REPORT
+
+#define N_INDICATIONS 5
+
+static void
+dms_event_report (QmiClientDms                      *client,
+                  QmiIndicationDmsEventReportOutput *output,
+                  TestContext                       *ctx)
+{
+    if (++ctx->n_indications == N_INDICATIONS)
+        g_main_loop_quit (ctx->loop);
+}
+
+static void
+test_simulated_indications (void)
+{
+    const guint8 indication[] = {
+        0x01,
+        0x0C, 0x00, 0x80, 0x02, 0xFF, /* DMS, broadcast */
+        0x04, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00
+    };
+    TestContext  ctx = { 0 };
+    QmiMessage  *message;
+    GByteArray  *buffer;
+    GError      *error = NULL;
+    gulong       id;
+
+    test_context_setup (&ctx);
+
+    buffer = g_byte_array_append (g_byte_array_new (), indication, G_N_ELEMENTS (indication));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    qmi_device_add_simulated_indication (ctx.device, message, 10);
+    qmi_message_unref (message);
+    g_byte_array_unref (buffer);
+
+    test_context_open (&ctx);
+
+    id = g_signal_connect (ctx.client, "event-report", G_CALLBACK (dms_event_report), &ctx);
+    g_main_loop_run (ctx.loop);
+    g_assert_cmpuint (ctx.n_indications, ==, N_INDICATIONS);
+    g_signal_handler_disconnect (ctx.client, id);
+
+    test_context_teardown (&ctx);
+}
+
+#endif /* HAVE_QMI_INDICATION_DMS_EVENT_REPORT */
+
+/* Version info response without the service list, so that the cached one
+ * is kept when validating it */
+static void
+add_ctl_get_version_info_response (QmiDevice *device,
+                                   guint      latency_ms)
+{
+    const guint8 response[] = {
+        0x01,
+        0x12, 0x00, 0x80, 0x00, 0x00,
+        0x01, 0x00, 0x21, 0x00, 0x07, 0x00,
+        0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    QmiMessage *message;
+    GByteArray *buffer;
+    GError     *error = NULL;
+
+    buffer = g_byte_array_append (g_byte_array_new (), response, G_N_ELEMENTS (response));
+    message = qmi_message_new_from_raw (buffer, &error);
+    g_assert_no_error (error);
+    g_assert (message);
+    qmi_device_add_simulated_response (device, message, latency_ms);
+    qmi_message_unref (message);
+    g_byte_array_unref (buffer);
+}
+
+static void
+test_simulated_version_info_cache (void)
+{
+    TestContext          ctx = { 0 };
+    g_autofree gchar    *dir = NULL;
+    g_autofree gchar    *path = NULL;
+    g_autofree gchar    *firmware_id = NULL;
+    g_autofree gint     *services = NULL;
+    g_autoptr(GKeyFile)  key_file = NULL;
+    gsize                n_services = 0;
+    GError              *error = NULL;
+    guint                i;
+
+    dir = g_dir_make_tmp ("test-simulated-XXXXXX", &error);
+    g_assert_no_error (error);
+    path = g_build_filename (dir, "version-info", NULL);
+
+    /* Populated when the device is open for the first time, and used
+     * afterwards */
+    for (i = 0; i < 2; i++) {
+        test_context_setup (&ctx);
+        qmi_device_set_version_info_cache (ctx.device, path, "test-firmware");
+        if (i == 1)
+            add_ctl_get_version_info_response (ctx.device, 1000);
+        test_context_open (&ctx);
+
+        /* With the cache, the device is open without waiting for the
+         * version info, which is only validated in the background */
+        g_assert_cmpuint (qmi_device_get_n_pending_transactions (ctx.device), ==, i);
+        while (qmi_device_get_n_pending_transactions (ctx.device) > 0)
+            g_main_context_iteration (NULL, TRUE);
+
+        test_context_teardown (&ctx);
+        memset (&ctx, 0, sizeof (ctx));
+
+        key_file = g_key_file_new ();
+        g_assert (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error));
+        g_assert_no_error (error);
+        firmware_id = g_key_file_get_string (key_file, "/dev/simulated-qmi", "firmware-id", &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (firmware_id, ==, "test-firmware");
+        services = g_key_file_get_integer_list (key_file, "/dev/simulated-qmi", "services", &n_services, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (n_services, >, 0);
+        g_assert_cmpuint (n_services % 3, ==, 0);
+        g_clear_pointer (&firmware_id, g_free);
+        g_clear_pointer (&services, g_free);
+        g_clear_pointer (&key_file, g_key_file_unref);
+    }
+
+    g_unlink (path);
+    g_rmdir (dir);
+}
+
+static void
+device_allocate_clients_ready (QmiDevice    *device,
+                               GAsyncResult *res,
+                               TestContext  *ctx)
+{
+    g_autoptr(GPtrArray) clients = NULL;
+    g_autoptr(GPtrArray) errors = NULL;
+    GError              *error = NULL;
+
+    clients = qmi_device_allocate_clients_finish (device, res, &errors, &error);
+    g_assert_no_error (error);
+    g_assert (clients);
+    g_assert_cmpuint (clients->len, ==, 3);
+    g_assert_cmpuint (errors->len, ==, 3);
+
+    /* Same service twice, different client ids */
+    g_assert (QMI_IS_CLIENT_DMS (g_ptr_array_index (clients, 0)));
+    g_assert (QMI_IS_CLIENT_DMS (g_ptr_array_index (clients, 1)));
+    g_assert_cmpuint (qmi_client_get_cid (g_ptr_array_index (clients, 0)), !=,
+                      qmi_client_get_cid (g_ptr_array_index (clients, 1)));
+    g_assert (!g_ptr_array_index (errors, 0));
+    g_assert (!g_ptr_array_index (errors, 1));
+
+    /* No client type for this service */
+    g_assert (!g_ptr_array_index (clients, 2));
+    g_assert_error (g_ptr_array_index (errors, 2), QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+
+    ctx->clients = g_steal_pointer (&clients);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+device_allocate_clients_failed_ready (QmiDevice    *device,
+                                      GAsyncResult *res,
+                                      TestContext  *ctx)
+{
+    GPtrArray *clients;
+    GError    *error = NULL;
+
+    clients = qmi_device_allocate_clients_finish (device, res, NULL, &error);
+    g_assert_error (error, QMI_CORE_ERROR, QMI_CORE_ERROR_INVALID_ARGS);
+    g_assert (!clients);
+    g_error_free (error);
+    g_main_loop_quit (ctx->loop);
+}
+
+static void
+test_simulated_allocate_clients (void)
+{
+    TestContext                  ctx = { 0 };
+    const QmiDeviceClientRequest requests[] = {
+        { QMI_SERVICE_DMS, QMI_CID_NONE },
+        { QMI_SERVICE_DMS, QMI_CID_NONE },
+        { QMI_SERVICE_AT,  QMI_CID_NONE },
+    };
+    guint                        i;
+
+    test_context_setup (&ctx);
+    test_context_open (&ctx);
+
+    /* Partial failure */
+    qmi_device_allocate_clients (ctx.device, requests, G_N_ELEMENTS (requests), 5, NULL,
+                                 (GAsyncReadyCallback) device_allocate_clients_ready,
+                                 &ctx);
+    g_main_loop_run (ctx.loop);
+
+    for (i = 0; i < ctx.clients->len; i++) {
+        if (!g_ptr_array_index (ctx.clients, i))
+            continue;
+        qmi_device_release_client (ctx.device, g_ptr_array_index (ctx.clients, i), QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 5, NULL,
+                                   (GAsyncReadyCallback) device_release_client_ready,
+                                   &ctx);
+        g_main_loop_run (ctx.loop);
+    }
+    g_clear_pointer (&ctx.clients, g_ptr_array_unref);
+
+    /* Everything failed */
+    qmi_device_allocate_clients (ctx.device, &requests[2], 1, 5, NULL,
+                                 (GAsyncReadyCallback) device_allocate_clients_failed_ready,
+                                 &ctx);
+    g_main_loop_run (ctx.loop);
+
+    test_context_teardown (&ctx);
+}
+
+static void
+wait_cid_pool_full (TestContext *ctx,
+                    guint        size)
+{
+    guint n_available = 0;
+
+    g_assert (qmi_device_get_cid_pool_stats (ctx->device, QMI_SERVICE_DMS, &n_available, NULL, NULL));
+    while (n_available < size) {
+        g_main_context_iteration (NULL, TRUE);
+        g_assert (qmi_device_get_cid_pool_stats (ctx->device, QMI_SERVICE_DMS, &n_available, NULL, NULL));
+    }
+    g_assert_cmpuint (n_available, ==, size);
+}
+
+static void
+test_simulated_cid_pool (void)
+{
+    TestContext  ctx = { 0 };
+    QmiClient   *clients[2];
+    QmiClient   *main_client;
+    guint64      n_hits = 0;
+    guint64      n_hits_before = 0;
+    guint        n_available = 0;
+    guint        i;
+
+    test_context_setup (&ctx);
+    g_assert (!qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, NULL, NULL, NULL));
+    qmi_device_set_cid_pool_size (ctx.device, QMI_SERVICE_DMS, 2);
+    test_context_open (&ctx);
+    wait_cid_pool_full (&ctx, 2);
+    main_client = g_steal_pointer (&ctx.client);
+
+    /* Both taken from the pool, refilled in the background */
+    g_assert (qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, NULL, &n_hits_before, NULL));
+    for (i = 0; i < G_N_ELEMENTS (clients); i++) {
+        qmi_device_allocate_client (ctx.device, QMI_SERVICE_DMS, QMI_CID_NONE, 5, NULL,
+                                    (GAsyncReadyCallback) device_allocate_client_ready,
+                                    &ctx);
+        g_main_loop_run (ctx.loop);
+        clients[i] = g_steal_pointer (&ctx.client);
+    }
+    g_assert (qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, NULL, &n_hits, NULL));
+    g_assert_cmpuint (n_hits, ==, n_hits_before + 2);
+    g_assert_cmpuint (qmi_client_get_cid (clients[0]), !=, qmi_client_get_cid (clients[1]));
+
+    wait_cid_pool_full (&ctx, 2);
+
+    /* Growing the pool leaves room for one more while the refill is in
+     * flight; the pool is updated as soon as the release is requested */
+    qmi_device_set_cid_pool_size (ctx.device, QMI_SERVICE_DMS, 3);
+    g_assert (qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, &n_available, NULL, NULL));
+    g_assert_cmpuint (n_available, ==, 2);
+
+    /* Released, as returning to the pool is not requested */
+    ctx.client = clients[0];
+    qmi_device_release_client (ctx.device, ctx.client, QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID, 5, NULL,
+                               (GAsyncReadyCallback) device_release_client_ready,
+                               &ctx);
+    g_assert (qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, &n_available, NULL, NULL));
+    g_assert_cmpuint (n_available, ==, 2);
+    g_main_loop_run (ctx.loop);
+    g_clear_object (&ctx.client);
+    wait_cid_pool_full (&ctx, 3);
+
+    /* Returned to the pool */
+    qmi_device_set_cid_pool_size (ctx.device, QMI_SERVICE_DMS, 4);
+    ctx.client = clients[1];
+    qmi_device_release_client (ctx.device, ctx.client,
+                               (QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID |
+                                QMI_DEVICE_RELEASE_CLIENT_FLAGS_RETURN_TO_POOL),
+                               5, NULL,
+                               (GAsyncReadyCallback) device_release_client_ready,
+                               &ctx);
+    g_assert (qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, &n_available, NULL, NULL));
+    g_assert_cmpuint (n_available, ==, 4);
+    g_main_loop_run (ctx.loop);
+    g_clear_object (&ctx.client);
+
+    /* The refill completing with a full pool releases the new one */
+    wait_cid_pool_full (&ctx, 4);
+
+    /* Shrinking releases the ones in excess */
+    qmi_device_set_cid_pool_size (ctx.device, QMI_SERVICE_DMS, 1);
+    wait_cid_pool_full (&ctx, 1);
+    qmi_device_set_cid_pool_size (ctx.device, QMI_SERVICE_DMS, 0);
+    g_assert (!qmi_device_get_cid_pool_stats (ctx.device, QMI_SERVICE_DMS, NULL, NULL, NULL));
+
+    /* The ones still pooled are released when closing */
+    qmi_device_set_cid_pool_size (ctx.device, QMI_SERVICE_DMS, 2);
+    wait_cid_pool_full (&ctx, 2);
+
+    ctx.client = main_client;
+    test_context_teardown (&ctx);
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/libqmi-glib/simulated/version-info-cache", test_simulated_version_info_cache);
+    g_test_add_func ("/libqmi-glib/simulated/allocate-clients",   test_simulated_allocate_clients);
+    g_test_add_func ("/libqmi-glib/simulated/cid-pool",           test_simulated_cid_pool);
+
+#if defined HAVE_QMI_MESSAGE_DMS_GET_IDS
+    g_test_add_func ("/libqmi-glib/simulated/response",    test_simulated_response);
+    g_test_add_func ("/libqmi-glib/simulated/metrics",     test_simulated_metrics);
+    g_test_add_func ("/libqmi-glib/simulated/window",      test_simulated_window);
+    g_test_add_func ("/libqmi-glib/simulated/coalescing",  test_simulated_coalescing);
+    g_test_add_func ("/libqmi-glib/simulated/coalescing-cancelled", test_simulated_coalescing_cancelled);
+    g_test_add_func ("/libqmi-glib/simulated/cache",       test_simulated_cache);
+    g_test_add_func ("/libqmi-glib/simulated/cache-limit", test_simulated_cache_limit);
+    g_test_add_func ("/libqmi-glib/simulated/transaction-ids", test_simulated_transaction_ids);
+    g_test_add_func ("/libqmi-glib/simulated/synchronous-completion", test_simulated_synchronous_completion);
+    g_test_add_func ("/libqmi-glib/simulated/completion-contexts", test_simulated_completion_contexts);
+    g_test_add_func ("/libqmi-glib/simulated/command-sync", test_simulated_command_sync);
+#endif
+#if defined HAVE_QMI_INDICATION_DMS_EVENT_REPORT
+    g_test_add_func ("/libqmi-glib/simulated/indications", test_simulated_indications);
+#endif
+
+    return g_test_run ();
+}